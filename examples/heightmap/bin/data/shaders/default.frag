@@ -1,26 +1,30 @@
 #version 450 core
 
+#include "lighting.glsl"
+#include "pistacchio/clustered_lights.glsl"
+
 in vec3 frag_position;
 in vec3 frag_normal;
 in flat vec3 frag_normal_flat;
+in float frag_view_depth;
 
 uniform vec3  light_color;
 uniform vec3  light_position;
 uniform vec3  object_color;
 uniform float ambient_strength;
-uniform bool flat_shading;
 uniform float model_opacity;
 
 out vec4 color;
 
 void main() {
-	vec3 normal = (flat_shading) ? frag_normal_flat : frag_normal;
-
-	vec3 ambient = ambient_strength * light_color;
+#ifdef FLAT_SHADING
+	vec3 normal = frag_normal_flat;
+#else
+	vec3 normal = frag_normal;
+#endif
 
-	vec3 light_direction = normalize(light_position - frag_position);
-	float diffuse_impact = max(dot(normal, light_direction), 0.0);
-	vec3 diffuse = diffuse_impact * light_color;
+	vec3 light = lighting(frag_position, normal, light_position, light_color, ambient_strength);
+	light += clustered_lighting(frag_position, normal, frag_view_depth);
 
-	color = vec4((ambient + diffuse) * object_color, model_opacity);
+	color = vec4(light * object_color, model_opacity);
 }
@@ -1,7 +1,7 @@
 #version 450 core
 
-in vec3 vertex;
-in vec3 normal;
+layout(location = 0) in vec3 vertex;
+layout(location = 1) in vec3 normal;
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -10,10 +10,12 @@ uniform mat4 model;
 out vec3 frag_normal;
 out vec3 frag_normal_flat;
 out vec3 frag_position;
+out float frag_view_depth;
 
 void main() {
 	gl_Position = projection * view * model * vec4(vertex, 1.0);
 	frag_normal = normalize(mat3(transpose(inverse(model))) * normal);
 	frag_normal_flat = frag_normal;
 	frag_position = vec3(model * vec4(vertex, 1.0));
+	frag_view_depth = -(view * vec4(frag_position, 1.0)).z;
 }
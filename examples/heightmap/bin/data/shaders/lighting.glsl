@@ -0,0 +1,11 @@
+// Ambient + diffuse contribution of a single point light.
+vec3 lighting(vec3 position, vec3 normal, vec3 light_position, vec3 light_color, float ambient_strength)
+{
+	vec3 ambient = ambient_strength * light_color;
+
+	vec3 light_direction = normalize(light_position - position);
+	float diffuse_impact = max(dot(normal, light_direction), 0.0);
+	vec3 diffuse = diffuse_impact * light_color;
+
+	return ambient + diffuse;
+}
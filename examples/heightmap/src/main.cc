@@ -4,15 +4,28 @@
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/glm.hpp>
+#include <random>
+#include <vector>
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_sdl2.h>
 #include <imgui/imgui_impl_opengl3.h>
 #include <pistacchio/app.hh>
 #include <pistacchio/input.hh>
 #include <pistacchio/log.hh>
+#include <pistacchio/time.hh>
 #include <pistacchio/types.hh>
 #include <pistacchio/filesystem/obj.hh>
+#include <pistacchio/gl/clustered_lights.hh>
+#include <pistacchio/gl/dynamic_resolution.hh>
+#include <pistacchio/gl/frame_graph.hh>
+#include <pistacchio/gl/hiz.hh>
+#include <pistacchio/gl/memory.hh>
+#include <pistacchio/gl/mesh.hh>
+#include <pistacchio/gl/render_stats.hh>
 #include <pistacchio/gl/shader.hh>
+#include <pistacchio/gl/shader_variants.hh>
+#include <pistacchio/gl/state.hh>
+#include <pistacchio/gl/vertex_layout.hh>
 #include <pistacchio/gl/window.hh>
 #include <pistacchio/math/vector3.hh>
 #include "heightmap.hh"
@@ -21,13 +34,23 @@ using vec3 = glm::vec3;
 
 auto _log = Log("Main");
 
+// Driver messages in Log, for debug builds only
+#ifdef NDEBUG
+static constexpr bool DEBUG_CONTEXT = false;
+#else
+static constexpr bool DEBUG_CONTEXT = true;
+#endif
+
 class HeightmapApp : public App {
 public:
-	WindowGL window = WindowGL( "Heightmap", Window::CENTERED, Window::CENTERED, 1280, 720 );
-	ShaderGL shader = ShaderGL({
+	WindowGL window = WindowGL( "Heightmap", Window::CENTERED, Window::CENTERED, 1280, 720, 0, DEBUG_CONTEXT );
+	// Shader features, selected at compile time
+	static constexpr u32 FLAT_SHADING = 1 << 0;
+
+	ShaderVariantsGL shaders = ShaderVariantsGL({
 		{ ShaderGL::VERTEX,   "data/shaders/default.vert" },
 		{ ShaderGL::FRAGMENT, "data/shaders/default.frag" },
-	});
+	}, { "FLAT_SHADING" });
 
 	Heightmap heightmap = Heightmap::load("data/heightmap.png");
 	Heightmap::Mesh model_heightmap = heightmap.mesh();
@@ -44,30 +67,43 @@ public:
 	bool wireframe = false;
 	bool flat_shading = false;
 
-	u32 vao = GL_NONE;
-	u32 buffer_vertices = GL_NONE;
-	u32 buffer_normals = GL_NONE;
-	u32 buffer_indices = GL_NONE;
-
-	int upload_heightmap(const Heightmap::Mesh& model)
-	{
-		glNamedBufferData(buffer_vertices,
-			model.vertices.size() * sizeof(float) * 3,
-			model.vertices.data(),
-			GL_DYNAMIC_DRAW);
-
-		glNamedBufferData(buffer_indices,
-			model.indices.size() * sizeof(u32),
-			model.indices.data(),
-			GL_DYNAMIC_DRAW);
-
-		glNamedBufferData(buffer_normals,
-			model.normals.size() * sizeof(float) * 3,
-			model.normals.data(),
-			GL_DYNAMIC_DRAW);
-
-		return model.indices.size();
-	}
+	// Positions and normals, each in their own buffer
+	VertexLayout layout = {
+		.attributes = {
+			{ .location = 0, .size = 3, .type = GL_FLOAT, .binding = 0 },
+			{ .location = 1, .size = 3, .type = GL_FLOAT, .binding = 1 },
+		},
+		.bindings = {
+			{ .index = 0, .stride = sizeof(float) * 3 },
+			{ .index = 1, .stride = sizeof(float) * 3 },
+		},
+	};
+
+	// Only sent to the GPU when the terrain changes
+	MeshGL mesh = MeshGL(model_heightmap.vertices, model_heightmap.normals, model_heightmap.indices);
+
+	FrameGraphGL frame_graph;
+
+	// Terrain resolution follows GPU load, ImGui stays sharp
+	DynamicResolutionGL dynamic_resolution = DynamicResolutionGL(window.width(), window.height());
+	bool dynamic_resolution_enabled = true;
+
+	// Small point lights wandering over the terrain
+	static constexpr u32 MAX_POINT_LIGHTS = 4096;
+	ClusteredLightsGL clustered_lights = ClusteredLightsGL(MAX_POINT_LIGHTS);
+	std::vector<ClusteredLightsGL::Light> point_lights;
+	std::vector<ClusteredLightsGL::Light> animated_lights;
+	int point_lights_count = 1024;
+	float point_lights_radius = 3.0f;
+	float point_lights_intensity = 4.0f;
+
+	// Lights whose whole sphere is hidden behind the terrain light nothing
+	// visible. They're tested on the CPU against the Hi-Z pyramid of the
+	// terrain's depth, read back a frame or two later.
+	HiZGL hiz = HiZGL(window.width(), window.height());
+	glm::mat4 terrain_view_projection = glm::mat4(1.0f);
+	bool hiz_light_culling = true;
+	size_t visible_lights = 0;
 
 	HeightmapApp() : App(60.0, 120.0)
 	{
@@ -77,26 +113,30 @@ public:
 		ImGui_ImplSDL2_InitForOpenGL(window.sdl_window(), window.data());
 		ImGui_ImplOpenGL3_Init("#version 450 core");
 
-		glEnable(GL_CULL_FACE);
-		glEnable(GL_DEPTH_TEST);
+		// Both variants can be toggled from the UI, submit them together
 
-		glCreateBuffers(1, &buffer_vertices);
-		glCreateBuffers(1, &buffer_normals);
-		glCreateBuffers(1, &buffer_indices);
+		shaders.prepare(0);
+		shaders.prepare(FLAT_SHADING);
 
-		glCreateVertexArrays(1, &vao);
+		StateGL::cull_face(true);
+		StateGL::depth_test(true);
 
-		glVertexArrayVertexBuffer(vao, 0, buffer_vertices, 0, sizeof(float) * 3);
-		glVertexArrayVertexBuffer(vao, 1, buffer_normals, 0, sizeof(float) * 3);
-		glVertexArrayElementBuffer(vao, buffer_indices);
+		dynamic_resolution.target_rate(target_rate());
 
-		glEnableVertexArrayAttrib(vao, 0);
-		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
-		glVertexArrayAttribBinding(vao, 0, 0);
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
 
-		glEnableVertexArrayAttrib(vao, 1);
-		glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, 0);
-		glVertexArrayAttribBinding(vao, 1, 1);
+		for (u32 i = 0; i < MAX_POINT_LIGHTS; ++i) {
+			glm::vec3 position = {
+				(unit(random) - 0.5f) * heightmap.width,
+				0.5f + unit(random) * 5.0f,
+				(unit(random) - 0.5f) * heightmap.height
+			};
+
+			glm::vec3 color = glm::vec3{ unit(random), unit(random), unit(random) };
+
+			point_lights.push_back({ glm::vec4(position, 0.0f), glm::vec4(color, 0.0f) });
+		}
 	}
 
 	void update(double dt) override
@@ -114,6 +154,16 @@ public:
 			}
 		}
 
+		// Shaders compile in the background, warm them up as soon as they're
+		// done so the first frame that uses them doesn't hitch.
+
+		for (auto features : { 0u, FLAT_SHADING }) {
+			auto& shader = shaders.get(features);
+
+			if (shader.ready())
+				shader.prewarm();
+		}
+
 		ImGui_ImplSDL2_NewFrame();
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui::NewFrame();
@@ -132,6 +182,11 @@ public:
 			ImGui::DragFloat3("Position##lightPosition", &light_position[0]);
 			ImGui::ColorEdit3("Color##lightColor", &light_color.x);
 			ImGui::SliderFloat("Ambient##ambientStrength", &ambient_strength, 0.0f, 1.0f);
+			ImGui::SliderInt("Point lights##pointLights", &point_lights_count, 0, MAX_POINT_LIGHTS);
+			ImGui::SliderFloat("Radius##pointLightsRadius", &point_lights_radius, 0.5f, 20.0f);
+			ImGui::SliderFloat("Intensity##pointLightsIntensity", &point_lights_intensity, 0.0f, 20.0f);
+			ImGui::Checkbox("Hi-Z light culling", &hiz_light_culling);
+			ImGui::Text("Visible point lights: %zu of %d", visible_lights, point_lights_count);
 			ImGui::Separator();
 
 			ImGui::Text("Heightmap");
@@ -142,6 +197,40 @@ public:
 			ImGui::Checkbox("Wireframe", &wireframe);
 			ImGui::SameLine();
 			ImGui::Checkbox("Flat shading", &flat_shading);
+
+			auto stats = RenderStatsGL::stats();
+			ImGui::Text("Draws: %llu (%llu instances, %llu primitives)", (unsigned long long)stats.draws,
+				(unsigned long long)stats.instances, (unsigned long long)stats.primitives);
+			ImGui::Text("Binds: %llu programs, %llu VAOs, %llu textures, %llu uniforms", (unsigned long long)stats.program_binds,
+				(unsigned long long)stats.vao_binds, (unsigned long long)stats.texture_binds, (unsigned long long)stats.uniforms);
+			ImGui::Text("Uploads: %.1f KiB to buffers, %.1f KiB to textures",
+				stats.buffer_upload_bytes / 1024.0, stats.texture_upload_bytes / 1024.0);
+			ImGui::Text("State changes: %u issued, %u elided", stats.state_issued, stats.state_elided);
+
+			auto memory = MemoryGL::usage();
+			ImGui::Text("GPU memory: %.1f MiB (peak %.1f MiB)", memory.bytes / 1048576.0, memory.peak / 1048576.0);
+			ImGui::Text("  Buffers: %.1f MiB, textures: %.1f MiB",
+				MemoryGL::usage(MemoryGL::BUFFER).bytes / 1048576.0, MemoryGL::usage(MemoryGL::TEXTURE).bytes / 1048576.0);
+
+			ImGui::Checkbox("Dynamic resolution", &dynamic_resolution_enabled);
+			ImGui::Text("Scale: %.2f (%ux%u), scene %.2f ms", dynamic_resolution.scale(),
+				dynamic_resolution.render_width(), dynamic_resolution.render_height(), dynamic_resolution.gpu_time());
+
+			for (const auto& timing : frame_graph.timings())
+				ImGui::Text("%s: %.3f ms", timing.name.c_str(), timing.milliseconds);
+			ImGui::Separator();
+
+			ImGui::Text("Capture");
+			if (ImGui::Button("Screenshot"))
+				window.capture().screenshot("heightmap.png");
+			ImGui::SameLine();
+			if (ImGui::Button(window.capture().recording() ? "Stop recording" : "Record")) {
+				if (window.capture().recording())
+					window.capture().stop();
+				else
+					window.capture().record("heightmap_", CaptureGL::RAW);
+			}
+			ImGui::Text("Frames queued: %zu", window.capture().queued());
 		}
 		ImGui::End();
 
@@ -149,12 +238,51 @@ public:
 	}
 
 	void render(double alpha) override
+	{
+		frame_graph.backbuffer(window.width(), window.height());
+		dynamic_resolution.resize(window.width(), window.height());
+		dynamic_resolution.enabled(dynamic_resolution_enabled);
+
+		frame_graph.add_pass("Terrain", [](auto& builder) {
+			builder.write(FrameGraphGL::BACKBUFFER);
+		}, [this](const auto&) {
+			// `end` may change the scale for the next frames
+			uint32_t width = dynamic_resolution.render_width();
+			uint32_t height = dynamic_resolution.render_height();
+
+			dynamic_resolution.begin();
+			render_terrain(dynamic_resolution.framebuffer());
+			dynamic_resolution.end();
+
+			// Terrain depth for the light culling of the next frames
+			hiz.resize(width, height);
+			hiz.build(dynamic_resolution.depth_texture(), terrain_view_projection);
+			hiz.readback();
+		});
+
+		frame_graph.add_pass("ImGui", [](auto& builder) {
+			builder.write(FrameGraphGL::BACKBUFFER);
+		}, [](const auto&) {
+			if (ImGui::GetFrameCount() > 0) {
+				ImGui::Render();
+				ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			}
+		});
+
+		frame_graph.execute();
+
+		window.swap();
+
+		clustered_lights.next_frame();
+	}
+
+	void render_terrain(u32 framebuffer)
 	{
 		float clear_color[4] = { 0.33f, 0.33f, 0.33f, 1.0f };
-		glClearNamedFramebufferfv(0, GL_COLOR, 0, clear_color);
+		glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear_color);
 
 		float clear_depth = 1.0f;
-		glClearNamedFramebufferfv(0, GL_DEPTH, 0, &clear_depth);
+		glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &clear_depth);
 
 		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)window.width()/window.height(), 0.1f, 1000.0f);
 		glm::mat4 model = glm::mat4(1.0f);
@@ -165,39 +293,72 @@ public:
 		view = glm::rotate(view, glm::radians(camera_rotation.y), glm::vec3{ 0.0f, 1.0f, 0.0f });
 		view = glm::rotate(view, glm::radians(camera_rotation.z), glm::vec3{ 0.0f, 0.0f, 1.0f });
 
-		shader.uniform("projection", projection);
-		shader.uniform("model", model);
-		shader.uniform("view", view);
-		shader.uniform("light_position", light_position);
-		shader.uniform("light_color", light_color);
-		shader.uniform("object_color", object_color);
-		shader.uniform("ambient_strength", ambient_strength);
-		shader.uniform("flat_shading", flat_shading);
-		shader.uniform("model_opacity", model_opacity);
-
-		glUseProgram(shader.id());
-		glBindVertexArray(vao);
-
-		if (wireframe)
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		else
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-		model = glm::mat4(1.0f);
-		model = glm::scale(model, heightmap_scale);
-		model = glm::translate(model, glm::vec3{ -heightmap.width / 2, 0, -heightmap.height / 2  });
-		shader.uniform("model", model);
-		glDrawElements(GL_TRIANGLES, upload_heightmap(model_heightmap), GL_UNSIGNED_INT, 0);
-
-		glBindVertexArray(0);
-		glUseProgram(0);
-
-		if (ImGui::GetFrameCount() > 0) {
-			ImGui::Render();
-			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		// Point lights drift around their starting spot; positions are in
+		// heightmap units and scaled to world space like the terrain
+
+		float time = Time::seconds();
+
+		animated_lights.resize(point_lights_count);
+
+		for (int i = 0; i < point_lights_count; ++i) {
+			const auto& light = point_lights[i];
+			glm::vec3 position = glm::vec3(light.position_radius);
+
+			position.x += std::sin(time * 0.5f + i) * 4.0f;
+			position.z += std::cos(time * 0.3f + i * 1.7f) * 4.0f;
+
+			animated_lights[i] = {
+				glm::vec4(position * glm::vec3{ heightmap_scale.x, 1.0f, heightmap_scale.z }, point_lights_radius),
+				glm::vec4(glm::vec3(light.color_intensity), point_lights_intensity)
+			};
 		}
 
-		SDL_GL_SwapWindow(window.sdl_window());
+		if (hiz_light_culling) {
+			std::erase_if(animated_lights, [this](const auto& light) {
+				auto center = glm::vec3(light.position_radius);
+				auto radius = glm::vec3(light.position_radius.w);
+
+				return hiz.occluded(center - radius, center + radius);
+			});
+		}
+
+		visible_lights = animated_lights.size();
+		terrain_view_projection = projection * view;
+
+		clustered_lights.update(animated_lights);
+		clustered_lights.assign(view, projection, 0.1f, 1000.0f,
+			dynamic_resolution.render_width(), dynamic_resolution.render_height());
+
+		auto& shader = shaders.get(flat_shading ? FLAT_SHADING : 0);
+
+		if (shader.ready()) {
+			clustered_lights.bind(shader);
+
+			shader.uniform("projection", projection);
+			shader.uniform("model", model);
+			shader.uniform("view", view);
+			shader.uniform("light_position", light_position);
+			shader.uniform("light_color", light_color);
+			shader.uniform("object_color", object_color);
+			shader.uniform("ambient_strength", ambient_strength);
+			shader.uniform("model_opacity", model_opacity);
+
+			StateGL::use_program(shader.id());
+			StateGL::bind_vertex_array(layout.vao());
+			mesh.upload();
+			mesh.bind(layout);
+
+			if (wireframe)
+				StateGL::polygon_mode(GL_LINE);
+			else
+				StateGL::polygon_mode(GL_FILL);
+
+			model = glm::mat4(1.0f);
+			model = glm::scale(model, heightmap_scale);
+			model = glm::translate(model, glm::vec3{ -heightmap.width / 2, 0, -heightmap.height / 2  });
+			shader.uniform("model", model);
+			mesh.draw();
+		}
 	}
 };
 
@@ -53,7 +53,7 @@ public:
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		SDL_GL_SwapWindow(window.sdl_window());
+		window.swap();
 	}
 };
 
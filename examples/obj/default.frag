@@ -1,14 +1,16 @@
 #version 450 core
 
+#include "pistacchio/clustered_lights.glsl"
+
 in vec3 frag_position;
 in vec3 frag_normal;
 in flat vec3 frag_normal_flat;
+in float frag_view_depth;
 
 uniform vec3  light_color;
 uniform vec3  light_position;
 uniform vec3  object_color;
 uniform float ambient_strength;
-uniform bool flat_shading;
 uniform float model_opacity;
 uniform float specular_strength;
 uniform int specular_shininess;
@@ -17,7 +19,12 @@ uniform vec3 view_position;
 out vec4 color;
 
 void main() {
-	vec3 normal = (flat_shading) ? frag_normal_flat : frag_normal;
+#ifdef FLAT_SHADING
+	vec3 normal = frag_normal_flat;
+#else
+	vec3 normal = frag_normal;
+#endif
+
 	vec3 light_direction = normalize(light_position - frag_position);
 	vec3 view_direction = normalize(view_position - frag_position);
 	vec3 reflect_direction = reflect(-light_direction, normal);
@@ -28,6 +35,7 @@ void main() {
 	vec3 diffuse = diffuse_impact * light_color;
 	vec3 ambient = ambient_strength * light_color;
 	vec3 specular = specular_strength * specular_impact * light_color;
+	vec3 point_lights = clustered_lighting(frag_position, normal, frag_view_depth);
 
-	color = vec4((ambient + diffuse + specular) * object_color, model_opacity);
+	color = vec4((ambient + diffuse + specular + point_lights) * object_color, model_opacity);
 }
@@ -1,19 +1,35 @@
-#version 450 core
+#version 460 core
 
-in vec3 vertex;
-in vec3 normal;
+layout(location = 0) in vec3 vertex;
+layout(location = 1) in vec3 normal;
+
+#if defined(MULTI_DRAW)
+// One model matrix per draw of the `DrawListGL`
+layout(std430, binding = 0) readonly buffer Draws { mat4 draws[]; };
+#elif defined(MODEL_UNIFORM)
+uniform mat4 model;
+#else
+layout(location = 2) in mat4 instance_model;
+#endif
 
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
 
 out vec3 frag_normal;
 out vec3 frag_normal_flat;
 out vec3 frag_position;
+out float frag_view_depth;
 
 void main() {
+#if defined(MULTI_DRAW)
+	mat4 model = draws[gl_DrawID];
+#elif !defined(MODEL_UNIFORM)
+	mat4 model = instance_model;
+#endif
+
 	gl_Position = projection * view * model * vec4(vertex, 1.0);
 	frag_normal = mat3(transpose(inverse(model))) * normal;
 	frag_normal_flat = frag_normal;
 	frag_position = vec3(model * vec4(vertex, 1.0));
+	frag_view_depth = -(view * vec4(frag_position, 1.0)).z;
 }
@@ -1,4 +1,6 @@
+#include <cmath>
 #include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <glad/gl.h>
@@ -12,10 +14,20 @@
 #include "imgui.h"
 #include "pistacchio/app.hh"
 #include "pistacchio/input.hh"
+#include "pistacchio/jobs.hh"
 #include "pistacchio/log.hh"
+#include "pistacchio/time.hh"
 #include "pistacchio/types.hh"
 #include "pistacchio/filesystem/obj.hh"
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/clustered_lights.hh"
+#include "pistacchio/gl/geometry_pool.hh"
+#include "pistacchio/gl/render_queue.hh"
+#include "pistacchio/gl/render_stats.hh"
 #include "pistacchio/gl/shader.hh"
+#include "pistacchio/gl/shader_variants.hh"
+#include "pistacchio/gl/state.hh"
+#include "pistacchio/gl/vertex_layout.hh"
 #include "pistacchio/gl/window.hh"
 
 using vec3 = glm::vec3;
@@ -25,10 +37,18 @@ static auto _log = Log("OBJ");
 class ObjApp : public App {
 private:
 	WindowGL window  = WindowGL("OBJ", Window::CENTERED, Window::CENTERED, 1280, 720, SDL_WINDOW_RESIZABLE);
-	ShaderGL shader = ShaderGL({
+	static constexpr u32 FLAT_SHADING = 1 << 0;
+	static constexpr u32 MULTI_DRAW = 1 << 1;
+	static constexpr u32 MODEL_UNIFORM = 1 << 2;
+
+	ShaderVariantsGL shaders = ShaderVariantsGL({
 		{ ShaderGL::VERTEX, "default.vert" },
 		{ ShaderGL::FRAGMENT, "default.frag" }
-	});
+	}, { "FLAT_SHADING", "MULTI_DRAW", "MODEL_UNIFORM" });
+
+	// Same grid, three ways to submit it
+	enum DrawPath { INSTANCED, DRAW_LIST, RENDER_QUEUE };
+	static constexpr u32 PATH_FEATURES[] = { 0, MULTI_DRAW, MODEL_UNIFORM };
 
 	OBJ obj = OBJ::load("suzanne.obj");
 	std::vector<vec3> vertices;
@@ -51,11 +71,58 @@ private:
 	int   specular_shininess = 8;
 	bool  wireframe          = false;
 	bool  flat_shading       = false;
-
-	u32 vao = GL_NONE;
-	u32 buffer_vertices = GL_NONE;
-	u32 buffer_normals = GL_NONE;
-	u32 buffer_indices = GL_NONE;
+	int   draw_path          = INSTANCED;
+	int   instances_per_side = 1;
+	float instance_spacing   = 2.5f;
+
+	VertexLayout layout = {
+		.attributes = {
+			{ .location = 0, .size = 3, .type = GL_FLOAT, .binding = 0 },
+			{ .location = 1, .size = 3, .type = GL_FLOAT, .binding = 1 },
+		},
+		.bindings = {
+			{ .index = 0, .stride = sizeof(float) * 3 },
+			{ .index = 1, .stride = sizeof(float) * 3 },
+		},
+	};
+
+	BufferGL buffer_vertices;
+	BufferGL buffer_normals;
+	BufferGL buffer_indices;
+
+	// Model matrices of every instance, rewritten each frame
+	static constexpr u32 MAX_INSTANCES_PER_SIDE = 64;
+	BufferGL buffer_instances = BufferGL::stream(MAX_INSTANCES_PER_SIDE * MAX_INSTANCES_PER_SIDE * sizeof(glm::mat4));
+	std::vector<glm::mat4> instances;
+
+	// Same grid drawn as one draw per object, with the model matrices read
+	// from an SSBO indexed by `gl_DrawID`
+	VertexLayout pool_layout = {
+		.attributes = {
+			{ .location = 0, .size = 3, .type = GL_FLOAT, .binding = 0 },
+			{ .location = 1, .size = 3, .type = GL_FLOAT, .binding = 1 },
+		},
+		.bindings = {
+			{ .index = 0, .stride = sizeof(float) * 3 },
+			{ .index = 1, .stride = sizeof(float) * 3 },
+		},
+	};
+
+	GeometryPoolGL pool = GeometryPoolGL(1 << 16, 1 << 18);
+	GeometryPoolGL::Mesh pool_mesh;
+	DrawListGL draw_list = DrawListGL(MAX_INSTANCES_PER_SIDE * MAX_INSTANCES_PER_SIDE, sizeof(glm::mat4));
+
+	// Or one draw per object, recorded from the job threads and sorted front
+	// to back
+	RenderQueueGL render_queue;
+
+	// Colored point lights circling in front of the grid
+	static constexpr u32 MAX_POINT_LIGHTS = 256;
+	ClusteredLightsGL clustered_lights = ClusteredLightsGL(MAX_POINT_LIGHTS);
+	std::vector<ClusteredLightsGL::Light> point_lights;
+	int   point_lights_count     = 16;
+	float point_lights_radius    = 3.0f;
+	float point_lights_intensity = 4.0f;
 public:
 	ObjApp() : App(30, 60)
 	{
@@ -93,42 +160,27 @@ public:
 		model = glm::mat4(1.0f);
 		view = glm::mat4(1.0f);
 
-		glEnable(GL_CULL_FACE);
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-		glCreateBuffers(1, &buffer_vertices);
-		glNamedBufferStorage(buffer_vertices,
-			vertices.size() * sizeof(float) * 3,
-			vertices.data(),
-			GL_DYNAMIC_STORAGE_BIT);
-
-		glCreateBuffers(1, &buffer_normals);
-		glNamedBufferStorage(buffer_normals,
-			normals.size() * sizeof(float) * 3,
-			normals.data(),
-			GL_DYNAMIC_STORAGE_BIT);
-
-		glCreateBuffers(1, &buffer_indices);
-		glNamedBufferStorage(buffer_indices,
-			indices.size() * sizeof(uint32_t),
-			indices.data(),
-			GL_DYNAMIC_STORAGE_BIT);
-
-		glCreateVertexArrays(1, &vao);
-
-		glVertexArrayVertexBuffer(vao, 0, buffer_vertices, 0, sizeof(float) * 3);
-		glVertexArrayVertexBuffer(vao, 1, buffer_normals, 0, sizeof(float) * 3);
-		glVertexArrayElementBuffer(vao, buffer_indices);
-
-		glEnableVertexArrayAttrib(vao, 0);
-		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
-		glVertexArrayAttribBinding(vao, 0, 0);
-
-		glEnableVertexArrayAttrib(vao, 1);
-		glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, 0);
-		glVertexArrayAttribBinding(vao, 1, 1);
+		for (auto features : PATH_FEATURES) {
+			shaders.prepare(features);
+			shaders.prepare(features | FLAT_SHADING);
+		}
+
+		StateGL::cull_face(true);
+		StateGL::depth_test(true);
+		StateGL::blend(true);
+		StateGL::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		buffer_vertices = BufferGL(vertices);
+		buffer_normals = BufferGL(normals);
+		buffer_indices = BufferGL(indices);
+
+		pool_mesh = pool.add(vertices, normals, indices);
+
+		// The per-instance model matrix takes locations 2 to 5 and advances
+		// once per instance
+		auto model_columns = VertexLayout::format(GL_FLOAT_MAT4, 2, 2);
+		layout.attributes.insert(layout.attributes.end(), model_columns.begin(), model_columns.end());
+		layout.bindings.push_back({ .index = 2, .stride = sizeof(glm::mat4), .divisor = 1 });
 	}
 
 	void update(double dt) override
@@ -156,6 +208,15 @@ public:
 			}
 		}
 
+		for (auto features : PATH_FEATURES) {
+			for (auto flat : { 0u, FLAT_SHADING }) {
+				auto& shader = shaders.get(features | flat);
+
+				if (shader.ready())
+					shader.prewarm();
+			}
+		}
+
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplSDL2_NewFrame();
 		ImGui::NewFrame();
@@ -175,6 +236,8 @@ public:
 			ImGui::DragFloat3("Rotation##modelRotation", &model_rotation[0], 1.0f);
 			ImGui::ColorEdit3("Color##objectColor", &object_color.x);
 			ImGui::SliderFloat("Opacity##model_opacity", &model_opacity, 0.0f, 1.0f);
+			ImGui::SliderInt("Instances##instancesPerSide", &instances_per_side, 1, MAX_INSTANCES_PER_SIDE, "%d^2");
+			ImGui::DragFloat("Spacing##instanceSpacing", &instance_spacing, 0.05f, 0.0f, 10.0f);
 			ImGui::Separator();
 
 			ImGui::Text("Light");
@@ -183,12 +246,28 @@ public:
 			ImGui::SliderFloat("Ambient##ambientStrength", &ambient_strength, 0.0f, 1.0f);
 			ImGui::SliderFloat("Specular##specularStrength", &specular_strength, 0.0f, 1.0f);
 			ImGui::SliderInt("Shininess##specularShininess", &specular_shininess, 1, 256);
+			ImGui::SliderInt("Point lights##pointLights", &point_lights_count, 0, MAX_POINT_LIGHTS);
+			ImGui::SliderFloat("Radius##pointLightsRadius", &point_lights_radius, 0.5f, 20.0f);
+			ImGui::SliderFloat("Intensity##pointLightsIntensity", &point_lights_intensity, 0.0f, 20.0f);
 			ImGui::Separator();
 
 			ImGui::Text("Misc.");
 			ImGui::Checkbox("Wireframe", &wireframe);
 			ImGui::SameLine();
 			ImGui::Checkbox("Flat shading", &flat_shading);
+
+			ImGui::RadioButton("Instanced", &draw_path, INSTANCED); ImGui::SameLine();
+			ImGui::RadioButton("Draw list", &draw_path, DRAW_LIST); ImGui::SameLine();
+			ImGui::RadioButton("Render queue", &draw_path, RENDER_QUEUE);
+
+			auto stats = RenderStatsGL::stats();
+			ImGui::Text("Draws: %llu (%llu instances, %llu primitives)", (unsigned long long)stats.draws,
+				(unsigned long long)stats.instances, (unsigned long long)stats.primitives);
+			ImGui::Text("Binds: %llu programs, %llu VAOs, %llu textures, %llu uniforms", (unsigned long long)stats.program_binds,
+				(unsigned long long)stats.vao_binds, (unsigned long long)stats.texture_binds, (unsigned long long)stats.uniforms);
+			ImGui::Text("Uploads: %.1f KiB to buffers, %.1f KiB to textures",
+				stats.buffer_upload_bytes / 1024.0, stats.texture_upload_bytes / 1024.0);
+			ImGui::Text("State changes: %u issued, %u elided", stats.state_issued, stats.state_elided);
 		}; ImGui::End();
 
 		ImGui::EndFrame();
@@ -212,38 +291,123 @@ public:
 		model = glm::rotate(model, glm::radians(model_rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
 		model = glm::rotate(model, glm::radians(model_rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
-		shader.uniform("projection", projection);
-		shader.uniform("model", model);
-		shader.uniform("view", view);
-		shader.uniform("light_position", light_position);
-		shader.uniform("light_color", light_color);
-		shader.uniform("object_color", object_color);
-		shader.uniform("ambient_strength", ambient_strength);
-		shader.uniform("flat_shading", flat_shading);
-		shader.uniform("model_opacity", model_opacity);
-		shader.uniform("view_position", camera_position);
-		shader.uniform("specular_strength", specular_strength);
-		shader.uniform("specular_shininess", specular_shininess);
+		instances.clear();
+
+		float half_extent = (instances_per_side - 1) * instance_spacing * 0.5f;
+
+		for (int y = 0; y < instances_per_side; ++y) {
+			for (int x = 0; x < instances_per_side; ++x) {
+				auto offset = glm::vec3{ x * instance_spacing - half_extent, y * instance_spacing - half_extent, 0.0f };
+				instances.push_back(glm::translate(glm::mat4(1.0f), offset) * model);
+			}
+		}
 
-		glUseProgram(shader.id());
-		glBindVertexArray(vao);
+		// Point lights on a ring just outside the grid, slowly turning
 
-		if (wireframe)
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		else
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		float time = Time::seconds();
+		float ring = half_extent + instance_spacing * 0.5f;
 
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		point_lights.resize(point_lights_count);
 
-		glBindVertexArray(0);
-		glUseProgram(0);
+		for (int i = 0; i < point_lights_count; ++i) {
+			float angle = time * 0.5f + i * 2.0f * glm::pi<float>() / point_lights_count;
+			auto color = glm::vec3{ 0.5f + 0.5f * std::cos(i * 2.1f), 0.5f + 0.5f * std::cos(i * 2.1f + 2.0f), 0.5f + 0.5f * std::cos(i * 2.1f + 4.0f) };
+
+			point_lights[i] = {
+				glm::vec4(std::cos(angle) * ring, std::sin(angle) * ring, 1.5f, point_lights_radius),
+				glm::vec4(color, point_lights_intensity)
+			};
+		}
+
+		clustered_lights.update(point_lights);
+		clustered_lights.assign(view, projection, 0.1f, 100.0f, window.width(), window.height());
+
+		auto& shader = shaders.get(PATH_FEATURES[draw_path] | (flat_shading ? FLAT_SHADING : 0));
+
+		if (shader.ready()) {
+			clustered_lights.bind(shader);
+
+			shader.uniform("projection", projection);
+			shader.uniform("view", view);
+			shader.uniform("light_position", light_position);
+			shader.uniform("light_color", light_color);
+			shader.uniform("object_color", object_color);
+			shader.uniform("ambient_strength", ambient_strength);
+			shader.uniform("model_opacity", model_opacity);
+			shader.uniform("view_position", camera_position);
+			shader.uniform("specular_strength", specular_strength);
+			shader.uniform("specular_shininess", specular_shininess);
+
+			StateGL::use_program(shader.id());
+
+			if (wireframe)
+				StateGL::polygon_mode(GL_LINE);
+			else
+				StateGL::polygon_mode(GL_FILL);
+
+			if (draw_path == DRAW_LIST) {
+				draw_list.clear();
+
+				for (const auto& instance : instances)
+					draw_list.add(pool_mesh, instance);
+
+				StateGL::bind_vertex_array(pool_layout.vao());
+				pool.bind(pool_layout);
+
+				draw_list.submit(0);
+			} else if (draw_path == RENDER_QUEUE) {
+				RenderQueueGL::Bindings bindings;
+				bindings.vertex_buffers[0] = { .binding = 0, .buffer = buffer_vertices.id(), .stride = sizeof(vec3) };
+				bindings.vertex_buffers[1] = { .binding = 1, .buffer = buffer_normals.id(), .stride = sizeof(vec3) };
+
+				auto program = shader.id();
+				auto vao = pool_layout.vao();
+				auto model_location = glGetUniformLocation(program, "model");
+				auto view_projection = projection * view;
+
+				Jobs::parallel_for(instances_per_side, [&](uint32_t y) {
+					auto& commands = render_queue.buffer();
+					auto shared = commands.bindings(bindings);
+
+					for (int x = 0; x < instances_per_side; ++x) {
+						const auto& instance = instances[y * instances_per_side + x];
+						auto center = view_projection * instance[3];
+
+						commands.push(RenderQueueGL::key(0, 0, 0, center.z / center.w * 0.5f + 0.5f), RenderQueueGL::Draw{
+							.program = program,
+							.vao = vao,
+							.index_buffer = buffer_indices.id(),
+							.bindings = shared,
+							.model = commands.model(instance),
+							.model_location = model_location,
+							.count = static_cast<uint32_t>(indices.size())
+						});
+					}
+				});
+
+				// Every job is done once `parallel_for` returns
+				render_queue.flush();
+			} else if (auto allocation = buffer_instances.write(instances); allocation.data) {
+				StateGL::bind_vertex_array(layout.vao());
+				layout.bind_buffer(0, buffer_vertices.id());
+				layout.bind_buffer(1, buffer_normals.id());
+				layout.bind_buffer(2, buffer_instances.id(), allocation.offset);
+				layout.bind_index_buffer(buffer_indices.id());
+
+				glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instances.size());
+				RenderStatsGL::draw(GL_TRIANGLES, indices.size(), instances.size());
+			}
+		}
 
 		if (ImGui::GetFrameCount() > 0) {
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		SDL_GL_SwapWindow(window.sdl_window());
+		window.swap();
+
+		buffer_instances.next_frame();
+		clustered_lights.next_frame();
 	}
 };
 
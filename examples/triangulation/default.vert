@@ -1,7 +1,7 @@
 #version 450 core
 
-in vec3 vertex;
-in vec3 normal;
+layout(location = 0) in vec3 vertex;
+layout(location = 1) in vec3 normal;
 
 uniform mat4 projection;
 uniform mat4 view;
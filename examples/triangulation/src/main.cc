@@ -7,7 +7,12 @@
 #include "backends/imgui_impl_sdl2.h"
 #include "pistacchio/app.hh"
 #include "pistacchio/filesystem/obj.hh"
+#include "pistacchio/gl/debug_draw.hh"
+#include "pistacchio/gl/mesh.hh"
+#include "pistacchio/gl/picking.hh"
 #include "pistacchio/gl/shader.hh"
+#include "pistacchio/gl/state.hh"
+#include "pistacchio/gl/vertex_layout.hh"
 #include "pistacchio/gl/window.hh"
 #include "pistacchio/input.hh"
 #include "pistacchio/time.hh"
@@ -47,6 +52,8 @@ private:
 	int previous_algorithm = Algorithm::DELAUNAY;
 	bool shading = true;
 	bool show_camera_window = true;
+	bool show_normals = false;
+	bool show_bounds = false;
 
 	std::vector<vec3> normals;
 	std::vector<uint32_t> indices;
@@ -59,10 +66,22 @@ private:
 	vec3 camera_position = vec3{ 0.0f, 0.0f, -4.5f };
 	vec3 camera_rotation = vec3{ 0.0f, 30.0f, 0.0f };
 
-	u32 vao = GL_NONE;
-	u32 buffer_vertices = GL_NONE;
-	u32 buffer_normals = GL_NONE;
-	u32 buffer_indices = GL_NONE;
+	VertexLayout layout = {
+		.attributes = {
+			{ .location = 0, .size = 3, .type = GL_FLOAT, .binding = 0 },
+			{ .location = 1, .size = 3, .type = GL_FLOAT, .binding = 1 },
+		},
+		.bindings = {
+			{ .index = 0, .stride = sizeof(float) * 3 },
+			{ .index = 1, .stride = sizeof(float) * 3 },
+		},
+	};
+
+	MeshGL mesh_cloud;
+	MeshGL mesh_sphere;
+
+	DebugDrawGL debug_draw;
+	PickingGL picking;
 public:
 	Delaunay() : App(30.0, 120.0)
 	{
@@ -76,43 +95,10 @@ public:
 		// OpenGL initialization
 
 		glEnable(GL_PROGRAM_POINT_SIZE);
-		glEnable(GL_DEPTH_TEST);
-
-		glCreateBuffers(1, &buffer_vertices);
-		glNamedBufferData(
-			buffer_vertices,
-			sphere.size() * sizeof(float) * 3,
-			sphere.data(),
-			GL_DYNAMIC_DRAW);
-
-		glCreateBuffers(1, &buffer_normals);
-		glNamedBufferData(
-			buffer_normals,
-			normals.size() * sizeof(float) * 3,
-			normals.data(),
-			GL_DYNAMIC_DRAW
-		);
-
-		glCreateBuffers(1, &buffer_indices);
-		glNamedBufferData(
-			buffer_indices,
-			indices.size() * sizeof(uint32_t),
-			indices.data(),
-			GL_DYNAMIC_DRAW
-		);
-
-		glCreateVertexArrays(1, &vao);
-		glVertexArrayVertexBuffer(vao, 0, buffer_vertices, 0, sizeof(float) * 3);
-		glEnableVertexArrayAttrib(vao, 0);
-		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
-		glVertexArrayAttribBinding(vao, 0, 0);
-
-		glVertexArrayVertexBuffer(vao, 1, buffer_normals, 0, sizeof(float) * 3);
-		glEnableVertexArrayAttrib(vao, 1);
-		glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, 0);
-		glVertexArrayAttribBinding(vao, 1, 1);
-
-		glVertexArrayElementBuffer(vao, buffer_indices);
+		StateGL::depth_test(true);
+
+		mesh_cloud.vertices(sphere_cloud);
+		mesh_sphere = MeshGL(sphere, normals);
 	}
 protected:
 	void update(double dt) override
@@ -129,6 +115,11 @@ protected:
 			}
 		}
 
+		// Warm up the program once the driver is done compiling it
+
+		if (shader.ready())
+			shader.prewarm();
+
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplSDL2_NewFrame();
 		ImGui::NewFrame();
@@ -184,8 +175,16 @@ protected:
 				ImGui::RadioButton("Points", &render_mode, POINTS);
 
 				ImGui::Checkbox("Shading", &shading);
+				ImGui::Checkbox("Normals", &show_normals); ImGui::SameLine();
+				ImGui::Checkbox("Bounds", &show_bounds);
 
 				ImGui::LabelText("Algorithm Time", "%.2f", (time_algorithm_end - time_algorithm_start));
+
+				auto& hit = Input::hovered();
+				if (hit.valid)
+					ImGui::LabelText("Hovered", "Triangle %u", hit.primitive);
+				else
+					ImGui::LabelText("Hovered", "None");
 			}; ImGui::End();
 		}
 
@@ -200,45 +199,19 @@ protected:
 					sphere = delaunay(sphere_cloud);
 					time_algorithm_end = Time::seconds();
 
-					glNamedBufferData(
-						buffer_vertices,
-						sphere.size() * sizeof(float) * 3,
-						sphere.data(),
-						GL_DYNAMIC_DRAW);
-
-					glNamedBufferData(
-						buffer_normals,
-						normals.size() * sizeof(float) * 3,
-						normals.data(),
-						GL_DYNAMIC_DRAW
-					);
+					// Drawn as a triangle soup
+					indices.clear();
 					break;
 				case MARCHING_CUBES:
 					time_algorithm_start = Time::seconds();
 					sphere = marching_cubes(sphere_field, ivec3{ 100, 100, 100 });
 					time_algorithm_end = Time::seconds();
-
-					glNamedBufferData(
-						buffer_vertices,
-						sphere.size() * sizeof(float) * 3,
-						sphere.data(),
-						GL_DYNAMIC_DRAW);
-
-					glNamedBufferData(
-						buffer_indices,
-						indices.size() * sizeof(uint32_t),
-						indices.data(),
-						GL_DYNAMIC_DRAW
-					);
-
-					glNamedBufferData(
-						buffer_normals,
-						normals.size() * sizeof(float) * 3,
-						normals.data(),
-						GL_DYNAMIC_DRAW
-					);
-	 				break;
+					break;
 			}
+
+			mesh_sphere.vertices(sphere);
+			mesh_sphere.normals(normals);
+			mesh_sphere.indices(indices);
 		}
 	}
 
@@ -258,65 +231,95 @@ protected:
 		view = glm::rotate(view, glm::radians(camera_rotation[1]), glm::vec3(0.0f, 1.0f, 0.0f));
 		view = glm::rotate(view, glm::radians(camera_rotation[2]), glm::vec3(0.0f, 0.0f, 1.0f));
 
-		shader.uniform("projection", projection);
-		shader.uniform("model", model);
-		shader.uniform("view", view);
-		shader.uniform("shading", shading);
-
-		glUseProgram(shader.id());
-		glBindVertexArray(vao);
-
-		switch (render_mode) {
-		case SOLID:
-			glNamedBufferData(
-				buffer_vertices,
-				sphere.size() * sizeof(float) * 3,
-				sphere.data(),
-				GL_DYNAMIC_DRAW);
-
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-			if (algorithm == Algorithm::DELAUNAY)
-				glDrawArrays(GL_TRIANGLES, 0, sphere.size());
-			else
-				glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-			break;
-		case WIREFRAME:
-			glNamedBufferData(
-				buffer_vertices,
-				sphere.size() * sizeof(float) * 3,
-				sphere.data(),
-				GL_DYNAMIC_DRAW);
-
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-			if (algorithm == Algorithm::DELAUNAY)
-				glDrawArrays(GL_TRIANGLES, 0, sphere.size());
-			else
-				glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-			// glDrawArrays(GL_TRIANGLES, 0, sphere.size());
-			// glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-			break;
-		case POINTS:
-			glNamedBufferData(
-				buffer_vertices,
-				sphere_cloud.size() * sizeof(float) * 3,
-				sphere_cloud.data(),
-				GL_DYNAMIC_DRAW);
-
-			glDrawArrays(GL_POINTS, 0, sphere_cloud.size());
-			break;
+		if (shader.ready()) {
+			shader.uniform("projection", projection);
+			shader.uniform("model", model);
+			shader.uniform("view", view);
+			shader.uniform("shading", shading);
+
+			StateGL::use_program(shader.id());
+			StateGL::bind_vertex_array(layout.vao());
+
+			// No-ops unless the algorithm changed
+			mesh_sphere.upload();
+			mesh_cloud.upload();
+
+			switch (render_mode) {
+			case SOLID:
+				StateGL::polygon_mode(GL_FILL);
+
+				mesh_sphere.bind(layout);
+				mesh_sphere.draw();
+				break;
+			case WIREFRAME:
+				StateGL::polygon_mode(GL_LINE);
+
+				mesh_sphere.bind(layout);
+				mesh_sphere.draw();
+				// glDrawArrays(GL_TRIANGLES, 0, sphere.size());
+				// glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+				break;
+			case POINTS:
+				// Points have no normals of their own, shading uses the
+				// sphere's
+				layout.bind_buffer(0, mesh_cloud.vertex_buffer());
+				layout.bind_buffer(1, mesh_sphere.normal_buffer());
+
+				mesh_cloud.draw(GL_POINTS);
+				break;
+			}
+		}
+
+		// Triangle under the cursor, read back a frame or two later
+
+		if (shader.ready() && render_mode != POINTS) {
+			picking.begin(projection * view, window.width(), window.height());
+			picking.object(1, model);
+
+			StateGL::polygon_mode(GL_FILL);
+			mesh_sphere.bind(layout);
+			mesh_sphere.draw();
+
+			picking.end();
+		}
+
+		// Debug shapes, all in a couple of draws
+
+		auto& debug = debug_draw.batch();
+		auto& hit = Input::hovered();
+
+		if (hit.valid && render_mode != POINTS) {
+			size_t first = hit.primitive * 3;
+			auto vertex = [&](size_t i) { return indices.empty() ? sphere[first + i] : sphere[indices[first + i]]; };
+
+			if (first + 2 < (indices.empty() ? sphere.size() : indices.size()))
+				debug.triangle(vertex(0), vertex(1), vertex(2), glm::vec4(1.0f, 0.2f, 0.2f, 1.0f), DebugDrawGL::OVERLAY);
+		}
+
+		if (show_normals && normals.size() == sphere.size())
+			for (size_t i = 0; i < sphere.size(); ++i)
+				debug.line(sphere[i], sphere[i] + normals[i] * 0.1f, glm::vec4(0.2f, 0.6f, 1.0f, 1.0f));
+
+		if (show_bounds && !sphere.empty()) {
+			vec3 min = sphere[0];
+			vec3 max = sphere[0];
+
+			for (const auto& v : sphere) {
+				min = glm::min(min, v);
+				max = glm::max(max, v);
+			}
+
+			debug.box(min, max, glm::vec4(1.0f, 0.8f, 0.2f, 1.0f), DebugDrawGL::OVERLAY);
 		}
 
-		glBindVertexArray(0);
-		glUseProgram(0);
+		debug_draw.draw(projection * view * model);
 
 		if (ImGui::GetFrameCount() > 0) {
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		SDL_GL_SwapWindow(window.sdl_window());
+		window.swap();
 	}
 
 	std::vector<vec3> sphere_points(size_t latitude = 14, size_t longitude = 14, float radius = 1.0f)
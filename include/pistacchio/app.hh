@@ -15,7 +15,9 @@ public:
 	App(double fixed_rate, double target_rate);
 	virtual ~App();
 
+	double fixed_rate() const;
 	void fixed_rate(double value);
+	double target_rate() const;
 	void target_rate(double value);
 
 	// Starts running application.
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+// Farthest-depth pyramid on the CPU, for occlusion tests against a depth
+// buffer rendered earlier, usually a level of `HiZGL` read back from the GPU.
+//
+// Depth is window depth in [0, 1] with GL conventions (y up). Boxes are
+// tested with the view-projection the depth was rendered with, so tests stay
+// conservative for static occluders while the camera moves.
+class DepthPyramid {
+public:
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> depth;
+	};
+private:
+	std::vector<Level> m_levels;
+	glm::mat4 m_view_projection;
+public:
+	DepthPyramid();
+
+	// Builds the pyramid down to 1x1 from `width` x `height` depths rendered
+	// with `view_projection`. With odd sizes the last texel of a level also
+	// covers the extra row/column of the one above, like on the GPU.
+	void build(uint32_t width, uint32_t height, std::vector<float> depth, const glm::mat4& view_projection);
+
+	void clear();
+	bool empty() const;
+
+	// Finest level where a box of `extent` (in UV) spans at most 2x2 texels,
+	// or the coarsest one if it never does.
+	uint32_t level(float extent_x, float extent_y) const;
+
+	// Returns true if the box is behind the depth everywhere it covers, false
+	// when it isn't or when unsure (empty pyramid, box crossing the near
+	// plane...).
+	bool occluded(const glm::vec3& min, const glm::vec3& max) const;
+
+	const std::vector<Level>& levels() const;
+	const glm::mat4& view_projection() const;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "pistacchio/filesystem/mapped_file.hh"
+
+//
+// Use `CompressedImage::load` to map a .dds or .ktx2 file of block-compressed
+// mip levels. Levels point straight into the mapping, nothing is copied.
+//
+// Only plain 2D images are read: the first layer and face of arrays and cube
+// maps, no 3D images and no KTX2 supercompression (Basis, zstd).
+//
+// Specifications:
+// https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dx-graphics-dds-pguide
+// https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+//
+struct CompressedImage {
+	enum Format {
+		UNKNOWN,
+		BC1,   // RGB + 1-bit alpha, 8 bytes per block
+		BC3,   // RGBA, 16 bytes per block
+		BC4,   // R, 8 bytes per block
+		BC5,   // RG, 16 bytes per block
+		BC7,   // RGBA, 16 bytes per block
+	};
+
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		const uint8_t* data;
+		size_t size;
+	};
+
+	Format format = UNKNOWN;
+	bool srgb = false;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<Level> levels;
+	MappedFile file;
+
+	bool valid() const;
+
+	// Logs a warning and returns an invalid image on failure.
+	static CompressedImage load(const std::string& path);
+
+	// Bytes per 4x4 block.
+	static uint32_t block_size(Format format);
+
+	// Channels of the decompressed pixels: 4 for BC1, BC3 and BC7, 1 for BC4
+	// and 2 for BC5.
+	static uint32_t channels(Format format);
+
+	// Decompresses a level to tightly packed 8-bit pixels of
+	// `channels(format)`. `pixels` must hold `width * height * channels`
+	// bytes. Block rows are decoded in parallel with `Jobs`.
+	static void decompress(Format format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* pixels);
+
+	static const char* to_string(Format format);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Read-only memory mapping of a whole file, with mmap on POSIX and file
+// mappings on Windows. Pages are only read from disk when touched, so
+// parsing a header doesn't load the rest of the file.
+class MappedFile {
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+public:
+	MappedFile(); // This creates an invalid file
+
+	// Logs a warning and creates an invalid file on failure.
+	explicit MappedFile(const std::string& path);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	const uint8_t* data() const;
+	size_t size() const;
+	bool valid() const;
+private:
+	void release();
+};
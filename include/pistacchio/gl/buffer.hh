@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+// Buffer backed by immutable storage.
+//
+// Static buffers are created with their contents and are never reallocated;
+// pass `DYNAMIC` to be able to `update` them afterwards.
+//
+// Streaming buffers (see `stream`) are a persistently mapped, coherent ring
+// split in one region per frame in flight. The CPU writes into the current
+// frame's region while the GPU reads the previous ones, and a fence per region
+// makes sure data still in use is never overwritten.
+class BufferGL {
+public:
+	static constexpr uint32_t DYNAMIC = GL_DYNAMIC_STORAGE_BIT;
+
+	struct Allocation {
+		void* data;        // Where the CPU writes, nullptr if it didn't fit
+		uint32_t offset;   // Offset in the buffer to bind or draw from
+		uint32_t size;
+	};
+private:
+	uint32_t m_name;
+	size_t m_size;
+
+	// Streaming only
+	uint8_t* m_mapping;
+	size_t m_frame_size;
+	uint32_t m_frame;
+	size_t m_head;
+	std::vector<GLsync> m_fences;
+public:
+	BufferGL(); // This creates an invalid buffer
+	BufferGL(size_t size, const void* data = nullptr, uint32_t flags = 0);
+
+	template<class Ty>
+	BufferGL(const std::vector<Ty>& data, uint32_t flags = 0) :
+		BufferGL(data.size() * sizeof(Ty), data.data(), flags)
+	{}
+
+	BufferGL(const BufferGL&) = delete;
+	BufferGL(BufferGL&& other) noexcept;
+	~BufferGL();
+
+	BufferGL& operator=(const BufferGL&) = delete;
+	BufferGL& operator=(BufferGL&& other) noexcept;
+
+	// Creates a streaming ring of `frames` regions of `frame_size` bytes,
+	// rounded up to `offset_alignment` so every region starts aligned.
+	static BufferGL stream(size_t frame_size, uint32_t frames = 3);
+
+	// Offset alignment that satisfies both SSBO and UBO ranges, at least 256
+	// bytes.
+	static size_t offset_alignment();
+
+	uint32_t id() const;
+	size_t size() const;
+	bool streaming() const;
+
+	// Files the buffer under `tag` in `MemoryGL`.
+	void tag(const std::string& tag) const;
+
+	// Writes `size` bytes at `offset` of a static buffer created with
+	// `DYNAMIC`.
+	void update(size_t offset, size_t size, const void* data);
+
+	// Reserves `size` bytes in the current frame's region of a streaming
+	// buffer, at an offset in the buffer that's a multiple of `alignment`.
+	// SSBO and UBO ranges need `offset_alignment`.
+	Allocation allocate(size_t size, size_t alignment = 4);
+
+	// Allocates and copies `count` elements of `data`.
+	template<class Ty>
+	Allocation write(const Ty* data, size_t count, size_t alignment = 4);
+
+	template<class Ty>
+	Allocation write(const std::vector<Ty>& data, size_t alignment = 4)
+	{
+		return write(data.data(), data.size(), alignment);
+	}
+
+	// Fences the current frame's region and moves to the next one, waiting
+	// for the GPU if it's still reading from it. Call once per frame, after
+	// the draws that read this frame's allocations.
+	void next_frame();
+private:
+	void release();
+};
+
+template<class Ty>
+BufferGL::Allocation BufferGL::write(const Ty* data, size_t count, size_t alignment)
+{
+	auto allocation = allocate(count * sizeof(Ty), alignment);
+
+	if (allocation.data)
+		std::copy(data, data + count, static_cast<Ty*>(allocation.data));
+
+	return allocation;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "pistacchio/gl/buffer.hh"
+
+// Asynchronous captures of the default framebuffer.
+//
+// Frames are read into a ring of persistently mapped pixel pack buffers and
+// fenced. Once the GPU is done with one, a few frames later, the buffer is
+// handed as it is to a small pool of encoder threads that write it to disk, as
+// PNG or as raw RGBA for video sequences. The render thread never waits on the
+// GPU copy nor copies pixels itself.
+//
+// A buffer is only reused once its frame is written, so at most `FRAMES`
+// frames are in flight (about 66 MB at 1080p). When encoding can't keep up
+// with recording, frames that find no free buffer are dropped with a warning
+// rather than queued without bound; see `dropped`. Screenshots are delayed to
+// the next frame with a free buffer instead.
+class CaptureGL {
+public:
+	enum Format {
+		PNG,
+		RAW,       // Top-down RGBA8, no header
+	};
+private:
+	static constexpr uint32_t FRAMES = 8;
+	static constexpr uint32_t ENCODERS = 4;
+
+	struct Slot {
+		BufferGL buffer;
+		const uint8_t* pixels = nullptr;   // Persistent mapping of `buffer`
+		GLsync fence = nullptr;
+		bool encoding = false;             // Guarded by `m_mutex`
+		std::string path;
+		Format format;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	std::array<Slot, FRAMES> m_slots;
+	uint32_t m_next;
+	uint32_t m_width;
+	uint32_t m_height;
+
+	std::string m_screenshot;
+	std::string m_prefix;
+	Format m_format;
+	uint32_t m_frame;
+	uint32_t m_dropped;
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	std::deque<Slot*> m_jobs;
+	bool m_stop;
+public:
+	CaptureGL();
+
+	CaptureGL(const CaptureGL&) = delete;
+	~CaptureGL();
+
+	CaptureGL& operator=(const CaptureGL&) = delete;
+
+	// Saves the next frame as a PNG.
+	void screenshot(const std::string& path);
+
+	// Saves every frame from now on, as `prefix` followed by the frame
+	// number.
+	void record(const std::string& prefix, Format format = PNG);
+	void stop();
+	bool recording() const;
+
+	// Frames waiting to be written to disk.
+	size_t queued();
+
+	// Recorded frames dropped because every buffer was still in flight, since
+	// the last `record`.
+	uint32_t dropped() const;
+
+	// Reads the finished frame from the default framebuffer if a capture was
+	// requested and collects earlier readbacks that are ready. Call right
+	// before swapping.
+	void capture(uint32_t width, uint32_t height);
+
+	// Collects every readback in flight, waiting for the GPU and the
+	// encoders, and frees the buffers. Must be called while the context is
+	// still alive.
+	void finish();
+private:
+	void collect(bool wait);
+	void complete(Slot& slot, bool wait);
+	void worker();
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/compute.hh"
+#include "pistacchio/gl/shader.hh"
+
+// Clustered forward lighting: the view frustum is split in a grid of tiles
+// and exponential depth slices, a compute pass assigns every light to the
+// clusters its sphere touches, and fragment shaders only evaluate the lights
+// of their own cluster.
+//
+// Fragment shaders get the lights with
+//
+//     #include "pistacchio/clustered_lights.glsl"
+//     ...
+//     vec3 light = clustered_lighting(world_position, world_normal, view_depth);
+//
+// where `view_depth` is the positive distance along the view direction, after
+// `bind` set up the program.
+class ClusteredLightsGL {
+public:
+	// std430 layout of a light
+	struct Light {
+		glm::vec4 position_radius;   // World space position and radius of influence
+		glm::vec4 color_intensity;
+	};
+
+	// SSBO binding points used by the GLSL side
+	static constexpr uint32_t LIGHTS_BINDING = 4;
+	static constexpr uint32_t COUNTS_BINDING = 5;
+	static constexpr uint32_t INDICES_BINDING = 6;
+
+	static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+private:
+	uint32_t m_max_lights;
+	uint32_t m_lights_count;
+	glm::ivec2 m_grid;
+	int32_t m_slices;
+	glm::vec2 m_depth;
+	glm::vec2 m_viewport;
+
+	BufferGL m_lights;
+	BufferGL::Allocation m_allocation;
+	BufferGL m_counts;
+	BufferGL m_indices;
+	ComputeGL m_shader;
+public:
+	ClusteredLightsGL(uint32_t max_lights, uint32_t grid_x = 16, uint32_t grid_y = 9, uint32_t slices = 24);
+
+	// Sets this frame's lights.
+	void update(const std::vector<Light>& lights);
+
+	// Assigns lights to the clusters of the camera's frustum. `near` and `far`
+	// must match `projection`.
+	void assign(const glm::mat4& view, const glm::mat4& projection, float near, float far, uint32_t width, uint32_t height);
+
+	// Binds the light lists and sets the uniforms `clustered_lighting` needs.
+	void bind(ShaderGL& shader) const;
+
+	// Moves the light ring on, call once per frame after the draws.
+	void next_frame();
+
+	uint32_t size() const;
+	uint32_t clusters() const;
+};
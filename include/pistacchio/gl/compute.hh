@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/shader.hh"
+
+// Compute program with reflection of its shader storage blocks and image
+// uniforms, so buffers and images can be bound by name as well as by binding
+// point, and dispatch and barrier helpers.
+//
+// Compilation is asynchronous like `ShaderGL`'s, reflection happens once
+// `ready()` or `wait()` find the program linked. Binding by name before that
+// does nothing.
+class ComputeGL {
+public:
+	struct StorageBlock {
+		uint32_t binding;
+		int32_t size;      // Size of the fixed part, without a trailing unsized array
+	};
+
+	struct Image {
+		uint32_t unit;
+		uint32_t type;     // GL_IMAGE_2D, GL_UNSIGNED_INT_IMAGE_3D...
+	};
+
+	using StorageBlocksMap = std::unordered_map<std::string, StorageBlock>;
+	using ImagesMap = std::unordered_map<std::string, Image>;
+private:
+	ShaderGL m_shader;
+	bool m_reflected;
+	std::array<uint32_t, 3> m_local_size;
+	StorageBlocksMap m_storage_blocks;
+	ImagesMap m_images;
+
+	ComputeGL(ShaderGL&& shader);
+public:
+	// Loads the compute shader at `path`, see `ShaderGL::preprocess`.
+	ComputeGL(const std::string& path, const std::vector<std::string>& defines = {});
+
+	// Builds the program from an in-memory source, see `ShaderGL::from_source`.
+	static ComputeGL from_source(const std::string& source,
+	                             const std::vector<std::string>& defines = {},
+	                             const std::string& name = "<source>");
+
+	uint32_t id() const;
+	ShaderGL::State state() const;
+	bool ready();
+	void wait();
+
+	// Declared work group size, 0 until ready.
+	std::array<uint32_t, 3> local_size() const;
+
+	StorageBlocksMap storage_blocks() const;
+	ImagesMap images() const;
+
+	template<class Ty>
+	void uniform(const char* uniform, const Ty& value)
+	{
+		m_shader.uniform(uniform, value);
+	}
+
+	// Binds `buffer`, or `size` bytes of it from `offset`, as a shader
+	// storage block. Offsets must match GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT.
+	void bind(uint32_t binding, const BufferGL& buffer);
+	void bind(uint32_t binding, const BufferGL& buffer, size_t offset, size_t size);
+	void bind(const std::string& block, const BufferGL& buffer);
+	void bind(const std::string& block, const BufferGL& buffer, size_t offset, size_t size);
+
+	// Binds `level` of `texture` to an image unit. `access` is GL_READ_ONLY,
+	// GL_WRITE_ONLY or GL_READ_WRITE and `format` must match the image's
+	// layout qualifier.
+	void bind_image(uint32_t unit, uint32_t texture, uint32_t access, uint32_t format, int32_t level = 0);
+	void bind_image(const std::string& image, uint32_t texture, uint32_t access, uint32_t format, int32_t level = 0);
+
+	// Binds a texture for sampling, through `StateGL`.
+	void bind_texture(uint32_t unit, uint32_t texture);
+
+	// Dispatches `x` * `y` * `z` work groups.
+	void dispatch(uint32_t x, uint32_t y = 1, uint32_t z = 1);
+
+	// Dispatches enough work groups to cover `x` * `y` * `z` invocations,
+	// shaders have to skip the ones past the end.
+	void dispatch_threads(uint32_t x, uint32_t y = 1, uint32_t z = 1);
+
+	// Dispatches with the group counts read from `buffer` at `offset`, three
+	// uints as in DispatchIndirectCommand.
+	void dispatch_indirect(const BufferGL& buffer, intptr_t offset = 0);
+
+	// Makes writes from earlier dispatches visible to the operations in
+	// `bits`, see glMemoryBarrier. The helpers below cover the usual cases.
+	static void barrier(uint32_t bits);
+
+	// Storage buffers read by later shaders.
+	static void storage_barrier();
+
+	// Images read by later shaders through image load/store.
+	static void image_barrier();
+
+	// Buffers consumed as indirect draw or dispatch arguments.
+	static void command_barrier();
+private:
+	void reflect();
+};
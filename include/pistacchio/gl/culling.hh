@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/compute.hh"
+#include "pistacchio/gl/geometry_pool.hh"
+#include "pistacchio/gl/hiz.hh"
+
+// GPU-driven culling: a compute pass tests the bounding sphere of every object
+// against the view frustum, and optionally a Hi-Z pyramid, and writes the
+// indirect draw commands of the survivors, which are then drawn with a single
+// multi-draw. Nothing is read back on the CPU.
+//
+// When GL 4.6 or GL_ARB_indirect_parameters is available survivors are
+// compacted and the draw count is read from a GPU buffer
+// (glMultiDrawElementsIndirectCount). Otherwise, e.g. on older llvmpipe,
+// culled objects keep their command slot with an instance count of 0.
+//
+// Each command's `base_instance` is the object's index, so vertex shaders find
+// their per-object data either through a per-instance attribute (divisor 1)
+// or with `gl_BaseInstance`. `gl_DrawID` does not match the object once
+// commands are compacted.
+class CullingGL {
+public:
+	// std430 layout of an object as read by the compute pass
+	struct Object {
+		glm::vec4 sphere;          // World space center and radius
+		uint32_t count;
+		uint32_t first_index;
+		int32_t base_vertex;
+		uint32_t padding = 0;
+	};
+private:
+	uint32_t m_max_objects;
+	uint32_t m_objects_count;
+	BufferGL m_objects;
+	BufferGL m_commands;
+	BufferGL m_count;
+	ComputeGL m_shader;
+	ComputeGL m_shader_hiz;
+public:
+	CullingGL(uint32_t max_objects);
+
+	// Replaces the objects to cull. Only call when they change, not every
+	// frame.
+	void set(const std::vector<Object>& objects);
+
+	// Updates a single object, e.g. after it moved.
+	void set(uint32_t index, const Object& object);
+
+	uint32_t size() const;
+
+	// Runs the culling pass for `view_projection`. With `hiz` objects hidden
+	// behind the depth it was built from are culled as well.
+	//
+	// Returns false without culling while the compute shader is still
+	// compiling, `draw` then reuses the commands of the last pass (nothing
+	// before the first one).
+	bool cull(const glm::mat4& view_projection, const HiZGL* hiz = nullptr);
+
+	// Draws the survivors of the last `cull`. The program and a VAO with the
+	// geometry bound must already be bound.
+	void draw(uint32_t mode = GL_TRIANGLES);
+
+	uint32_t command_buffer() const;
+	uint32_t count_buffer() const;
+
+	// Returns true if survivors are compacted and counted on the GPU.
+	static bool compaction();
+
+	static Object object(const GeometryPoolGL::Mesh& mesh, const glm::vec3& center, float radius);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <glad/gl.h>
+
+// Routes KHR_debug messages (errors, performance warnings, driver hints such
+// as buffer migrations) into `Log`, by severity. A message ID that keeps
+// firing is only logged once per `interval`, with a count of how many were
+// suppressed in between.
+//
+// Drivers only report everything with a debug context, see `WindowGL`.
+class DebugGL {
+public:
+	// Names a scope of GL commands in captures (RenderDoc, Nsight...) and in
+	// the driver's own messages.
+	class Group {
+	public:
+		Group(const std::string& name);
+
+		Group(const Group&) = delete;
+		~Group();
+
+		Group& operator=(const Group&) = delete;
+	};
+private:
+	struct Counter {
+		double last;
+		uint32_t suppressed;
+	};
+
+	static std::mutex s_mutex;
+	static std::unordered_map<uint64_t, Counter> s_counters;
+	static double s_interval;
+	static bool s_enabled;
+
+	DebugGL() = default;
+public:
+	// Installs the callback. Synchronous output reports messages on the
+	// thread and at the call that caused them, at some cost.
+	static void enable(bool synchronous = true);
+	static bool enabled();
+
+	// Minimum seconds between two logs of the same message ID.
+	static void interval(double seconds);
+
+	static void push(const std::string& name);
+	static void pop();
+private:
+	static void GLAD_API_PTR callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+	                                  GLsizei length, const GLchar* message, const void* user);
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/shader.hh"
+#include "pistacchio/gl/vertex_layout.hh"
+
+// Immediate-mode debug drawing: lines, boxes, spheres and frustums are
+// recorded from any thread into per-thread batches, and `draw` streams all of
+// them into one buffer and renders them with a draw call per primitive type
+// and layer, however many shapes there are.
+//
+// Shapes on the `DEPTH_TESTED` layer are hidden by the scene, `OVERLAY` ones
+// are drawn on top of everything.
+class DebugDrawGL {
+public:
+	enum Layer {
+		DEPTH_TESTED,
+		OVERLAY,
+	};
+
+	struct Vertex {
+		glm::vec3 position;
+		uint32_t color;    // RGBA8
+	};
+
+	// Shapes recorded by a single thread.
+	class Batch {
+	private:
+		static constexpr uint32_t LAYERS = 2;
+
+		std::array<std::vector<Vertex>, LAYERS> m_lines;
+		std::array<std::vector<Vertex>, LAYERS> m_triangles;
+
+		friend class DebugDrawGL;
+	public:
+		void line(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color, Layer layer = DEPTH_TESTED);
+		void triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec4& color, Layer layer = DEPTH_TESTED);
+
+		// Axis-aligned box.
+		void box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, Layer layer = DEPTH_TESTED);
+
+		// The [-1, 1] cube through `transform`, for oriented boxes.
+		void box(const glm::mat4& transform, const glm::vec4& color, Layer layer = DEPTH_TESTED);
+
+		// Three great circles of `segments` lines each.
+		void sphere(const glm::vec3& center, float radius, const glm::vec4& color, Layer layer = DEPTH_TESTED, uint32_t segments = 24);
+
+		// Edges of the volume seen through `view_projection`.
+		void frustum(const glm::mat4& view_projection, const glm::vec4& color, Layer layer = DEPTH_TESTED);
+
+		size_t size() const;
+		void clear();
+	private:
+		void cube(const std::array<glm::vec3, 8>& corners, const glm::vec4& color, Layer layer);
+	};
+private:
+	size_t m_max_vertices;
+
+	std::mutex m_mutex;
+	std::vector<std::pair<std::thread::id, std::unique_ptr<Batch>>> m_batches;
+
+	BufferGL m_vertices;
+	VertexLayout m_layout;
+	ShaderGL m_shader;
+public:
+	DebugDrawGL(size_t max_vertices = 1 << 18);
+
+	// Batch of the calling thread. Fetch it once per job rather than once per
+	// shape, it takes a lock.
+	Batch& batch();
+
+	// Draws and clears everything recorded since the last call, into the
+	// bound framebuffer. Call once per frame, when recording threads are done.
+	// Leaves depth testing enabled and returns the number of draw calls.
+	uint32_t draw(const glm::mat4& view_projection);
+};
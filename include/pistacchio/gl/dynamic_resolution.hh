@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Renders the scene into an offscreen target whose resolution follows the
+// measured GPU time, then upscales it to the backbuffer. Whatever is drawn
+// after `end` (e.g. ImGui) stays at native resolution.
+//
+// The target is allocated at full size and only a corner of it is used, so
+// changing the scale never reallocates. GPU time is measured with timer
+// queries read a couple of frames later without stalling.
+class DynamicResolutionGL {
+private:
+	static constexpr uint32_t QUERIES = 3;
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_color;
+	uint32_t m_depth;
+	uint32_t m_framebuffer;
+
+	bool m_enabled;
+	double m_target_rate;
+	float m_scale;
+	float m_min_scale;
+	float m_max_scale;
+	double m_gpu_time;         // Smoothed, in milliseconds
+
+	std::array<uint32_t, QUERIES> m_queries;
+	std::array<bool, QUERIES> m_pending;
+	bool m_timing;             // Current frame is being timed
+	uint32_t m_frame;
+public:
+	DynamicResolutionGL(uint32_t width, uint32_t height);
+
+	DynamicResolutionGL(const DynamicResolutionGL&) = delete;
+	~DynamicResolutionGL();
+
+	DynamicResolutionGL& operator=(const DynamicResolutionGL&) = delete;
+
+	// Resizes the target to the new backbuffer size, if it changed.
+	void resize(uint32_t width, uint32_t height);
+
+	// When disabled the scene renders at native resolution.
+	bool enabled() const;
+	void enabled(bool value);
+
+	// Frame rate the GPU time budget comes from, usually
+	// `App::target_rate()`. 0 disables scaling.
+	void target_rate(double value);
+
+	void scale_limits(float min, float max);
+	float scale() const;
+
+	// Smoothed GPU time of the scene, in milliseconds.
+	double gpu_time() const;
+
+	uint32_t render_width() const;
+	uint32_t render_height() const;
+	uint32_t framebuffer() const;
+	uint32_t color_texture() const;
+	uint32_t depth_texture() const;
+
+	// Binds the offscreen target with a viewport of the scaled size.
+	void begin();
+
+	// Upscales the scene to the backbuffer, binds it back and adjusts the
+	// scale for the next frames.
+	void end();
+private:
+	void release();
+	void adjust();
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+// Describes a frame as a list of passes and the textures they read and write,
+// then runs it:
+//
+// - Passes whose results nobody reads are culled, unless they write to the
+//   backbuffer or an imported texture, or are marked as having side effects.
+// - Transient textures are taken from a pool when their first reader or
+//   writer runs and given back after their last one, so textures with
+//   disjoint lifetimes and the same description alias the same memory.
+//   Textures unused for a few frames are freed.
+// - Memory barriers are issued before a pass reads something a previous pass
+//   wrote through image stores.
+// - Every pass is timed with GPU timestamps, see `timings`.
+//
+// The graph is rebuilt every frame: add passes, then `execute`.
+class FrameGraphGL {
+public:
+	using Resource = uint32_t;
+
+	// The default framebuffer, always present
+	static constexpr Resource BACKBUFFER = 0;
+
+	struct TextureDesc {
+		uint32_t width;
+		uint32_t height;
+		uint32_t format;       // Sized internal format, e.g. GL_RGBA16F or GL_DEPTH_COMPONENT32F
+
+		bool operator==(const TextureDesc&) const = default;
+	};
+
+	enum Access {
+		ATTACHMENT,            // Rendered to through the pass' framebuffer
+		STORAGE,               // Written with image stores from shaders
+	};
+
+	struct Timing {
+		std::string name;
+		double milliseconds;
+	};
+
+	class Builder;
+	class Context;
+private:
+	struct ResourceNode {
+		std::string name;
+		TextureDesc desc;
+		uint32_t texture;      // Set while the resource is alive
+		bool imported;
+		std::vector<uint32_t> writers;
+		uint32_t readers;
+		int32_t first;         // First and last live pass using it, -1 if none
+		int32_t last;
+		bool stored;           // Last write went through image stores
+	};
+
+	struct PassNode {
+		std::string name;
+		std::function<void(const Context&)> execute;
+		std::vector<Resource> reads;
+		std::vector<std::pair<Resource, Access>> writes;
+		bool side_effect;
+		uint32_t references;
+	};
+
+	struct PooledTexture {
+		TextureDesc desc;
+		uint32_t name;
+		uint32_t unused_frames;
+		bool in_use;
+	};
+
+	// Timestamp queries of a frame, reused `FRAMES` frames later
+	struct Queries {
+		std::vector<std::string> names;
+		std::vector<uint32_t> queries;
+		uint32_t used = 0;
+	};
+
+	static constexpr uint32_t FRAMES = 3;
+
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	std::vector<PooledTexture> m_pool;
+	std::map<std::vector<uint32_t>, uint32_t> m_framebuffers;
+	std::set<std::string> m_mixed_backbuffer;   // Passes already warned about
+	std::array<Queries, FRAMES> m_queries;
+	uint32_t m_frame;
+	std::vector<Timing> m_timings;
+public:
+	// Declares what a pass uses, handed to its setup function.
+	class Builder {
+	private:
+		FrameGraphGL& m_graph;
+		PassNode& m_pass;
+	public:
+		Builder(FrameGraphGL& graph, PassNode& pass);
+
+		// Creates a transient texture owned by the graph.
+		Resource create(const std::string& name, const TextureDesc& desc);
+
+		Resource read(Resource resource);
+		Resource write(Resource resource, Access access = ATTACHMENT);
+
+		// Keeps the pass even if nothing reads what it writes.
+		void side_effect();
+	};
+
+	// What a pass gets when it runs.
+	class Context {
+	private:
+		const FrameGraphGL& m_graph;
+		uint32_t m_framebuffer;
+	public:
+		Context(const FrameGraphGL& graph, uint32_t framebuffer);
+
+		// GL name of a resource's texture, 0 for `BACKBUFFER`.
+		uint32_t texture(Resource resource) const;
+
+		// Framebuffer with the pass' attachment writes, already bound.
+		uint32_t framebuffer() const;
+	};
+
+	FrameGraphGL();
+
+	FrameGraphGL(const FrameGraphGL&) = delete;
+	~FrameGraphGL();
+
+	FrameGraphGL& operator=(const FrameGraphGL&) = delete;
+
+	// Sets the size of the default framebuffer for this frame.
+	void backbuffer(uint32_t width, uint32_t height);
+
+	// Makes an externally owned texture usable by passes. Writing to it
+	// keeps the writer alive. Framebuffers with it attached are only cached
+	// for the frame, since its name may belong to another texture later.
+	Resource import(const std::string& name, uint32_t texture, const TextureDesc& desc);
+
+	void add_pass(const std::string& name,
+	              const std::function<void(Builder&)>& setup,
+	              const std::function<void(const Context&)>& execute);
+
+	// Culls, allocates and runs every pass, then clears the graph for the next
+	// frame.
+	void execute();
+
+	// GPU time of every pass of the latest frame whose results are available,
+	// a few frames behind.
+	const std::vector<Timing>& timings() const;
+
+	// Textures currently held by the pool, alive or not.
+	size_t pooled_textures() const;
+private:
+	void cull();
+	uint32_t acquire(const TextureDesc& desc);
+	void release(uint32_t texture);
+	void collect();
+	void forget(uint32_t texture);
+	uint32_t framebuffer(const std::vector<Resource>& attachments);
+	void read_timings(Queries& queries);
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/vertex_layout.hh"
+
+// Large shared vertex, normal and index buffers that many meshes are
+// sub-allocated from, so that all of them can be drawn from a single VAO
+// binding with one glMultiDrawElementsIndirect (see `DrawListGL`).
+//
+// Indices are kept relative to their mesh, draws offset them with
+// `base_vertex`.
+class GeometryPoolGL {
+public:
+	// Handle to a mesh in the pool, `index_count` is 0 if it's invalid.
+	struct Mesh {
+		uint32_t first_index = 0;
+		uint32_t index_count = 0;
+		int32_t base_vertex = 0;
+		uint32_t vertex_count = 0;
+	};
+private:
+	// First-fit allocator over [0, capacity) in elements
+	struct FreeList {
+		struct Range {
+			uint32_t first;
+			uint32_t count;
+		};
+
+		std::vector<Range> ranges;
+
+		bool allocate(uint32_t count, uint32_t& first);
+		void release(uint32_t first, uint32_t count);
+	};
+
+	BufferGL m_vertices;
+	BufferGL m_normals;
+	BufferGL m_indices;
+	FreeList m_free_vertices;
+	FreeList m_free_indices;
+public:
+	GeometryPoolGL(uint32_t max_vertices, uint32_t max_indices);
+
+	// Copies a mesh into the pool.
+	Mesh add(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<uint32_t>& indices);
+
+	// Gives the mesh's ranges back to the pool. The caller must make sure the
+	// GPU is done drawing it.
+	void remove(const Mesh& mesh);
+
+	uint32_t vertex_buffer() const;
+	uint32_t normal_buffer() const;
+	uint32_t index_buffer() const;
+
+	// Attaches the pool's buffers to `layout`'s shared VAO.
+	void bind(const VertexLayout& layout, uint32_t vertex_binding = 0, uint32_t normal_binding = 1) const;
+};
+
+// List of draws of meshes from a `GeometryPoolGL`, submitted with a single
+// glMultiDrawElementsIndirect.
+//
+// Each draw carries `data_stride` bytes of per-draw data (model matrix, color,
+// ...) that shaders read from an SSBO indexed by `gl_DrawID`:
+//
+//     layout(std430, binding = 0) readonly buffer Draws { DrawData draws[]; };
+//     ... draws[gl_DrawID] ...
+//
+// Commands and data are written into streaming rings, so building a list every
+// frame causes no driver-side allocation.
+class DrawListGL {
+public:
+	// Layout mandated by GL for indirect draws
+	struct Command {
+		uint32_t count;
+		uint32_t instance_count;
+		uint32_t first_index;
+		int32_t base_vertex;
+		uint32_t base_instance;
+	};
+private:
+	uint32_t m_max_draws;
+	uint32_t m_data_stride;
+	std::vector<Command> m_commands;
+	std::vector<uint8_t> m_data;
+	BufferGL m_command_ring;
+	BufferGL m_data_ring;
+public:
+	DrawListGL(uint32_t max_draws, uint32_t data_stride);
+
+	// Starts a new list. Call once per frame, before adding draws.
+	void clear();
+
+	// Adds a draw of `mesh` with `data` as its per-draw data. `Ty` should match
+	// the std430 layout of the shader's struct and be `data_stride` bytes.
+	template<class Ty>
+	void add(const GeometryPoolGL::Mesh& mesh, const Ty& data, uint32_t instances = 1);
+
+	// Same with `size` bytes at `data`. Warns and drops the draw if `size`
+	// isn't `data_stride`.
+	void add(const GeometryPoolGL::Mesh& mesh, const void* data, size_t size, uint32_t instances);
+
+	size_t size() const;
+
+	// Uploads the list and draws it. The program and the pool's VAO must be
+	// bound. Per-draw data gets bound to SSBO binding point `data_binding`.
+	void submit(uint32_t data_binding = 0, uint32_t mode = GL_TRIANGLES);
+};
+
+template<class Ty>
+void DrawListGL::add(const GeometryPoolGL::Mesh& mesh, const Ty& data, uint32_t instances)
+{
+	static_assert(!std::is_pointer_v<Ty>, "Pass the data itself, or a pointer with its size and instances");
+
+	add(mesh, static_cast<const void*>(&data), sizeof(Ty), instances);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/gl.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "pistacchio/depth_pyramid.hh"
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/compute.hh"
+
+// Hierarchical-Z pyramid: a mip chain of min/max depth (RG32F) built with
+// compute shaders from a depth texture, usually the previous frame's.
+//
+// Bounding boxes are tested for occlusion against it either on the GPU (see
+// `CullingGL::cull`) or on the CPU (see `DepthPyramid`), from an asynchronous
+// readback of a coarse level that lands a frame or two later. Both tests use the view-projection
+// the pyramid was built with, so they stay conservative while the camera
+// moves.
+class HiZGL {
+private:
+	uint32_t m_texture;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_levels;
+	bool m_built;
+	glm::mat4 m_view_projection;
+
+	ComputeGL m_reduce_depth;
+	ComputeGL m_reduce;
+
+	// CPU readback
+	uint32_t m_readback_level;
+	BufferGL m_readback;
+	GLsync m_readback_fence;
+	glm::mat4 m_readback_view_projection;
+	DepthPyramid m_cpu;
+public:
+	HiZGL(uint32_t width, uint32_t height);
+
+	HiZGL(const HiZGL&) = delete;
+	~HiZGL();
+
+	HiZGL& operator=(const HiZGL&) = delete;
+
+	// Recreates the pyramid for a new depth buffer size.
+	void resize(uint32_t width, uint32_t height);
+
+	// Builds the pyramid from `depth_texture`, whose bottom-left `width` x
+	// `height` texels were rendered with `view_projection`. Does nothing
+	// while the compute shaders are still compiling.
+	void build(uint32_t depth_texture, const glm::mat4& view_projection);
+
+	// Collects the previous readback if the GPU is done with it and starts a
+	// new one of the last built pyramid. Call once per frame after `build`.
+	void readback();
+
+	// CPU occlusion test against the last completed readback. Returns false
+	// when unsure (no readback yet, box crossing the near plane...).
+	bool occluded(const glm::vec3& min, const glm::vec3& max) const;
+
+	// Farthest depths of the last completed readback.
+	const DepthPyramid& cpu() const;
+
+	uint32_t texture() const;
+	uint32_t width() const;
+	uint32_t height() const;
+	uint32_t levels() const;
+	const glm::mat4& view_projection() const;
+private:
+	void release();
+};
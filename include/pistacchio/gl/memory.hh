@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Registry of GPU memory: every buffer and texture allocation is recorded
+// with its size, type and an optional tag, so the app can tell how much
+// memory it is using and what for, check it against a budget and find what
+// was never freed.
+//
+// Sizes are what the allocations ask for, the driver may pad or compress
+// them.
+class MemoryGL {
+public:
+	enum Type {
+		BUFFER,
+		TEXTURE,
+		TYPES,
+	};
+
+	struct Usage {
+		size_t bytes = 0;
+		size_t peak = 0;       // High-water mark of `bytes`
+		uint32_t count = 0;
+	};
+private:
+	struct Allocation {
+		size_t bytes;
+		std::string tag;
+	};
+
+	static std::mutex s_mutex;
+	static std::unordered_map<uint64_t, Allocation> s_allocations;
+	static std::array<Usage, TYPES> s_types;
+	static std::unordered_map<std::string, Usage> s_tags;
+	static Usage s_total;
+	static size_t s_budget;
+	static bool s_over_budget;
+
+	MemoryGL() = default;
+public:
+	static constexpr auto UNTAGGED = "untagged";
+
+	// Records `bytes` for the GL object `name`, replacing what was recorded
+	// for it before.
+	static void allocate(Type type, uint32_t name, size_t bytes, const std::string& tag = UNTAGGED);
+	static void release(Type type, uint32_t name);
+
+	// Moves an allocation to another tag.
+	static void tag(Type type, uint32_t name, const std::string& tag);
+
+	static Usage usage();
+	static Usage usage(Type type);
+	static Usage usage(const std::string& tag);
+	static std::unordered_map<std::string, Usage> tags();
+
+	// Warns once every time total usage goes over `bytes`, 0 disables it.
+	static void budget(size_t bytes);
+	static size_t budget();
+
+	// Logs every allocation still alive and returns how many there are. Call
+	// at shutdown, once their owners are gone.
+	static uint32_t leaks();
+
+	// Bytes taken by `levels` mips of a texture of `format`.
+	static size_t texture_size(uint32_t format, uint32_t width, uint32_t height, uint32_t levels = 1, uint32_t depth = 1);
+private:
+	static void add(Usage& usage, size_t bytes);
+	static void remove(Usage& usage, size_t bytes);
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/vertex_layout.hh"
+
+// Mesh kept both on the CPU and on the GPU, with vertices, normals and
+// (optional) indices in separate buffers.
+//
+// Changes to the CPU-side data are tracked as a dirty range per buffer.
+// `upload` only sends those ranges and does nothing at all if nothing changed,
+// buffers are only reallocated when their data outgrows them.
+class MeshGL {
+private:
+	template<class Ty>
+	struct Stream {
+		std::vector<Ty> data;
+		BufferGL buffer;
+
+		// Dirty elements, empty if `begin >= end`
+		size_t begin = 0;
+		size_t end = 0;
+
+		void assign(std::vector<Ty>&& values);
+		void set(size_t index, const Ty& value);
+		void touch(size_t first, size_t count);
+		bool dirty() const;
+		size_t upload();
+	};
+
+	Stream<glm::vec3> m_vertices;
+	Stream<glm::vec3> m_normals;
+	Stream<uint32_t> m_indices;
+public:
+	MeshGL() = default;
+	MeshGL(std::vector<glm::vec3> vertices, std::vector<glm::vec3> normals, std::vector<uint32_t> indices = {});
+
+	const std::vector<glm::vec3>& vertices() const;
+	const std::vector<glm::vec3>& normals() const;
+	const std::vector<uint32_t>& indices() const;
+
+	// Replace the whole data of a buffer.
+	void vertices(std::vector<glm::vec3> values);
+	void normals(std::vector<glm::vec3> values);
+	void indices(std::vector<uint32_t> values);
+
+	// Change a single element.
+	void vertex(size_t index, const glm::vec3& value);
+	void normal(size_t index, const glm::vec3& value);
+	void index(size_t index, uint32_t value);
+
+	// Direct write access to the data, `touch_*` must be called for every
+	// range changed through them.
+	glm::vec3* vertex_data();
+	glm::vec3* normal_data();
+	uint32_t* index_data();
+	void touch_vertices(size_t first, size_t count);
+	void touch_normals(size_t first, size_t count);
+	void touch_indices(size_t first, size_t count);
+
+	bool dirty() const;
+
+	// Sends dirty ranges to the GPU and returns the number of bytes uploaded.
+	size_t upload();
+
+	uint32_t vertex_buffer() const;
+	uint32_t normal_buffer() const;
+	uint32_t index_buffer() const;
+
+	// Attaches the buffers to `layout`'s shared VAO.
+	void bind(const VertexLayout& layout, uint32_t vertex_binding = 0, uint32_t normal_binding = 1) const;
+
+	// Draws indexed if the mesh has indices, otherwise every vertex in order.
+	//
+	// With `instances` > 1 the mesh is drawn that many times in one call;
+	// per-instance data comes from bindings with a divisor (see
+	// `VertexLayout::Binding`) or from an SSBO indexed by `gl_InstanceID`.
+	void draw(uint32_t mode = GL_TRIANGLES, uint32_t instances = 1) const;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <glad/gl.h>
+#include <glm/mat4x4.hpp>
+
+#include "pistacchio/input.hh"
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/shader.hh"
+
+// GPU picking under the mouse cursor.
+//
+// Between `begin` and `end` objects are drawn with their ID into a small R32UI
+// target (plus the primitive ID and depth) that only covers the pixels around
+// the cursor, through a projection narrowed to that region. The region is
+// read back through a fenced pixel pack buffer and only collected once the
+// GPU is done with it, so `hovered()` lags a frame or two behind but never
+// stalls. Every completed readback is also published as `Input::hovered`.
+//
+// ID 0 means nothing, objects should be numbered from 1.
+class PickingGL {
+public:
+	using Hit = Input::Hit;
+private:
+	static constexpr uint32_t FRAMES = 3;
+
+	struct Slot {
+		BufferGL buffer;
+		GLsync fence = nullptr;
+		int x;
+		int y;
+	};
+
+	uint32_t m_size;
+	uint32_t m_objects;
+	uint32_t m_primitives;
+	uint32_t m_depth;
+	uint32_t m_framebuffer;
+
+	std::array<Slot, FRAMES> m_slots;
+	uint32_t m_next;
+	Hit m_hovered;
+
+	// Saved by `begin`, restored by `end`
+	int32_t m_previous_framebuffer;
+	std::array<int32_t, 4> m_previous_viewport;
+	int m_x;
+	int m_y;
+	glm::mat4 m_view_projection;
+
+	ShaderGL m_shader;
+public:
+	// Picks in a `size` x `size` pixels square centered on the cursor.
+	PickingGL(uint32_t size = 9);
+
+	PickingGL(const PickingGL&) = delete;
+	~PickingGL();
+
+	PickingGL& operator=(const PickingGL&) = delete;
+
+	// Binds the picking target and returns `view_projection` narrowed to the
+	// region around `Input`'s mouse position, in a window of `width` x
+	// `height`. Use it with your own ID shader, or `object` for the built-in
+	// one.
+	glm::mat4 begin(const glm::mat4& view_projection, int width, int height);
+
+	// Uses the built-in shader to draw with `id` and `model`. It reads
+	// positions from attribute 0, bind the mesh and draw afterwards.
+	void object(uint32_t id, const glm::mat4& model);
+
+	// Starts reading the region back, restores the framebuffer and viewport
+	// and collects earlier readbacks that are done.
+	void end();
+
+	// Closest hit to the cursor from the latest region read back.
+	const Hit& hovered();
+private:
+	void collect();
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+#include <glm/mat4x4.hpp>
+
+// Deferred draw submission: any thread records draws into its own command
+// buffer, then the GL thread merges all of them, sorts them by key and replays
+// them through `StateGL`, so that draws sharing a program, VAO or textures
+// end up next to each other.
+//
+// Draws stay small: their vertex buffers, textures and model matrix live in
+// the command buffer's arenas and draws only keep their indices, so every
+// draw of the same mesh and material shares one `Bindings`.
+//
+// Recording isn't synchronized with `flush`. Producers must be done (e.g.
+// their `Jobs::parallel_for` returned) before the GL thread flushes, and must
+// not record again until it returned. Debug builds assert it.
+//
+// Keys sort by pass first, then shader, material and depth (see `key`).
+class RenderQueueGL {
+public:
+	static constexpr uint32_t MAX_VERTEX_BUFFERS = 4;
+	static constexpr uint32_t MAX_TEXTURES = 4;
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	struct VertexBuffer {
+		uint32_t binding;
+		uint32_t buffer = 0;   // 0 leaves the slot unused
+		uint32_t stride;
+		intptr_t offset = 0;
+	};
+
+	struct Texture {
+		uint32_t unit;
+		uint32_t texture = 0;  // 0 leaves the slot unused
+	};
+
+	// Vertex buffers and textures, shared by any number of draws.
+	struct Bindings {
+		std::array<VertexBuffer, MAX_VERTEX_BUFFERS> vertex_buffers = {};
+		std::array<Texture, MAX_TEXTURES> textures = {};
+	};
+
+	// Everything needed to replay a draw without touching the recording code.
+	// `bindings` and `model` come from the same command buffer.
+	struct Draw {
+		uint32_t program;
+		uint32_t vao;
+		uint32_t index_buffer = 0;
+		uint32_t bindings = NONE;    // See `CommandBuffer::bindings`
+		uint32_t model = NONE;       // See `CommandBuffer::model`
+		int32_t model_location = -1; // The model matrix is uploaded there if not -1
+
+		uint32_t mode = GL_TRIANGLES;
+		uint32_t count;
+		uint32_t first = 0;      // First index or first vertex
+		int32_t base_vertex = 0;
+		uint32_t instances = 1;
+	};
+
+	// Draws recorded by a single thread.
+	class CommandBuffer {
+	private:
+		std::vector<uint64_t> m_keys;
+		std::vector<Draw> m_draws;
+		std::vector<Bindings> m_bindings;
+		std::vector<glm::mat4> m_models;
+
+		// Only used by debug builds to catch recording during `flush`
+		std::atomic<uint32_t> m_recording = 0;
+		const std::atomic<bool>* m_flushing = nullptr;
+
+		friend class RenderQueueGL;
+	public:
+		// Stores `bindings` until the next `flush` and returns their index for
+		// `Draw::bindings`.
+		uint32_t bindings(const Bindings& bindings);
+
+		// Stores a model matrix until the next `flush` and returns its index
+		// for `Draw::model`.
+		uint32_t model(const glm::mat4& model);
+
+		void push(uint64_t key, const Draw& draw);
+		size_t size() const;
+	};
+private:
+	struct Entry {
+		uint64_t key;
+		uint32_t buffer;
+		uint32_t draw;
+	};
+
+	std::mutex m_mutex;
+	std::vector<std::pair<std::thread::id, std::unique_ptr<CommandBuffer>>> m_buffers;
+	std::vector<Entry> m_entries;
+	std::vector<Entry> m_scratch;
+	std::atomic<bool> m_flushing = false;
+public:
+	// Command buffer of the calling thread. Fetch it once per job rather than
+	// once per draw, it takes a lock.
+	CommandBuffer& buffer();
+
+	// Sorts and replays every recorded draw on the GL thread, then clears the
+	// command buffers. Returns the number of draws.
+	uint32_t flush();
+
+	// Builds a sort key: 8 bits of pass, 16 of shader, 16 of material and 24
+	// of depth in [0, 1]. With `back_to_front` farther draws come first, for
+	// blending.
+	static uint64_t key(uint8_t pass, uint16_t shader, uint16_t material, float depth, bool back_to_front = false);
+private:
+	void sort();
+	void replay();
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Per-frame counts of what the GL layer submits: draws, instances and
+// primitives, program/VAO/texture binds, uniform updates and bytes uploaded
+// to buffers and textures.
+//
+// Every thread counts into its own counters, which `new_frame` (called by
+// `WindowGL::swap`) adds up and resets. `stats()` then reads the last
+// complete frame, e.g. from `App::update`.
+class RenderStatsGL {
+public:
+	struct Stats {
+		uint64_t draws = 0;           // Multi-draws count every command
+		uint64_t instances = 0;
+		uint64_t primitives = 0;
+		uint64_t program_binds = 0;
+		uint64_t vao_binds = 0;
+		uint64_t texture_binds = 0;
+		uint64_t uniforms = 0;
+		uint64_t buffer_upload_bytes = 0;
+		uint64_t texture_upload_bytes = 0;
+
+		// From `StateGL`
+		uint32_t state_issued = 0;
+		uint32_t state_elided = 0;
+	};
+private:
+	enum Counter {
+		DRAWS,
+		INSTANCES,
+		PRIMITIVES,
+		PROGRAM_BINDS,
+		VAO_BINDS,
+		TEXTURE_BINDS,
+		UNIFORMS,
+		BUFFER_UPLOAD_BYTES,
+		TEXTURE_UPLOAD_BYTES,
+		COUNTERS,
+	};
+
+	// Only written by its own thread, atomics so `new_frame` can read and
+	// reset them from another one
+	struct Counters {
+		std::atomic<uint64_t> values[COUNTERS] = {};
+
+		Counters();
+		~Counters();
+	};
+
+	static std::mutex s_mutex;
+	static std::vector<Counters*> s_threads;
+	static uint64_t s_retired[COUNTERS];
+	static Stats s_last_frame;
+
+	RenderStatsGL() = default;
+public:
+	// Counts a draw of `count` vertices or indices as `mode` primitives.
+	static void draw(uint32_t mode, uint32_t count, uint32_t instances = 1);
+
+	// Counts a GPU-driven draw whose size is only known to the GPU.
+	static void draw_indirect(uint32_t draws);
+
+	static void program_bind();
+	static void vao_bind();
+	static void texture_bind();
+	static void uniform();
+	static void buffer_upload(uint64_t bytes);
+	static void texture_upload(uint64_t bytes);
+
+	// Adds up every thread's counters into the frame's stats, resets them and
+	// closes `StateGL`'s frame too. Call once per frame.
+	static void new_frame();
+
+	// Stats of the last frame closed by `new_frame`.
+	static Stats stats();
+
+	// Primitives assembled from `count` vertices in `mode`.
+	static uint64_t primitives(uint32_t mode, uint32_t count);
+private:
+	static Counters& local();
+	static void add(Counter counter, uint64_t value);
+};
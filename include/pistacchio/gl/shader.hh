@@ -2,9 +2,22 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <glad/gl.h>
 
+#include "pistacchio/gl/vertex_layout.hh"
+
+// Compiles and links a program from a set of shader stages.
+//
+// Compilation is asynchronous: the constructor only submits the stages and the
+// link to the driver, without querying any status. Use `ready()` (e.g. once
+// per `App::update`) to poll for completion; reflection of attributes and
+// uniforms happens the first time the program is found to be ready. When
+// GL_KHR_parallel_shader_compile is available polling never blocks, otherwise
+// the first call to `ready()` waits for the driver.
+//
+// Sources go through `preprocess` first, see below.
 class ShaderGL {
 public:
 	struct Attribute {
@@ -13,32 +26,94 @@ public:
 		std::string name;
 		uint32_t location;
 	};
+
+	enum State {
+		COMPILING,
+		READY,
+		FAILED,
+	};
 private:
+	struct Stage {
+		uint32_t name;
+		std::string path;
+		std::vector<std::string> files;
+	};
+
 	uint32_t m_name;
-	uint32_t m_vao;
+	State m_state;
+	bool m_prewarmed;
+	std::vector<Stage> m_stages;
 	std::unordered_map<std::string, Attribute> m_attributes;
 	std::unordered_map<std::string, uint32_t> m_uniforms;
-
-	uint32_t m_last_binding_index;
-	std::unordered_map<uint32_t /* index */, uint32_t /* vbo */> m_bindings;
 public:
 	static constexpr auto VERTEX = GL_VERTEX_SHADER;
 	static constexpr auto FRAGMENT = GL_FRAGMENT_SHADER;
+	static constexpr auto COMPUTE = GL_COMPUTE_SHADER;
 
 	using AttributesMap = std::unordered_map<std::string, Attribute>;
 	using UniformsMap = std::unordered_map<std::string, uint32_t>;
 
-	ShaderGL(const std::unordered_map<uint32_t /* type */, std::string /* path */>& shaders);
+	// `defines` are injected right after `#version`, either as `NAME` or
+	// `NAME=VALUE`.
+	ShaderGL(const std::unordered_map<uint32_t /* type */, std::string /* path */>& shaders,
+	         const std::vector<std::string>& defines = {});
+
+	// Builds a program from in-memory sources instead of files, for shaders
+	// that ship with the library. Only `defines` are applied, `#include` is
+	// not resolved. `name` is used in error messages.
+	static ShaderGL from_source(const std::unordered_map<uint32_t /* type */, std::string /* source */>& sources,
+	                            const std::vector<std::string>& defines = {},
+	                            const std::string& name = "<source>");
 
 	uint32_t id() const;
+
+	// Layout with every active attribute at its own location and reading from
+	// the binding of the same index, tightly packed. Empty until ready.
+	//
+	// Attributes named in `per_instance` advance once per instance instead of
+	// once per vertex (binding divisor 1).
+	VertexLayout layout(const std::vector<std::string>& per_instance = {}) const;
+
+	// Shared VAO for `layout()`.
 	uint32_t vao() const;
+
+	State state() const;
 	AttributesMap attributes() const;
 	UniformsMap uniforms() const;
 
+	// Polls the driver and returns true once the program is linked and
+	// reflected.
+	bool ready();
+
+	// Blocks until compilation and linking are done.
+	void wait();
+
+	// Issues a degenerate draw with the program so the driver finishes any
+	// deferred work now instead of on first real use. Only does it once.
+	void prewarm();
+
 	template<class Ty>
 	void uniform(const char* uniform, const Ty& value);
 
-	void bind_buffer(uint32_t binding_point, uint32_t vbo, void* offset, uint32_t stride);
-	void bind_attribute(const char* attribute, uint32_t binding_point);
-	void attribute_format(const char* attribute, uint32_t offset);
+	// Returns true if the driver compiles shaders on its own threads
+	// (GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile).
+	static bool parallel_compile();
+
+	// Loads the shader at `path`, resolving `#include "file"` directives
+	// relative to the including file and injecting `defines`. Every file is
+	// included at most once. `#line` directives are emitted so that compiler
+	// errors point at the right file (by its index in `files`) and line.
+	static std::string preprocess(const std::string& path,
+	                              const std::vector<std::string>& defines = {},
+	                              std::vector<std::string>* files = nullptr);
+
+	// Registers `source` as a virtual file for `#include "name"`, found before
+	// any file on disk. This is how the library ships GLSL snippets.
+	static void include(const std::string& name, const std::string& source);
+private:
+	ShaderGL();
+
+	void submit(uint32_t type, const std::string& path, const std::string& source, const std::vector<std::string>& files);
+	void link();
+	void reflect();
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pistacchio/types.hh"
+#include "pistacchio/gl/shader.hh"
+
+// Set of compile-time permutations of the same shader sources.
+//
+// Each entry in `features` is a define (`NAME` or `NAME=VALUE`); bit `i` of a
+// variant's mask enables `features[i]`. Variants are compiled the first time
+// they are requested and cached afterwards, so shaders select features with
+// `#ifdef` instead of branching on uniforms.
+class ShaderVariantsGL {
+private:
+	std::unordered_map<uint32_t, std::string> m_shaders;
+	std::vector<std::string> m_features;
+	std::unordered_map<uint32_t /* mask */, uptr<ShaderGL>> m_variants;
+public:
+	ShaderVariantsGL(const std::unordered_map<uint32_t /* type */, std::string /* path */>& shaders,
+	                 const std::vector<std::string>& features);
+
+	// Returns the variant for `mask`, submitting it for compilation if it
+	// isn't cached yet. Check `ShaderGL::ready` before drawing with it.
+	ShaderGL& get(uint32_t mask);
+
+	// Starts compiling the variant for `mask` ahead of its first use.
+	void prepare(uint32_t mask);
+
+	// Defines enabled by `mask`.
+	std::vector<std::string> defines(uint32_t mask) const;
+
+	// Number of variants compiled so far.
+	size_t size() const;
+};
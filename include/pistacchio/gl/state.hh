@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Shadows the GL state that changes most often between draws and only forwards
+// real changes to the driver. Assumes a single context, used from the thread
+// that owns it.
+//
+// Code that changes the same state behind StateGL's back must call
+// `invalidate()` afterwards. Code that restores whatever it changed (like
+// ImGui's OpenGL renderer) doesn't need to.
+class StateGL {
+public:
+	struct Stats {
+		uint32_t issued = 0;
+		uint32_t elided = 0;
+	};
+
+	static constexpr uint32_t TEXTURE_UNITS = 32;
+private:
+	// `UNKNOWN` means the value isn't known and the next change must be
+	// forwarded no matter what.
+	static constexpr uint32_t UNKNOWN = 0xFFFFFFFF;
+
+	struct State {
+		uint32_t program;
+		uint32_t vao;
+		std::array<uint32_t, TEXTURE_UNITS> textures;
+		uint32_t blend;
+		uint32_t blend_source;
+		uint32_t blend_destination;
+		uint32_t depth_test;
+		uint32_t depth_func;
+		uint32_t depth_mask;
+		uint32_t cull_face;
+		uint32_t cull_mode;
+		uint32_t polygon_mode;
+	};
+
+	static State s_state;
+	static Stats s_frame;
+	static Stats s_last_frame;
+
+	StateGL() = default;
+public:
+	static void use_program(uint32_t program);
+	static void bind_vertex_array(uint32_t vao);
+	static void bind_texture(uint32_t unit, uint32_t texture);
+
+	static void blend(bool enabled);
+	static void blend_func(uint32_t source, uint32_t destination);
+
+	static void depth_test(bool enabled);
+	static void depth_func(uint32_t func);
+	static void depth_mask(bool enabled);
+
+	static void cull_face(bool enabled);
+	static void cull_mode(uint32_t mode);
+
+	// Applies to GL_FRONT_AND_BACK, the only face allowed in core profile.
+	static void polygon_mode(uint32_t mode);
+
+	// Forgets every shadowed value.
+	static void invalidate();
+
+	// Closes the current frame's counters. `RenderStatsGL::new_frame` calls
+	// it once per frame.
+	static void new_frame();
+
+	// Counters for the last frame closed by `new_frame`.
+	static Stats stats();
+private:
+	static State unknown();
+
+	// Returns true if `value` differs from `current` (which then gets
+	// updated) and counts the change as issued or elided.
+	static bool change(uint32_t& current, uint32_t value);
+};
@@ -2,18 +2,123 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
+#include <glad/gl.h>
+
+#include "pistacchio/mip_chain.hh"
+#include "pistacchio/filesystem/compressed_image.hh"
+
+// 2D texture backed by immutable storage.
+//
+// Images loaded from disk keep their channel count and bit depth: 8-bit
+// images become R8, RG8 or RGBA8 (RGB is padded, drivers do it anyway),
+// 16-bit ones R16, RG16 or RGBA16 and HDR ones R16F, RG16F or RGBA16F. One
+// and two channel textures are swizzled to read as gray and gray + alpha.
+//
+// Textures have either one level, sampled NEAREST, or a full mip chain,
+// sampled trilinear. Mips of 8-bit images are built with `MipChain` so they
+// can also come precomputed from a loader thread, others are generated by the
+// driver.
+//
+// .dds and .ktx2 files are uploaded as they are, block-compressed with their
+// own mip levels. When the driver can't sample a format the levels are
+// decompressed on the CPU instead.
 class TextureGL {
+public:
+	// S3TC (BC1, BC3) isn't core GL
+	static constexpr uint32_t COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1;
+	static constexpr uint32_t COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+	static constexpr uint32_t COMPRESSED_SRGB_ALPHA_S3TC_DXT1 = 0x8C4D;
+	static constexpr uint32_t COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+
+	// Sampling state, applied to the texture itself. Mipmapped min filters
+	// fall back to their base filter on single-level textures.
+	struct Sampler {
+		uint32_t min_filter = GL_LINEAR_MIPMAP_LINEAR;
+		uint32_t mag_filter = GL_LINEAR;
+		uint32_t wrap_s = GL_REPEAT;
+		uint32_t wrap_t = GL_REPEAT;
+		float anisotropy = 1.0f;   // Clamped to GL_MAX_TEXTURE_MAX_ANISOTROPY
+		float lod_bias = 0.0f;
+		float min_lod = -1000.0f;
+		float max_lod = 1000.0f;
+	};
 private:
 	uint32_t m_name;
 	uint32_t m_width;
 	uint32_t m_height;
+	uint32_t m_format;
+	uint32_t m_levels;
 public:
 	TextureGL(); // This creates an invalid texture
-	TextureGL(const std::string& path);
+
+	// With `srgb` 8-bit color images are stored as SRGB8_ALPHA8 and decoded
+	// to linear when sampled. Use it for albedo, not for data like normals.
+	//
+	// With `mipmaps` the full chain is built, with `MipChain` (Kaiser,
+	// gamma-correct when `srgb`) for 8-bit images and with the driver for the
+	// others.
+	//
+	// .dds and .ktx2 files go through `CompressedImage`, they are sRGB if the
+	// container says so or with `srgb`, and `mipmaps` is ignored.
+	TextureGL(const std::string& path, bool srgb = false, bool mipmaps = false);
+
+	// Uploads every level of `image`, which can be loaded on another thread.
+	TextureGL(const CompressedImage& image, bool srgb = false);
+
 	TextureGL(uint8_t* data, int width, int height);
 
+	// `data` is laid out as the upload `format` of `internal_format`, see
+	// `pixel_format`.
+	//
+	// `levels` allocates that many mip levels (0 for the full chain) for
+	// `generate_mipmaps` to fill, `data` only goes to the first one.
+	TextureGL(const void* data, uint32_t width, uint32_t height, uint32_t internal_format, uint32_t levels = 1);
+
+	// Uploads `data` as the first level and `mips` as the following ones, e.g.
+	// from `MipChain::generate` on a loader thread.
+	TextureGL(const void* data, uint32_t width, uint32_t height, uint32_t internal_format,
+	          const std::vector<MipChain::Level>& mips);
+
+	TextureGL(const TextureGL&) = delete;
+	TextureGL(TextureGL&& other) noexcept;
+	~TextureGL();
+
+	TextureGL& operator=(const TextureGL&) = delete;
+	TextureGL& operator=(TextureGL&& other) noexcept;
+
 	uint32_t id();
 	uint32_t width();
 	uint32_t height();
+	uint32_t format();
+	uint32_t levels();
+
+	void sampler(const Sampler& sampler);
+
+	// Regenerates every level after the first with glGenerateTextureMipmap.
+	// It runs on the render thread, prefer `MipChain` when the pixels are at
+	// hand.
+	void generate_mipmaps();
+
+	// Files the texture under `tag` in `MemoryGL`.
+	void tag(const std::string& tag) const;
+
+	struct PixelFormat {
+		uint32_t format;   // GL_RED, GL_RG or GL_RGBA
+		uint32_t type;     // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_FLOAT
+		uint32_t size;     // Bytes per pixel
+	};
+
+	// How pixels for `internal_format` are passed to uploads.
+	static PixelFormat pixel_format(uint32_t internal_format);
+
+	// Returns true if the driver supports `internal_format` for 2D textures.
+	// Queried once per format.
+	static bool supported(uint32_t internal_format);
+private:
+	void create(const void* data, uint32_t width, uint32_t height, uint32_t internal_format, uint32_t levels = 1);
+	void create(const CompressedImage& image, bool srgb);
+	void upload(const std::vector<MipChain::Level>& mips);   // Levels after the first
+	void release();
 };
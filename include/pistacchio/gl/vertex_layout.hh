@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Describes where vertex attributes live: their format, which buffer binding
+// they read from and the stride of every binding.
+//
+// VAOs are built from layouts and cached by hash, so every shader and mesh
+// that uses the same layout shares a single VAO and only swaps the buffers
+// attached to it.
+struct VertexLayout {
+	struct Attribute {
+		uint32_t location;
+		int32_t size;              // Components, 1 to 4
+		uint32_t type;             // Component type, e.g. GL_FLOAT or GL_UNSIGNED_BYTE
+		uint32_t binding;
+		uint32_t offset = 0;       // Relative to the start of the element in the binding
+		bool normalized = false;   // Integer types are read as normalized floats
+		bool integer = false;      // Integer types are read as ints (`ivec`, `uvec`)
+
+		bool operator==(const Attribute&) const = default;
+	};
+
+	struct Binding {
+		uint32_t index;
+		uint32_t stride;
+		uint32_t divisor = 0;      // 0 advances per vertex, N advances every N instances
+
+		bool operator==(const Binding&) const = default;
+	};
+
+	std::vector<Attribute> attributes;
+	std::vector<Binding> bindings;
+
+	bool operator==(const VertexLayout&) const = default;
+
+	uint64_t hash() const;
+
+	// Shared VAO for this layout, created on first use.
+	uint32_t vao() const;
+
+	// Attaches `buffer` to `binding` of the shared VAO, using the stride
+	// declared for that binding.
+	void bind_buffer(uint32_t binding, uint32_t buffer, intptr_t offset = 0) const;
+	void bind_index_buffer(uint32_t buffer) const;
+
+	// Attributes for a GLSL type as reported by reflection (GL_FLOAT_VEC3,
+	// GL_INT, GL_FLOAT_MAT4...). Matrices take one location per column.
+	static std::vector<Attribute> format(uint32_t glsl_type, uint32_t location, uint32_t binding, uint32_t offset = 0);
+
+	// Size in bytes of a GLSL type as laid out by `format`.
+	static uint32_t size(uint32_t glsl_type);
+};
@@ -1,13 +1,24 @@
 #pragma once
 
 #include "pistacchio/window.hh"
+#include "pistacchio/gl/capture.hh"
 
 class WindowGL : public Window {
 public:
-	WindowGL(const std::string& title, int x, int y, int width, int height, uint32_t flags = 0);
+	// With `debug` the context is created with the debug flag and driver
+	// messages go to `Log`, see `DebugGL`.
+	WindowGL(const std::string& title, int x, int y, int width, int height, uint32_t flags = 0, bool debug = false);
 	~WindowGL();
 
 	void* data() override;
+
+	// Captures of the back buffer, taken by `swap()`.
+	CaptureGL& capture();
+
+	// Reads back any requested capture, swaps the buffers and closes the
+	// frame's `RenderStatsGL`.
+	void swap();
 private:
 	void* m_gl_context;
+	CaptureGL m_capture;
 };
@@ -1,14 +1,40 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <SDL2/SDL_events.h>
 
 class Input {
+public:
+	// What's under the cursor, see `hovered`.
+	struct Hit {
+		bool valid = false;
+		uint32_t object = 0;
+		uint32_t primitive = 0;   // gl_PrimitiveID of the hit triangle
+		float depth = 1.0f;       // Window depth in [0, 1]
+		int x = 0;                // GL window coordinates of the hit pixel,
+		int y = 0;                // origin at the bottom left
+	};
 private:
 	static std::vector<SDL_Event> s_events;
+	static int s_mouse_x;
+	static int s_mouse_y;
+	static uint32_t s_mouse_buttons;
+	static Hit s_hovered;
 
 	Input() = default;
 public:
 	static void update();
 	static std::vector<SDL_Event> sdl();
+
+	// Cursor position in window coordinates (origin at the top left) and
+	// pressed buttons as an SDL_BUTTON() mask, as of the last `update`.
+	static int mouse_x();
+	static int mouse_y();
+	static uint32_t mouse_buttons();
+
+	// Latest object under the cursor, published by `PickingGL` whenever one
+	// of its readbacks completes. Invalid if nothing is picked.
+	static const Hit& hovered();
+	static void hovered(const Hit& hit);
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Small pool of worker threads for data-parallel loops.
+//
+// `parallel_for` hands out indices to the workers and the calling thread until
+// all of them are done, then returns. Calls from inside a job run inline on
+// whichever thread runs the job, so nesting doesn't deadlock. The pool starts
+// on first use with one thread per core besides the caller and is joined at
+// exit if `stop` wasn't called.
+class Jobs {
+private:
+	Jobs() = default;
+public:
+	// Starts `threads` workers, or one less than the number of cores if 0.
+	// Restarts the pool if it was already running.
+	static void start(uint32_t threads = 0);
+
+	// Joins every worker.
+	static void stop();
+
+	// Number of workers, the calling thread not included.
+	static uint32_t threads();
+
+	// Calls `job(i)` for every `i` in [0, count), in no particular order.
+	static void parallel_for(uint32_t count, const std::function<void(uint32_t)>& job);
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Builds mip chains of 8-bit images on the CPU, so that they can be computed
+// on a loader thread or offline instead of with glGenerateTextureMipmap on
+// the render thread.
+//
+// Filtering is gamma-correct: with `srgb` color channels are decoded to
+// linear before filtering and encoded back after, alpha (the last channel of
+// 2 and 4 channel images) is always linear. Each level is filtered from the
+// previous one kept in float, so rounding doesn't accumulate down the chain.
+// Rows are processed in parallel with `Jobs`, with AVX2 or SSE when the build
+// enables them and scalar code otherwise.
+class MipChain {
+public:
+	enum Filter {
+		BOX,       // 2x2 average, the same as glGenerateTextureMipmap
+		KAISER,    // Kaiser-windowed sinc over 6x6 texels, sharper without ringing
+	};
+
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> pixels;   // Tightly packed, same channels as the input
+	};
+private:
+	MipChain() = default;
+public:
+	// Number of levels of a full chain down to 1x1, the first one included.
+	static uint32_t levels(uint32_t width, uint32_t height);
+
+	// Every level after the first one, down to 1x1.
+	static std::vector<Level> generate(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels,
+	                                   Filter filter = KAISER, bool srgb = false);
+
+	// "AVX2", "SSE2" or "scalar", depending on the build.
+	static const char* simd();
+};
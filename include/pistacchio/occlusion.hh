@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+// Software occlusion culling on the CPU, independent of the GPU and without
+// any latency.
+//
+// A few simplified occluder meshes (terrain chunks, big walls...) are
+// rasterized into a small depth buffer, then bounding boxes are tested
+// against it before submitting their draws. Triangles are binned into tiles
+// that are rasterized in parallel with `Jobs`, each row with AVX2 or SSE2
+// when the build enables them and scalar code otherwise.
+//
+// Depth is window depth in [0, 1] with GL conventions (y up, counter-clockwise
+// front faces, back faces culled).
+class OcclusionBuffer {
+public:
+	static constexpr uint32_t TILE_WIDTH = 32;
+	static constexpr uint32_t TILE_HEIGHT = 32;
+private:
+	struct Triangle {
+		float a[3];        // Edge functions, a * x + b * y + c
+		float b[3];
+		float c[3];
+		float z[3];        // Depth plane, same form
+		int32_t min_x;     // Bounds in pixels, inclusive
+		int32_t min_y;
+		int32_t max_x;
+		int32_t max_y;
+	};
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_pitch;          // Width rounded up to whole tiles
+	uint32_t m_rows;           // Height rounded up to whole tiles
+	glm::mat4 m_view_projection;
+	std::vector<float> m_depth;
+	std::vector<Triangle> m_triangles;
+	std::vector<std::vector<uint32_t>> m_bins;
+public:
+	OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+	void resize(uint32_t width, uint32_t height);
+
+	// Clears depth and occluders for a new frame seen through
+	// `view_projection`.
+	void begin(const glm::mat4& view_projection);
+
+	// Transforms, clips and sets up the triangles of an occluder. Cheap, the
+	// actual rasterization happens in `rasterize`.
+	void add_occluder(const std::vector<glm::vec3>& vertices,
+	                  const std::vector<uint32_t>& indices,
+	                  const glm::mat4& model = glm::mat4(1.0f));
+
+	// Rasterizes every occluder added since `begin`.
+	void rasterize();
+
+	// Returns false if the box is hidden behind the occluders or entirely out
+	// of view.
+	bool visible(const glm::vec3& min, const glm::vec3& max) const;
+
+	uint32_t width() const;
+	uint32_t height() const;
+	float depth(uint32_t x, uint32_t y) const;
+
+	// Instruction set rasterization was built with: "AVX2", "SSE2" or
+	// "scalar".
+	static const char* simd();
+private:
+	void setup(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2);
+	void rasterize_tile(uint32_t tile);
+};
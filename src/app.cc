@@ -75,11 +75,21 @@ void App::stop()
 	m_stop = true;
 }
 
+double App::fixed_rate() const
+{
+	return m_fixed_rate;
+}
+
 void App::fixed_rate(double value)
 {
 	m_fixed_rate = value;
 }
 
+double App::target_rate() const
+{
+	return m_target_rate;
+}
+
 void App::target_rate(double value)
 {
 	m_target_rate = value;
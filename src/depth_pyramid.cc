@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <utility>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "pistacchio/depth_pyramid.hh"
+
+struct ScreenRect {
+	glm::vec2 min;     // UV
+	glm::vec2 max;
+	float depth;       // Nearest
+};
+
+// Projects a world space box into screen UVs and window depth. Returns false if
+// the box crosses the near plane, in which case it can't be occluded.
+static bool project(const glm::mat4& view_projection, const glm::vec3& min, const glm::vec3& max, ScreenRect& rect)
+{
+	rect.min = glm::vec2(1.0f);
+	rect.max = glm::vec2(0.0f);
+	rect.depth = 1.0f;
+
+	for (int i = 0; i < 8; ++i) {
+		glm::vec4 corner = {
+			(i & 1) ? max.x : min.x,
+			(i & 2) ? max.y : min.y,
+			(i & 4) ? max.z : min.z,
+			1.0f
+		};
+
+		glm::vec4 clip = view_projection * corner;
+
+		if (clip.w <= 0.0f)
+			return false;
+
+		glm::vec2 uv = glm::vec2(clip.x, clip.y) / clip.w * 0.5f + 0.5f;
+
+		rect.min = glm::min(rect.min, uv);
+		rect.max = glm::max(rect.max, uv);
+		rect.depth = std::min(rect.depth, clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	rect.min = glm::clamp(rect.min, 0.0f, 1.0f);
+	rect.max = glm::clamp(rect.max, 0.0f, 1.0f);
+
+	return true;
+}
+
+DepthPyramid::DepthPyramid() :
+	m_view_projection(1.0f)
+{}
+
+void DepthPyramid::build(uint32_t width, uint32_t height, std::vector<float> depth, const glm::mat4& view_projection)
+{
+	m_levels.clear();
+	m_view_projection = view_projection;
+
+	if (width == 0 || height == 0 || depth.size() != size_t(width) * height)
+		return;
+
+	m_levels.push_back(Level{ width, height, std::move(depth) });
+
+	while (m_levels.back().width > 1 || m_levels.back().height > 1) {
+		const auto& source = m_levels.back();
+		Level level{ std::max(source.width / 2, 1u), std::max(source.height / 2, 1u), {} };
+
+		level.depth.resize(level.width * level.height);
+
+		for (uint32_t y = 0; y < level.height; ++y) {
+			for (uint32_t x = 0; x < level.width; ++x) {
+				uint32_t last_x = (x + 1 == level.width) ? source.width - 1 : std::min(x * 2 + 1, source.width - 1);
+				uint32_t last_y = (y + 1 == level.height) ? source.height - 1 : std::min(y * 2 + 1, source.height - 1);
+				float farthest = 0.0f;
+
+				for (uint32_t sy = y * 2; sy <= last_y; ++sy)
+					for (uint32_t sx = x * 2; sx <= last_x; ++sx)
+						farthest = std::max(farthest, source.depth[sy * source.width + sx]);
+
+				level.depth[y * level.width + x] = farthest;
+			}
+		}
+
+		m_levels.push_back(std::move(level));
+	}
+}
+
+void DepthPyramid::clear()
+{
+	m_levels.clear();
+}
+
+bool DepthPyramid::empty() const
+{
+	return m_levels.empty();
+}
+
+uint32_t DepthPyramid::level(float extent_x, float extent_y) const
+{
+	uint32_t index = 0;
+
+	while (index + 1 < m_levels.size()) {
+		const auto& level = m_levels[index];
+
+		if (extent_x * level.width <= 2.0f && extent_y * level.height <= 2.0f)
+			break;
+
+		++index;
+	}
+
+	return index;
+}
+
+bool DepthPyramid::occluded(const glm::vec3& min, const glm::vec3& max) const
+{
+	ScreenRect rect;
+
+	if (m_levels.empty() || !project(m_view_projection, min, max, rect))
+		return false;
+
+	const auto& level = m_levels[this->level(rect.max.x - rect.min.x, rect.max.y - rect.min.y)];
+
+	uint32_t x0 = std::min<uint32_t>(rect.min.x * level.width, level.width - 1);
+	uint32_t y0 = std::min<uint32_t>(rect.min.y * level.height, level.height - 1);
+	uint32_t x1 = std::min<uint32_t>(rect.max.x * level.width, level.width - 1);
+	uint32_t y1 = std::min<uint32_t>(rect.max.y * level.height, level.height - 1);
+
+	float farthest = 0.0f;
+
+	for (uint32_t y = y0; y <= y1; ++y)
+		for (uint32_t x = x0; x <= x1; ++x)
+			farthest = std::max(farthest, level.depth[y * level.width + x]);
+
+	return rect.depth > farthest;
+}
+
+const std::vector<DepthPyramid::Level>& DepthPyramid::levels() const
+{
+	return m_levels;
+}
+
+const glm::mat4& DepthPyramid::view_projection() const
+{
+	return m_view_projection;
+}
@@ -0,0 +1,639 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "pistacchio/jobs.hh"
+#include "pistacchio/log.hh"
+#include "pistacchio/filesystem/compressed_image.hh"
+
+static auto _log = Log("Filesystem: Compressed Image");
+
+template<class Ty>
+static Ty read(const uint8_t* data)
+{
+	Ty value;
+	std::memcpy(&value, data, sizeof(Ty));
+	return value;
+}
+
+static constexpr uint32_t four_cc(const char (&code)[5])
+{
+	return uint32_t(uint8_t(code[0])) | uint32_t(uint8_t(code[1])) << 8 |
+	       uint32_t(uint8_t(code[2])) << 16 | uint32_t(uint8_t(code[3])) << 24;
+}
+
+static size_t level_size(CompressedImage::Format format, uint32_t width, uint32_t height)
+{
+	return size_t((width + 3) / 4) * ((height + 3) / 4) * CompressedImage::block_size(format);
+}
+
+//
+// Containers
+//
+
+static constexpr size_t DDS_HEADER = 4 + 124;
+static constexpr size_t DDS_DX10_HEADER = 20;
+static constexpr uint32_t DDS_FOURCC = 0x4;
+static constexpr uint32_t DDS_VOLUME = 0x200000;
+static constexpr uint32_t DDS_DIMENSION_3D = 4;
+
+static constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static constexpr size_t KTX2_HEADER = 80;
+static constexpr size_t KTX2_LEVEL = 24;
+
+// Format and sRGB flag of a DXGI_FORMAT, typeless ones read as UNORM
+static std::pair<CompressedImage::Format, bool> dxgi_format(uint32_t format)
+{
+	switch (format) {
+	case 70: case 71: return { CompressedImage::BC1, false };
+	case 72:          return { CompressedImage::BC1, true };
+	case 76: case 77: return { CompressedImage::BC3, false };
+	case 78:          return { CompressedImage::BC3, true };
+	case 79: case 80: return { CompressedImage::BC4, false };
+	case 82: case 83: return { CompressedImage::BC5, false };
+	case 97: case 98: return { CompressedImage::BC7, false };
+	case 99:          return { CompressedImage::BC7, true };
+	default:          return { CompressedImage::UNKNOWN, false };
+	}
+}
+
+// Format and sRGB flag of a VkFormat
+static std::pair<CompressedImage::Format, bool> vk_format(uint32_t format)
+{
+	switch (format) {
+	case 131: case 133: return { CompressedImage::BC1, false };
+	case 132: case 134: return { CompressedImage::BC1, true };
+	case 137:           return { CompressedImage::BC3, false };
+	case 138:           return { CompressedImage::BC3, true };
+	case 139:           return { CompressedImage::BC4, false };
+	case 141:           return { CompressedImage::BC5, false };
+	case 145:           return { CompressedImage::BC7, false };
+	case 146:           return { CompressedImage::BC7, true };
+	default:            return { CompressedImage::UNKNOWN, false };
+	}
+}
+
+static bool load_dds(CompressedImage& image, const std::string& path)
+{
+	auto data = image.file.data();
+	auto size = image.file.size();
+
+	if (size < DDS_HEADER || read<uint32_t>(data + 4) != 124) {
+		_log.warn("Unable to load " + path + ": truncated DDS header");
+		return false;
+	}
+
+	image.height = read<uint32_t>(data + 12);
+	image.width = read<uint32_t>(data + 16);
+
+	uint32_t levels = std::max(read<uint32_t>(data + 28), 1u);
+	uint32_t flags = read<uint32_t>(data + 80);
+	uint32_t code = read<uint32_t>(data + 84);
+	size_t offset = DDS_HEADER;
+
+	if ((read<uint32_t>(data + 112) & DDS_VOLUME) || !(flags & DDS_FOURCC)) {
+		_log.warn("Unable to load " + path + ": only block-compressed 2D DDS are supported");
+		return false;
+	}
+
+	if (code == four_cc("DX10")) {
+		if (size < DDS_HEADER + DDS_DX10_HEADER) {
+			_log.warn("Unable to load " + path + ": truncated DX10 header");
+			return false;
+		}
+
+		if (read<uint32_t>(data + DDS_HEADER + 4) == DDS_DIMENSION_3D) {
+			_log.warn("Unable to load " + path + ": 3D textures are not supported");
+			return false;
+		}
+
+		uint32_t dxgi = read<uint32_t>(data + DDS_HEADER);
+		std::tie(image.format, image.srgb) = dxgi_format(dxgi);
+		offset += DDS_DX10_HEADER;
+
+		if (image.format == CompressedImage::UNKNOWN) {
+			_log.warn("Unable to load " + path + ": unsupported DXGI format " + std::to_string(dxgi));
+			return false;
+		}
+	} else {
+		if (code == four_cc("DXT1"))
+			image.format = CompressedImage::BC1;
+		else if (code == four_cc("DXT5"))
+			image.format = CompressedImage::BC3;
+		else if (code == four_cc("ATI1") || code == four_cc("BC4U"))
+			image.format = CompressedImage::BC4;
+		else if (code == four_cc("ATI2") || code == four_cc("BC5U"))
+			image.format = CompressedImage::BC5;
+
+		if (image.format == CompressedImage::UNKNOWN) {
+			_log.warn("Unable to load " + path + ": unsupported DDS format " + std::string(reinterpret_cast<const char*>(data + 84), 4));
+			return false;
+		}
+	}
+
+	// Levels of the first layer (or face) come first
+	for (uint32_t i = 0; i < levels; ++i) {
+		uint32_t width = std::max(image.width >> i, 1u);
+		uint32_t height = std::max(image.height >> i, 1u);
+		size_t bytes = level_size(image.format, width, height);
+
+		if (offset + bytes > size) {
+			_log.warn("Unable to load " + path + ": truncated level " + std::to_string(i));
+			return false;
+		}
+
+		image.levels.push_back({ width, height, data + offset, bytes });
+		offset += bytes;
+	}
+
+	return true;
+}
+
+static bool load_ktx2(CompressedImage& image, const std::string& path)
+{
+	auto data = image.file.data();
+	auto size = image.file.size();
+
+	if (size < KTX2_HEADER) {
+		_log.warn("Unable to load " + path + ": truncated KTX2 header");
+		return false;
+	}
+
+	uint32_t format = read<uint32_t>(data + 12);
+	uint32_t depth = read<uint32_t>(data + 28);
+	uint32_t levels = std::max(read<uint32_t>(data + 40), 1u);
+	uint32_t supercompression = read<uint32_t>(data + 44);
+
+	image.width = read<uint32_t>(data + 20);
+	image.height = std::max(read<uint32_t>(data + 24), 1u);
+
+	if (depth > 1 || supercompression != 0) {
+		_log.warn("Unable to load " + path + ": 3D and supercompressed KTX2 are not supported");
+		return false;
+	}
+
+	std::tie(image.format, image.srgb) = vk_format(format);
+
+	if (image.format == CompressedImage::UNKNOWN) {
+		_log.warn("Unable to load " + path + ": unsupported VkFormat " + std::to_string(format));
+		return false;
+	}
+
+	if (size < KTX2_HEADER + KTX2_LEVEL * levels) {
+		_log.warn("Unable to load " + path + ": truncated level index");
+		return false;
+	}
+
+	// Each level holds every layer and face, the first one at its start
+	for (uint32_t i = 0; i < levels; ++i) {
+		uint64_t offset = read<uint64_t>(data + KTX2_HEADER + KTX2_LEVEL * i);
+		uint64_t length = read<uint64_t>(data + KTX2_HEADER + KTX2_LEVEL * i + 8);
+		uint32_t width = std::max(image.width >> i, 1u);
+		uint32_t height = std::max(image.height >> i, 1u);
+		size_t bytes = level_size(image.format, width, height);
+
+		if (length < bytes || offset > size || length > size - offset) {
+			_log.warn("Unable to load " + path + ": truncated level " + std::to_string(i));
+			return false;
+		}
+
+		image.levels.push_back({ width, height, data + offset, bytes });
+	}
+
+	return true;
+}
+
+//
+// Decoders
+//
+
+// 5:6:5 color to 8 bits per channel
+static void rgb565(uint16_t color, uint8_t* rgb)
+{
+	uint32_t r = (color >> 11) & 31;
+	uint32_t g = (color >> 5) & 63;
+	uint32_t b = color & 31;
+
+	rgb[0] = uint8_t(r << 3 | r >> 2);
+	rgb[1] = uint8_t(g << 2 | g >> 4);
+	rgb[2] = uint8_t(b << 3 | b >> 2);
+}
+
+// BC1 color block to 16 RGBA texels. `opaque` forces the four color mode,
+// which is how BC3 color blocks are always read
+static void decode_bc1(const uint8_t* block, uint8_t texels[16][4], bool opaque)
+{
+	uint16_t c0 = read<uint16_t>(block);
+	uint16_t c1 = read<uint16_t>(block + 2);
+	uint8_t palette[4][4];
+
+	rgb565(c0, palette[0]);
+	rgb565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+
+	for (uint32_t c = 0; c < 3; ++c) {
+		uint32_t a = palette[0][c];
+		uint32_t b = palette[1][c];
+
+		if (c0 > c1 || opaque) {
+			palette[2][c] = uint8_t((2 * a + b + 1) / 3);
+			palette[3][c] = uint8_t((a + 2 * b + 1) / 3);
+		} else {
+			palette[2][c] = uint8_t((a + b + 1) / 2);
+			palette[3][c] = 0;
+		}
+	}
+
+	palette[2][3] = 255;
+	palette[3][3] = (c0 > c1 || opaque) ? 255 : 0;
+
+	uint32_t indices = read<uint32_t>(block + 4);
+
+	for (uint32_t i = 0; i < 16; ++i)
+		std::memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4);
+}
+
+// BC4 block to 16 values, one every `stride` bytes of `values`
+static void decode_bc4(const uint8_t* block, uint8_t* values, uint32_t stride)
+{
+	uint32_t r0 = block[0];
+	uint32_t r1 = block[1];
+	uint8_t palette[8] = { uint8_t(r0), uint8_t(r1) };
+
+	if (r0 > r1) {
+		for (uint32_t i = 1; i <= 6; ++i)
+			palette[i + 1] = uint8_t(((7 - i) * r0 + i * r1 + 3) / 7);
+	} else {
+		for (uint32_t i = 1; i <= 4; ++i)
+			palette[i + 1] = uint8_t(((5 - i) * r0 + i * r1 + 2) / 5);
+
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t indices = 0;
+	std::memcpy(&indices, block + 2, 6);
+
+	for (uint32_t i = 0; i < 16; ++i)
+		values[i * stride] = palette[(indices >> (3 * i)) & 7];
+}
+
+struct Bc7Mode {
+	uint8_t subsets;
+	uint8_t partition_bits;
+	uint8_t rotation_bits;
+	uint8_t selection_bits;
+	uint8_t color_bits;
+	uint8_t alpha_bits;
+	uint8_t endpoint_pbits;
+	uint8_t shared_pbits;
+	uint8_t index_bits;
+	uint8_t index_bits2;
+};
+
+static constexpr Bc7Mode BC7_MODES[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// Subset of every texel (bit i) for the two subset partitions
+static constexpr uint16_t BC7_PARTITIONS_2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+static constexpr uint8_t BC7_PARTITIONS_3[64][16] = {
+	{ 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+	{ 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 }, { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+	{ 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+	{ 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 }, { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+	{ 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 }, { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+	{ 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 }, { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+	{ 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+	{ 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 }, { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+	{ 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 }, { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+	{ 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 }, { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }, { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+	{ 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 }, { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+	{ 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 }, { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 }, { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+	{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 }, { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 }, { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+	{ 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 }, { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+	{ 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 }, { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+	{ 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+	{ 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 }, { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+	{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 },
+};
+
+// Texels whose index is one bit shorter, for the second subset of two and
+// the second and third of three (the first subset's is always texel 0)
+static constexpr uint8_t BC7_ANCHORS_2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+static constexpr uint8_t BC7_ANCHORS_3_SECOND[64] = {
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+};
+
+static constexpr uint8_t BC7_ANCHORS_3_THIRD[64] = {
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+};
+
+static constexpr uint8_t BC7_WEIGHTS_2[4] = { 0, 21, 43, 64 };
+static constexpr uint8_t BC7_WEIGHTS_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static constexpr uint8_t BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Reads a BC7 block from the least significant bit up
+struct BitReader {
+	const uint8_t* data;
+	uint32_t position;
+
+	uint32_t read(uint32_t count)
+	{
+		uint32_t value = 0;
+
+		for (uint32_t i = 0; i < count; ++i, ++position)
+			value |= ((data[position >> 3] >> (position & 7)) & 1u) << i;
+
+		return value;
+	}
+};
+
+static uint8_t bc7_interpolate(uint32_t e0, uint32_t e1, uint32_t index, uint32_t bits)
+{
+	uint32_t weight = (bits == 2) ? BC7_WEIGHTS_2[index] : (bits == 3) ? BC7_WEIGHTS_3[index] : BC7_WEIGHTS_4[index];
+	return uint8_t(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+}
+
+static void decode_bc7(const uint8_t* block, uint8_t texels[16][4])
+{
+	uint32_t mode = 0;
+
+	while (mode < 8 && !(block[0] & (1u << mode)))
+		++mode;
+
+	// Reserved mode, decodes to transparent black
+	if (mode == 8) {
+		std::memset(texels, 0, 16 * 4);
+		return;
+	}
+
+	auto& m = BC7_MODES[mode];
+	BitReader bits{ block, mode + 1 };
+
+	uint32_t partition = bits.read(m.partition_bits);
+	uint32_t rotation = bits.read(m.rotation_bits);
+	uint32_t selection = bits.read(m.selection_bits);
+
+	// [subset][endpoint][channel]
+	uint32_t endpoints[3][2][4];
+
+	for (uint32_t c = 0; c < 3; ++c)
+		for (uint32_t s = 0; s < m.subsets; ++s)
+			for (uint32_t e = 0; e < 2; ++e)
+				endpoints[s][e][c] = bits.read(m.color_bits);
+
+	for (uint32_t s = 0; s < m.subsets; ++s)
+		for (uint32_t e = 0; e < 2; ++e)
+			endpoints[s][e][3] = m.alpha_bits ? bits.read(m.alpha_bits) : 255;
+
+	uint32_t color_precision = m.color_bits;
+	uint32_t alpha_precision = m.alpha_bits;
+
+	if (m.endpoint_pbits || m.shared_pbits) {
+		for (uint32_t s = 0; s < m.subsets; ++s) {
+			uint32_t pbits[2];
+			pbits[0] = bits.read(1);
+			pbits[1] = m.shared_pbits ? pbits[0] : bits.read(1);
+
+			for (uint32_t e = 0; e < 2; ++e)
+				for (uint32_t c = 0; c < (m.alpha_bits ? 4u : 3u); ++c)
+					endpoints[s][e][c] = endpoints[s][e][c] << 1 | pbits[e];
+		}
+
+		++color_precision;
+
+		if (m.alpha_bits)
+			++alpha_precision;
+	}
+
+	// Expand to 8 bits by replicating the high bits
+	for (uint32_t s = 0; s < m.subsets; ++s) {
+		for (uint32_t e = 0; e < 2; ++e) {
+			for (uint32_t c = 0; c < 4; ++c) {
+				uint32_t precision = (c < 3) ? color_precision : alpha_precision;
+
+				if (precision == 0)
+					continue;
+
+				uint32_t value = endpoints[s][e][c] << (8 - precision);
+				endpoints[s][e][c] = value | value >> precision;
+			}
+		}
+	}
+
+	uint8_t subset[16] = {};
+	uint32_t anchors[3] = { 0, 0, 0 };
+
+	if (m.subsets == 2) {
+		for (uint32_t i = 0; i < 16; ++i)
+			subset[i] = (BC7_PARTITIONS_2[partition] >> i) & 1;
+
+		anchors[1] = BC7_ANCHORS_2[partition];
+	} else if (m.subsets == 3) {
+		std::memcpy(subset, BC7_PARTITIONS_3[partition], 16);
+		anchors[1] = BC7_ANCHORS_3_SECOND[partition];
+		anchors[2] = BC7_ANCHORS_3_THIRD[partition];
+	}
+
+	uint8_t indices[16];
+	uint8_t indices2[16] = {};
+
+	for (uint32_t i = 0; i < 16; ++i)
+		indices[i] = uint8_t(bits.read(m.index_bits - (i == anchors[subset[i]] ? 1 : 0)));
+
+	if (m.index_bits2) {
+		for (uint32_t i = 0; i < 16; ++i)
+			indices2[i] = uint8_t(bits.read(m.index_bits2 - (i == 0 ? 1 : 0)));
+	}
+
+	for (uint32_t i = 0; i < 16; ++i) {
+		auto& e = endpoints[subset[i]];
+		uint32_t color = indices[i];
+		uint32_t color_bits = m.index_bits;
+		uint32_t alpha = indices[i];
+		uint32_t alpha_bits = m.index_bits;
+
+		// Modes 4 and 5 index color and alpha separately, the selection bit
+		// swaps which set goes to which
+		if (m.index_bits2) {
+			if (selection) {
+				color = indices2[i];
+				color_bits = m.index_bits2;
+			} else {
+				alpha = indices2[i];
+				alpha_bits = m.index_bits2;
+			}
+		}
+
+		for (uint32_t c = 0; c < 3; ++c)
+			texels[i][c] = bc7_interpolate(e[0][c], e[1][c], color, color_bits);
+
+		texels[i][3] = bc7_interpolate(e[0][3], e[1][3], alpha, alpha_bits);
+
+		if (rotation)
+			std::swap(texels[i][3], texels[i][rotation - 1]);
+	}
+}
+
+//
+// CompressedImage
+//
+
+bool CompressedImage::valid() const
+{
+	return format != UNKNOWN && !levels.empty();
+}
+
+CompressedImage CompressedImage::load(const std::string& path)
+{
+	CompressedImage image;
+	image.file = MappedFile(path);
+
+	if (!image.file.valid())
+		return CompressedImage();
+
+	auto data = image.file.data();
+	auto size = image.file.size();
+	bool loaded = false;
+
+	if (size >= 4 && std::memcmp(data, "DDS ", 4) == 0)
+		loaded = load_dds(image, path);
+	else if (size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+		loaded = load_ktx2(image, path);
+	else
+		_log.warn("Unable to load " + path + ": neither DDS nor KTX2");
+
+	if (!loaded || image.width == 0 || image.height == 0)
+		return CompressedImage();
+
+	return image;
+}
+
+uint32_t CompressedImage::block_size(Format format)
+{
+	switch (format) {
+	case BC1:
+	case BC4:
+		return 8;
+	case BC3:
+	case BC5:
+	case BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+uint32_t CompressedImage::channels(Format format)
+{
+	switch (format) {
+	case BC4: return 1;
+	case BC5: return 2;
+	default:  return 4;
+	}
+}
+
+void CompressedImage::decompress(Format format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* pixels)
+{
+	uint32_t blocks_x = (width + 3) / 4;
+	uint32_t blocks_y = (height + 3) / 4;
+	uint32_t size = block_size(format);
+	uint32_t count = channels(format);
+
+	if (size == 0)
+		return;
+
+	Jobs::parallel_for(blocks_y, [&](uint32_t by) {
+		uint8_t texels[16][4];
+
+		for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+			const uint8_t* block = blocks + (size_t(by) * blocks_x + bx) * size;
+
+			switch (format) {
+			case BC1:
+				decode_bc1(block, texels, false);
+				break;
+			case BC3:
+				decode_bc1(block + 8, texels, true);
+				decode_bc4(block, &texels[0][3], 4);
+				break;
+			case BC4:
+				decode_bc4(block, &texels[0][0], 4);
+				break;
+			case BC5:
+				decode_bc4(block, &texels[0][0], 4);
+				decode_bc4(block + 8, &texels[0][1], 4);
+				break;
+			case BC7:
+				decode_bc7(block, texels);
+				break;
+			default:
+				break;
+			}
+
+			// Blocks on the right and bottom edges can overhang the image
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y) {
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x) {
+					size_t texel = (size_t(by * 4 + y) * width + bx * 4 + x) * count;
+					std::memcpy(pixels + texel, texels[y * 4 + x], count);
+				}
+			}
+		}
+	});
+}
+
+const char* CompressedImage::to_string(Format format)
+{
+	switch (format) {
+	case BC1: return "BC1";
+	case BC3: return "BC3";
+	case BC4: return "BC4";
+	case BC5: return "BC5";
+	case BC7: return "BC7";
+	default:  return "UNKNOWN";
+	}
+}
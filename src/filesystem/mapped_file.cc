@@ -0,0 +1,168 @@
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "pistacchio/log.hh"
+#include "pistacchio/filesystem/mapped_file.hh"
+
+static auto _log = Log("Filesystem: Mapped File");
+
+// This creates an invalid file
+#ifdef _WIN32
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_file(nullptr), m_mapping(nullptr)
+{}
+#else
+MappedFile::MappedFile() : m_data(nullptr), m_size(0)
+{}
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) :
+	MappedFile()
+{
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		_log.warn("Unable to open " + path);
+		return;
+	}
+
+	LARGE_INTEGER size;
+
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		_log.warn("Unable to map " + path + ": empty or unreadable");
+		CloseHandle(file);
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	if (!data) {
+		_log.warn("Unable to map " + path);
+
+		if (mapping)
+			CloseHandle(mapping);
+
+		CloseHandle(file);
+		return;
+	}
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(size.QuadPart);
+	m_file = file;
+	m_mapping = mapping;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) :
+	MappedFile()
+{
+	int file = open(path.c_str(), O_RDONLY);
+
+	if (file < 0) {
+		_log.warn("Unable to open " + path);
+		return;
+	}
+
+	struct stat info;
+
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		_log.warn("Unable to map " + path + ": empty or unreadable");
+		close(file);
+		return;
+	}
+
+	void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+	// The mapping keeps its own reference to the file
+	close(file);
+
+	if (data == MAP_FAILED) {
+		_log.warn("Unable to map " + path);
+		return;
+	}
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(info.st_size);
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+	MappedFile()
+{
+	*this = std::move(other);
+}
+
+MappedFile::~MappedFile()
+{
+	release();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	release();
+
+	m_data = std::exchange(other.m_data, nullptr);
+	m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+	m_file = std::exchange(other.m_file, nullptr);
+	m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+
+	return *this;
+}
+
+const uint8_t* MappedFile::data() const
+{
+	return m_data;
+}
+
+size_t MappedFile::size() const
+{
+	return m_size;
+}
+
+bool MappedFile::valid() const
+{
+	return m_data != nullptr;
+}
+
+void MappedFile::release()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+
+	if (m_mapping)
+		CloseHandle(m_mapping);
+
+	if (m_file)
+		CloseHandle(m_file);
+
+	m_file = nullptr;
+	m_mapping = nullptr;
+#else
+	if (m_data)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
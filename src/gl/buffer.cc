@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <utility>
+
+#include <glad/gl.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/buffer.hh"
+#include "pistacchio/gl/memory.hh"
+#include "pistacchio/gl/render_stats.hh"
+
+static auto _log = Log("Buffer GL");
+
+// This creates an invalid buffer
+BufferGL::BufferGL() :
+	m_name(0),
+	m_size(0),
+	m_mapping(nullptr),
+	m_frame_size(0),
+	m_frame(0),
+	m_head(0)
+{}
+
+BufferGL::BufferGL(size_t size, const void* data, uint32_t flags) :
+	BufferGL()
+{
+	// Zero-sized storage isn't allowed, leave the buffer invalid
+	if (size == 0)
+		return;
+
+	glCreateBuffers(1, &m_name);
+	glNamedBufferStorage(m_name, size, data, flags);
+
+	m_size = size;
+
+	MemoryGL::allocate(MemoryGL::BUFFER, m_name, size);
+
+	if (data)
+		RenderStatsGL::buffer_upload(size);
+}
+
+BufferGL::BufferGL(BufferGL&& other) noexcept :
+	BufferGL()
+{
+	*this = std::move(other);
+}
+
+BufferGL::~BufferGL()
+{
+	release();
+}
+
+BufferGL& BufferGL::operator=(BufferGL&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	release();
+
+	m_name = std::exchange(other.m_name, 0);
+	m_size = std::exchange(other.m_size, 0);
+	m_mapping = std::exchange(other.m_mapping, nullptr);
+	m_frame_size = std::exchange(other.m_frame_size, 0);
+	m_frame = std::exchange(other.m_frame, 0);
+	m_head = std::exchange(other.m_head, 0);
+	m_fences = std::exchange(other.m_fences, {});
+
+	return *this;
+}
+
+void BufferGL::release()
+{
+	for (auto fence : m_fences)
+		if (fence)
+			glDeleteSync(fence);
+
+	m_fences.clear();
+
+	// Deleting a buffer also unmaps it
+	if (m_name) {
+		MemoryGL::release(MemoryGL::BUFFER, m_name);
+		glDeleteBuffers(1, &m_name);
+	}
+
+	m_name = 0;
+	m_size = 0;
+	m_mapping = nullptr;
+}
+
+BufferGL BufferGL::stream(size_t frame_size, uint32_t frames)
+{
+	constexpr uint32_t flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	// Regions start where a range can be bound, whatever the caller asked for
+	auto alignment = offset_alignment();
+	frame_size = (frame_size + alignment - 1) / alignment * alignment;
+
+	BufferGL buffer(frame_size * frames, nullptr, flags);
+
+	if (!buffer.m_name)
+		return buffer;
+
+	buffer.m_mapping = static_cast<uint8_t*>(glMapNamedBufferRange(buffer.m_name, 0, buffer.m_size, flags));
+	buffer.m_frame_size = frame_size;
+	buffer.m_fences.resize(frames, nullptr);
+
+	if (!buffer.m_mapping)
+		_log.error("Unable to map streaming buffer");
+
+	return buffer;
+}
+
+size_t BufferGL::offset_alignment()
+{
+	static size_t alignment = 0;
+
+	if (!alignment) {
+		int32_t storage = 0;
+		int32_t uniform = 0;
+
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage);
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform);
+
+		alignment = std::max({ size_t(256), size_t(storage), size_t(uniform) });
+	}
+
+	return alignment;
+}
+
+uint32_t BufferGL::id() const
+{
+	return m_name;
+}
+
+size_t BufferGL::size() const
+{
+	return m_size;
+}
+
+bool BufferGL::streaming() const
+{
+	return m_mapping != nullptr;
+}
+
+void BufferGL::tag(const std::string& tag) const
+{
+	MemoryGL::tag(MemoryGL::BUFFER, m_name, tag);
+}
+
+void BufferGL::update(size_t offset, size_t size, const void* data)
+{
+	if (!m_name || offset + size > m_size) {
+		_log.warn("Update out of bounds");
+		return;
+	}
+
+	glNamedBufferSubData(m_name, offset, size, data);
+	RenderStatsGL::buffer_upload(size);
+}
+
+BufferGL::Allocation BufferGL::allocate(size_t size, size_t alignment)
+{
+	if (!m_mapping) {
+		_log.warn("Unable to allocate from a non-streaming buffer");
+		return Allocation{ nullptr, 0, 0 };
+	}
+
+	if (alignment == 0) {
+		_log.warn("Invalid allocation alignment of 0");
+		return Allocation{ nullptr, 0, 0 };
+	}
+
+	// Align the offset in the buffer, not in the region, the two only agree
+	// if the region size is a multiple of `alignment`
+	size_t base = m_frame * m_frame_size;
+	size_t offset = (base + m_head + alignment - 1) / alignment * alignment;
+
+	if (offset + size > base + m_frame_size) {
+		_log.warn("Frame region full, unable to allocate " + std::to_string(size) + " bytes");
+		return Allocation{ nullptr, 0, 0 };
+	}
+
+	m_head = offset + size - base;
+
+	// Written through the mapping, but it's the same traffic
+	RenderStatsGL::buffer_upload(size);
+
+	return Allocation{
+		.data = m_mapping + offset,
+		.offset = static_cast<uint32_t>(offset),
+		.size = static_cast<uint32_t>(size)
+	};
+}
+
+void BufferGL::next_frame()
+{
+	if (!m_mapping)
+		return;
+
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_frame = (m_frame + 1) % m_fences.size();
+	m_head = 0;
+
+	auto& fence = m_fences[m_frame];
+
+	if (!fence)
+		return;
+
+	// Only the first wait needs to flush, to make sure the fence actually
+	// reaches the GPU.
+
+	uint32_t flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+	while (true) {
+		auto result = glClientWaitSync(fence, flags, 1'000'000);
+
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			break;
+
+		if (result == GL_WAIT_FAILED) {
+			_log.error("Unable to wait for frame fence");
+			break;
+		}
+
+		flags = 0;
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include <glad/gl.h>
+
+// stb doesn't build clean under -Wextra
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#pragma GCC diagnostic pop
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/capture.hh"
+
+static auto _log = Log("Capture GL");
+
+CaptureGL::CaptureGL() :
+	m_next(0),
+	m_width(0),
+	m_height(0),
+	m_format(PNG),
+	m_frame(0),
+	m_dropped(0),
+	m_stop(false)
+{
+}
+
+CaptureGL::~CaptureGL()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+void CaptureGL::screenshot(const std::string& path)
+{
+	m_screenshot = path;
+}
+
+void CaptureGL::record(const std::string& prefix, Format format)
+{
+	m_prefix = prefix;
+	m_format = format;
+	m_frame = 0;
+	m_dropped = 0;
+}
+
+void CaptureGL::stop()
+{
+	if (!m_prefix.empty() && m_dropped)
+		_log.warn("Recording " + m_prefix + " dropped " + std::to_string(m_dropped) + " frames");
+
+	m_prefix.clear();
+}
+
+bool CaptureGL::recording() const
+{
+	return !m_prefix.empty();
+}
+
+size_t CaptureGL::queued()
+{
+	std::lock_guard lock(m_mutex);
+
+	return m_jobs.size();
+}
+
+uint32_t CaptureGL::dropped() const
+{
+	return m_dropped;
+}
+
+void CaptureGL::capture(uint32_t width, uint32_t height)
+{
+	collect(false);
+
+	if (m_screenshot.empty() && m_prefix.empty())
+		return;
+
+	if (width != m_width || height != m_height) {
+		finish();
+
+		m_width = width;
+		m_height = height;
+
+		constexpr uint32_t flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		for (auto& slot : m_slots) {
+			slot.buffer = BufferGL(width * height * 4, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+			slot.pixels = static_cast<const uint8_t*>(glMapNamedBufferRange(slot.buffer.id(), 0, width * height * 4, flags));
+		}
+	}
+
+	auto& slot = m_slots[m_next];
+
+	// The ring is full, this is the only time capturing waits on the GPU
+	if (slot.fence)
+		complete(slot, true);
+
+	{
+		std::lock_guard lock(m_mutex);
+
+		// Encoders are behind, keep memory bounded. Screenshots stay pending
+		if (slot.encoding) {
+			if (m_screenshot.empty() && m_dropped++ == 0)
+				_log.warn("Encoding can't keep up with recording " + m_prefix + ", dropping frames");
+
+			return;
+		}
+	}
+
+	if (!slot.pixels) {
+		_log.warn("Unable to map capture buffers");
+		m_screenshot.clear();
+		return;
+	}
+
+	if (!m_screenshot.empty()) {
+		slot.path = m_screenshot;
+		slot.format = PNG;
+		m_screenshot.clear();
+	} else {
+		char number[16];
+		std::snprintf(number, sizeof(number), "%06u", m_frame++);
+
+		slot.path = m_prefix + number + (m_format == PNG ? ".png" : ".rgba");
+		slot.format = m_format;
+	}
+
+	slot.width = width;
+	slot.height = height;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer.id());
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_next = (m_next + 1) % FRAMES;
+}
+
+void CaptureGL::finish()
+{
+	collect(true);
+
+	// Encoders read straight from the mappings
+	{
+		std::unique_lock lock(m_mutex);
+		m_idle.wait(lock, [this] {
+			return std::none_of(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.encoding; });
+		});
+	}
+
+	for (auto& slot : m_slots) {
+		slot.buffer = BufferGL();
+		slot.pixels = nullptr;
+	}
+
+	m_width = 0;
+	m_height = 0;
+}
+
+// Oldest first, so that frames reach the worker in order
+void CaptureGL::collect(bool wait)
+{
+	for (uint32_t i = 0; i < FRAMES; ++i) {
+		auto& slot = m_slots[(m_next + i) % FRAMES];
+
+		if (!slot.fence)
+			continue;
+
+		complete(slot, wait);
+
+		if (slot.fence)
+			break;
+	}
+}
+
+void CaptureGL::complete(Slot& slot, bool wait)
+{
+	auto status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1'000'000'000 : 0);
+
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return;
+
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	{
+		std::lock_guard lock(m_mutex);
+		slot.encoding = true;
+		m_jobs.push_back(&slot);
+
+		if (m_workers.empty()) {
+			auto encoders = std::clamp(std::thread::hardware_concurrency() / 2, 1u, ENCODERS);
+
+			for (uint32_t i = 0; i < encoders; ++i)
+				m_workers.emplace_back(&CaptureGL::worker, this);
+		}
+	}
+
+	m_wake.notify_one();
+}
+
+void CaptureGL::worker()
+{
+	while (true) {
+		std::unique_lock lock(m_mutex);
+
+		m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+
+		// Write whatever is left before leaving
+		if (m_jobs.empty())
+			return;
+
+		auto& job = *m_jobs.front();
+		m_jobs.pop_front();
+
+		lock.unlock();
+
+		// GL rows go bottom-up, files top-down
+		int stride = job.width * 4;
+		const uint8_t* last_row = job.pixels + (job.height - 1) * stride;
+
+		if (job.format == PNG) {
+			if (!stbi_write_png(job.path.c_str(), job.width, job.height, 4, last_row, -stride))
+				_log.warn("Unable to write " + job.path);
+		} else {
+			std::ofstream file(job.path, std::ios::binary);
+
+			for (uint32_t y = 0; y < job.height; ++y)
+				file.write(reinterpret_cast<const char*>(last_row - y * stride), stride);
+
+			if (!file)
+				_log.warn("Unable to write " + job.path);
+		}
+
+		lock.lock();
+		job.encoding = false;
+		lock.unlock();
+
+		m_idle.notify_all();
+	}
+}
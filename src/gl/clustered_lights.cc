@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <string>
+
+#include <glad/gl.h>
+#include <glm/mat4x4.hpp>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/clustered_lights.hh"
+
+static auto _log = Log("Clustered Lights GL");
+
+static const std::string MAX_PER_CLUSTER = std::to_string(ClusteredLightsGL::MAX_LIGHTS_PER_CLUSTER);
+
+static const std::string ASSIGN_SOURCE = R"(#version 450 core
+
+layout(local_size_x = 64) in;
+
+struct Light {
+	vec4 position_radius;
+	vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights { Light lights[]; };
+layout(std430, binding = 1) writeonly buffer Counts { uint counts[]; };
+layout(std430, binding = 2) writeonly buffer Indices { uint indices[]; };
+
+uniform mat4 view;
+uniform mat4 inverse_projection;
+uniform ivec2 cluster_grid;
+uniform int cluster_slices;
+uniform vec2 cluster_depth;
+uniform int lights_count;
+
+// View space position and radius of a batch of lights, shared by the group
+shared vec4 batch[64];
+
+// Point of the view ray through `ndc` at distance `depth` along -Z
+vec3 view_point(vec2 ndc, float depth)
+{
+	vec4 point = inverse_projection * vec4(ndc, -1.0, 1.0);
+	vec3 ray = point.xyz / point.w;
+
+	return ray * (depth / -ray.z);
+}
+
+void main()
+{
+	uint cluster = gl_GlobalInvocationID.x;
+	uint clusters = uint(cluster_grid.x * cluster_grid.y * cluster_slices);
+	bool active = cluster < clusters;
+
+	ivec3 id = ivec3(
+		int(cluster) % cluster_grid.x,
+		(int(cluster) / cluster_grid.x) % cluster_grid.y,
+		int(cluster) / (cluster_grid.x * cluster_grid.y));
+
+	// View space bounds of the cluster, slices are exponential in depth
+
+	vec2 ndc_min = vec2(id.xy) / vec2(cluster_grid) * 2.0 - 1.0;
+	vec2 ndc_max = vec2(id.xy + 1) / vec2(cluster_grid) * 2.0 - 1.0;
+	float ratio = cluster_depth.y / cluster_depth.x;
+	float slice_near = cluster_depth.x * pow(ratio, float(id.z) / float(cluster_slices));
+	float slice_far = cluster_depth.x * pow(ratio, float(id.z + 1) / float(cluster_slices));
+
+	vec3 box_min = vec3(1e30);
+	vec3 box_max = vec3(-1e30);
+
+	for (int i = 0; i < 8; ++i) {
+		vec2 ndc = vec2((i & 1) != 0 ? ndc_max.x : ndc_min.x, (i & 2) != 0 ? ndc_max.y : ndc_min.y);
+		vec3 point = view_point(ndc, (i & 4) != 0 ? slice_far : slice_near);
+
+		box_min = min(box_min, point);
+		box_max = max(box_max, point);
+	}
+
+	uint count = 0;
+
+	for (int base = 0; base < lights_count; base += 64) {
+		int index = base + int(gl_LocalInvocationIndex);
+
+		if (index < lights_count) {
+			vec4 light = lights[index].position_radius;
+			batch[gl_LocalInvocationIndex] = vec4((view * vec4(light.xyz, 1.0)).xyz, light.w);
+		}
+
+		barrier();
+
+		int batch_size = min(64, lights_count - base);
+
+		for (int i = 0; active && i < batch_size && count < MAX_PER_CLUSTER; ++i) {
+			vec3 closest = clamp(batch[i].xyz, box_min, box_max);
+			vec3 offset = closest - batch[i].xyz;
+
+			if (dot(offset, offset) <= batch[i].w * batch[i].w)
+				indices[cluster * MAX_PER_CLUSTER + count++] = uint(base + i);
+		}
+
+		barrier();
+	}
+
+	if (active)
+		counts[cluster] = count;
+}
+)";
+
+static const std::string INCLUDE_SOURCE = R"(// Clustered forward lighting, see ClusteredLightsGL
+
+struct ClusteredLight {
+	vec4 position_radius;
+	vec4 color;
+};
+
+layout(std430, binding = 4) readonly buffer ClusteredLights { ClusteredLight clustered_lights[]; };
+layout(std430, binding = 5) readonly buffer ClusterCounts { uint cluster_counts[]; };
+layout(std430, binding = 6) readonly buffer ClusterIndices { uint cluster_indices[]; };
+
+uniform ivec2 cluster_grid;
+uniform int cluster_slices;
+uniform vec2 cluster_depth;
+uniform vec2 cluster_viewport;
+
+uint cluster_index(vec2 frag_coord, float view_depth)
+{
+	ivec2 tile = clamp(ivec2(frag_coord / cluster_viewport * vec2(cluster_grid)), ivec2(0), cluster_grid - 1);
+	int slice = int(log(view_depth / cluster_depth.x) / log(cluster_depth.y / cluster_depth.x) * float(cluster_slices));
+
+	slice = clamp(slice, 0, cluster_slices - 1);
+
+	return uint(tile.x + cluster_grid.x * (tile.y + cluster_grid.y * slice));
+}
+
+// Diffuse light of every light in the fragment's cluster, `position` and
+// `normal` in world space.
+vec3 clustered_lighting(vec3 position, vec3 normal, float view_depth)
+{
+	uint cluster = cluster_index(gl_FragCoord.xy, view_depth);
+	uint count = cluster_counts[cluster];
+
+	vec3 result = vec3(0.0);
+
+	for (uint i = 0; i < count; ++i) {
+		ClusteredLight light = clustered_lights[cluster_indices[cluster * MAX_PER_CLUSTER + i]];
+
+		vec3 to_light = light.position_radius.xyz - position;
+		float to_light_length = length(to_light);
+
+		// Smooth window so lights reach exactly 0 at their radius
+		float window = clamp(1.0 - pow(to_light_length / light.position_radius.w, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (to_light_length * to_light_length + 1.0);
+
+		result += max(dot(normal, to_light / max(to_light_length, 1e-4)), 0.0) * light.color.rgb * light.color.a * attenuation;
+	}
+
+	return result;
+}
+)";
+
+// `MAX_PER_CLUSTER` is spliced in as a literal so both sides always agree
+static std::string with_max_per_cluster(const std::string& source)
+{
+	std::string result = source;
+	std::string token = "MAX_PER_CLUSTER";
+
+	for (auto at = result.find(token); at != std::string::npos; at = result.find(token, at))
+		result.replace(at, token.length(), MAX_PER_CLUSTER + "u");
+
+	return result;
+}
+
+static const bool s_registered = (ShaderGL::include("pistacchio/clustered_lights.glsl", with_max_per_cluster(INCLUDE_SOURCE)), true);
+
+ClusteredLightsGL::ClusteredLightsGL(uint32_t max_lights, uint32_t grid_x, uint32_t grid_y, uint32_t slices) :
+	m_max_lights(max_lights),
+	m_lights_count(0),
+	m_grid(grid_x, grid_y),
+	m_slices(slices),
+	m_depth(0.1f, 1000.0f),
+	m_viewport(1.0f, 1.0f),
+	m_lights(BufferGL::stream(max_lights * sizeof(Light))),
+	m_allocation{ nullptr, 0, 0 },
+	m_counts(clusters() * sizeof(uint32_t), nullptr, BufferGL::DYNAMIC),
+	m_indices(clusters() * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t)),
+	m_shader(ComputeGL::from_source(with_max_per_cluster(ASSIGN_SOURCE), {}, "clustered_lights.comp"))
+{
+	(void)s_registered;
+
+	// Nothing is lit until the first `assign`
+	uint32_t zero = 0;
+	glClearNamedBufferData(m_counts.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+}
+
+void ClusteredLightsGL::update(const std::vector<Light>& lights)
+{
+	if (lights.size() > m_max_lights)
+		_log.warn("Too many lights, only using the first " + std::to_string(m_max_lights));
+
+	m_lights_count = std::min<size_t>(lights.size(), m_max_lights);
+	m_allocation = m_lights.write(lights.data(), m_lights_count, BufferGL::offset_alignment());
+
+	if (!m_allocation.data)
+		m_lights_count = 0;
+}
+
+void ClusteredLightsGL::assign(const glm::mat4& view, const glm::mat4& projection, float near, float far, uint32_t width, uint32_t height)
+{
+	m_depth = glm::vec2(near, far);
+	m_viewport = glm::vec2(width, height);
+
+	m_shader.wait();
+
+	if (m_shader.state() != ShaderGL::READY)
+		return;
+
+	m_shader.uniform("view", view);
+	m_shader.uniform("inverse_projection", glm::inverse(projection));
+	m_shader.uniform("cluster_grid", m_grid);
+	m_shader.uniform("cluster_slices", m_slices);
+	m_shader.uniform("cluster_depth", m_depth);
+	m_shader.uniform("lights_count", static_cast<int>(m_lights_count));
+
+	if (m_lights_count)
+		m_shader.bind("Lights", m_lights, m_allocation.offset, m_allocation.size);
+
+	m_shader.bind("Counts", m_counts);
+	m_shader.bind("Indices", m_indices);
+
+	m_shader.dispatch_threads(clusters());
+
+	ComputeGL::storage_barrier();
+}
+
+void ClusteredLightsGL::bind(ShaderGL& shader) const
+{
+	if (m_lights_count)
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, m_lights.id(), m_allocation.offset, m_allocation.size);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING, m_counts.id());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING, m_indices.id());
+
+	shader.uniform("cluster_grid", m_grid);
+	shader.uniform("cluster_slices", m_slices);
+	shader.uniform("cluster_depth", m_depth);
+	shader.uniform("cluster_viewport", m_viewport);
+}
+
+void ClusteredLightsGL::next_frame()
+{
+	m_lights.next_frame();
+}
+
+uint32_t ClusteredLightsGL::size() const
+{
+	return m_lights_count;
+}
+
+uint32_t ClusteredLightsGL::clusters() const
+{
+	return m_grid.x * m_grid.y * m_slices;
+}
@@ -0,0 +1,234 @@
+#include <string>
+#include <utility>
+
+#include <glad/gl.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/compute.hh"
+#include "pistacchio/gl/state.hh"
+
+static auto _log = Log("Compute GL");
+
+// Image types are a contiguous range of enums, from GL_IMAGE_1D to
+// GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY
+static bool is_image(uint32_t type)
+{
+	return type >= GL_IMAGE_1D && type <= GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY;
+}
+
+ComputeGL::ComputeGL(ShaderGL&& shader) :
+	m_shader(std::move(shader)),
+	m_reflected(false),
+	m_local_size{ 0, 0, 0 }
+{
+}
+
+ComputeGL::ComputeGL(const std::string& path, const std::vector<std::string>& defines) :
+	ComputeGL(ShaderGL({ { ShaderGL::COMPUTE, path } }, defines))
+{
+}
+
+ComputeGL ComputeGL::from_source(const std::string& source, const std::vector<std::string>& defines, const std::string& name)
+{
+	return ComputeGL(ShaderGL::from_source({ { ShaderGL::COMPUTE, source } }, defines, name));
+}
+
+uint32_t ComputeGL::id() const
+{
+	return m_shader.id();
+}
+
+ShaderGL::State ComputeGL::state() const
+{
+	return m_shader.state();
+}
+
+bool ComputeGL::ready()
+{
+	if (!m_shader.ready())
+		return false;
+
+	reflect();
+
+	return true;
+}
+
+void ComputeGL::wait()
+{
+	m_shader.wait();
+
+	if (m_shader.state() == ShaderGL::READY)
+		reflect();
+}
+
+std::array<uint32_t, 3> ComputeGL::local_size() const
+{
+	return m_local_size;
+}
+
+ComputeGL::StorageBlocksMap ComputeGL::storage_blocks() const
+{
+	return m_storage_blocks;
+}
+
+ComputeGL::ImagesMap ComputeGL::images() const
+{
+	return m_images;
+}
+
+void ComputeGL::bind(uint32_t binding, const BufferGL& buffer)
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.id());
+}
+
+void ComputeGL::bind(uint32_t binding, const BufferGL& buffer, size_t offset, size_t size)
+{
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer.id(), offset, size);
+}
+
+void ComputeGL::bind(const std::string& block, const BufferGL& buffer)
+{
+	auto found = m_storage_blocks.find(block);
+
+	if (found != m_storage_blocks.end())
+		bind(found->second.binding, buffer);
+}
+
+void ComputeGL::bind(const std::string& block, const BufferGL& buffer, size_t offset, size_t size)
+{
+	auto found = m_storage_blocks.find(block);
+
+	if (found != m_storage_blocks.end())
+		bind(found->second.binding, buffer, offset, size);
+}
+
+void ComputeGL::bind_image(uint32_t unit, uint32_t texture, uint32_t access, uint32_t format, int32_t level)
+{
+	glBindImageTexture(unit, texture, level, GL_FALSE, 0, access, format);
+}
+
+void ComputeGL::bind_image(const std::string& image, uint32_t texture, uint32_t access, uint32_t format, int32_t level)
+{
+	auto found = m_images.find(image);
+
+	if (found != m_images.end())
+		bind_image(found->second.unit, texture, access, format, level);
+}
+
+void ComputeGL::bind_texture(uint32_t unit, uint32_t texture)
+{
+	StateGL::bind_texture(unit, texture);
+}
+
+void ComputeGL::dispatch(uint32_t x, uint32_t y, uint32_t z)
+{
+	if (!x || !y || !z)
+		return;
+
+	StateGL::use_program(m_shader.id());
+	glDispatchCompute(x, y, z);
+}
+
+void ComputeGL::dispatch_threads(uint32_t x, uint32_t y, uint32_t z)
+{
+	wait();
+
+	if (m_local_size[0] == 0)
+		return;
+
+	dispatch((x + m_local_size[0] - 1) / m_local_size[0],
+	         (y + m_local_size[1] - 1) / m_local_size[1],
+	         (z + m_local_size[2] - 1) / m_local_size[2]);
+}
+
+void ComputeGL::dispatch_indirect(const BufferGL& buffer, intptr_t offset)
+{
+	StateGL::use_program(m_shader.id());
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer.id());
+	glDispatchComputeIndirect(offset);
+}
+
+void ComputeGL::barrier(uint32_t bits)
+{
+	glMemoryBarrier(bits);
+}
+
+void ComputeGL::storage_barrier()
+{
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ComputeGL::image_barrier()
+{
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void ComputeGL::command_barrier()
+{
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void ComputeGL::reflect()
+{
+	if (m_reflected)
+		return;
+
+	m_reflected = true;
+
+	uint32_t program = m_shader.id();
+
+	int32_t local_size[3];
+	glGetProgramiv(program, GL_COMPUTE_WORK_GROUP_SIZE, local_size);
+
+	for (int i = 0; i < 3; ++i)
+		m_local_size[i] = local_size[i];
+
+	// Shader storage blocks
+
+	int32_t blocks = 0;
+	glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &blocks);
+
+	for (int32_t i = 0; i < blocks; ++i) {
+		const uint32_t properties[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+		int32_t values[3];
+		glGetProgramResourceiv(program, GL_SHADER_STORAGE_BLOCK, i, 3, properties, 3, nullptr, values);
+
+		std::string name(values[0], '\0');
+		glGetProgramResourceName(program, GL_SHADER_STORAGE_BLOCK, i, values[0], nullptr, name.data());
+		name.resize(values[0] - 1);
+
+		m_storage_blocks.emplace(name, StorageBlock{
+			.binding = static_cast<uint32_t>(values[1]),
+			.size = values[2],
+		});
+	}
+
+	// Images are plain uniforms whose value is the unit
+
+	int32_t uniforms = 0;
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniforms);
+
+	for (int32_t i = 0; i < uniforms; ++i) {
+		const uint32_t properties[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION };
+		int32_t values[3];
+		glGetProgramResourceiv(program, GL_UNIFORM, i, 3, properties, 3, nullptr, values);
+
+		if (!is_image(values[1]) || values[2] < 0)
+			continue;
+
+		std::string name(values[0], '\0');
+		glGetProgramResourceName(program, GL_UNIFORM, i, values[0], nullptr, name.data());
+		name.resize(values[0] - 1);
+
+		int32_t unit = 0;
+		glGetUniformiv(program, values[2], &unit);
+
+		m_images.emplace(name, Image{
+			.unit = static_cast<uint32_t>(unit),
+			.type = static_cast<uint32_t>(values[1]),
+		});
+	}
+
+	_log.debug("Reflected " + std::to_string(m_storage_blocks.size()) + " storage blocks and " +
+	           std::to_string(m_images.size()) + " images");
+}
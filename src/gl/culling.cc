@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <string>
+
+#include <glad/gl.h>
+#include <SDL.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/culling.hh"
+#include "pistacchio/gl/render_stats.hh"
+
+static auto _log = Log("Culling GL");
+
+static const char* CULLING_SOURCE = R"(#version 450 core
+
+layout(local_size_x = 64) in;
+
+struct Object {
+	vec4 sphere;
+	uint count;
+	uint first_index;
+	int base_vertex;
+	uint padding;
+};
+
+struct Command {
+	uint count;
+	uint instance_count;
+	uint first_index;
+	int base_vertex;
+	uint base_instance;
+};
+
+layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };
+layout(std430, binding = 1) writeonly buffer Commands { Command commands[]; };
+layout(std430, binding = 2) buffer Count { uint count; };
+
+uniform mat4 view_projection;
+uniform int objects_count;
+
+#ifdef HIZ
+uniform sampler2D hiz;
+uniform mat4 hiz_view_projection;
+uniform int hiz_levels;
+
+// Tests the sphere's bounding box against the farthest depth of the pyramid
+// level where its screen footprint spans about 2x2 texels
+bool occluded(vec4 sphere)
+{
+	vec2 rect_min = vec2(1.0);
+	vec2 rect_max = vec2(0.0);
+	float depth = 1.0;
+
+	for (int i = 0; i < 8; ++i) {
+		vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = hiz_view_projection * vec4(corner, 1.0);
+
+		// Crossing the near plane, can't tell
+		if (clip.w <= 0.0)
+			return false;
+
+		vec3 window = clip.xyz / clip.w * 0.5 + 0.5;
+
+		rect_min = min(rect_min, window.xy);
+		rect_max = max(rect_max, window.xy);
+		depth = min(depth, window.z);
+	}
+
+	rect_min = clamp(rect_min, 0.0, 1.0);
+	rect_max = clamp(rect_max, 0.0, 1.0);
+
+	vec2 extent = (rect_max - rect_min) * vec2(textureSize(hiz, 0));
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiz_levels - 1);
+
+	ivec2 size = textureSize(hiz, level);
+	ivec2 first = min(ivec2(rect_min * vec2(size)), size - 1);
+	ivec2 last = min(ivec2(rect_max * vec2(size)), size - 1);
+
+	float farthest = 0.0;
+
+	for (int y = first.y; y <= last.y; ++y)
+		for (int x = first.x; x <= last.x; ++x)
+			farthest = max(farthest, texelFetch(hiz, ivec2(x, y), level).g);
+
+	return depth > farthest;
+}
+#endif
+
+// Gribb-Hartmann plane extraction, planes point inwards
+bool visible(vec4 sphere)
+{
+	mat4 m = transpose(view_projection);
+	vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]);
+
+	for (int i = 0; i < 6; ++i) {
+		vec4 plane = planes[i] / length(planes[i].xyz);
+
+		if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w)
+			return false;
+	}
+
+	return true;
+}
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+
+	if (id >= uint(objects_count))
+		return;
+
+	Object object = objects[id];
+	bool keep = visible(object.sphere);
+
+#ifdef HIZ
+	keep = keep && !occluded(object.sphere);
+#endif
+
+#ifdef COMPACT
+	if (!keep)
+		return;
+
+	uint slot = atomicAdd(count, 1u);
+#else
+	uint slot = id;
+#endif
+
+	commands[slot] = Command(object.count, keep ? 1u : 0u, object.first_index, object.base_vertex, id);
+}
+)";
+
+// glMultiDrawElementsIndirectCount, from GL 4.6 or GL_ARB_indirect_parameters
+static PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC s_draw_count = nullptr;
+
+static std::vector<std::string> defines(bool hiz)
+{
+	std::vector<std::string> result;
+
+	if (CullingGL::compaction())
+		result.push_back("COMPACT");
+
+	if (hiz)
+		result.push_back("HIZ");
+
+	return result;
+}
+
+bool CullingGL::compaction()
+{
+	static int supported = -1;
+
+	if (supported != -1)
+		return supported;
+
+	if (GLAD_GL_VERSION_4_6)
+		s_draw_count = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC>(SDL_GL_GetProcAddress("glMultiDrawElementsIndirectCount"));
+	else if (SDL_GL_ExtensionSupported("GL_ARB_indirect_parameters"))
+		s_draw_count = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC>(SDL_GL_GetProcAddress("glMultiDrawElementsIndirectCountARB"));
+
+	supported = (s_draw_count != nullptr);
+
+	_log.debug("Indirect draw count: " + std::string(supported ? "yes" : "no"));
+
+	return supported;
+}
+
+CullingGL::CullingGL(uint32_t max_objects) :
+	m_max_objects(max_objects),
+	m_objects_count(0),
+	m_objects(max_objects * sizeof(Object), nullptr, BufferGL::DYNAMIC),
+	m_commands(max_objects * sizeof(DrawListGL::Command), nullptr, BufferGL::DYNAMIC),
+	m_count(sizeof(uint32_t), nullptr, BufferGL::DYNAMIC),
+	m_shader(ComputeGL::from_source(CULLING_SOURCE, defines(false), "culling.comp")),
+	m_shader_hiz(ComputeGL::from_source(CULLING_SOURCE, defines(true), "culling_hiz.comp"))
+{
+	// Draw nothing until the first cull
+	uint32_t zero = 0;
+	glClearNamedBufferData(m_commands.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glClearNamedBufferData(m_count.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+}
+
+void CullingGL::set(const std::vector<Object>& objects)
+{
+	if (objects.size() > m_max_objects)
+		_log.warn("Too many objects, only culling the first " + std::to_string(m_max_objects));
+
+	m_objects_count = std::min<size_t>(objects.size(), m_max_objects);
+	m_objects.update(0, m_objects_count * sizeof(Object), objects.data());
+}
+
+void CullingGL::set(uint32_t index, const Object& object)
+{
+	if (index >= m_objects_count)
+		return;
+
+	m_objects.update(index * sizeof(Object), sizeof(Object), &object);
+}
+
+uint32_t CullingGL::size() const
+{
+	return m_objects_count;
+}
+
+bool CullingGL::cull(const glm::mat4& view_projection, const HiZGL* hiz)
+{
+	auto& shader = hiz ? m_shader_hiz : m_shader;
+
+	if (!shader.ready() || m_objects_count == 0)
+		return false;
+
+	uint32_t zero = 0;
+	glClearNamedBufferData(m_count.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	shader.uniform("view_projection", view_projection);
+	shader.uniform("objects_count", static_cast<int>(m_objects_count));
+
+	if (hiz) {
+		shader.bind_texture(0, hiz->texture());
+
+		shader.uniform("hiz", 0);
+		shader.uniform("hiz_view_projection", hiz->view_projection());
+		shader.uniform("hiz_levels", static_cast<int>(hiz->levels()));
+	}
+
+	shader.bind("Objects", m_objects);
+	shader.bind("Commands", m_commands);
+	shader.bind("Count", m_count);
+
+	shader.dispatch_threads(m_objects_count);
+
+	// Commands and count are consumed as indirect arguments
+	ComputeGL::command_barrier();
+
+	return true;
+}
+
+void CullingGL::draw(uint32_t mode)
+{
+	if (m_objects_count == 0)
+		return;
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands.id());
+
+	if (compaction()) {
+		glBindBuffer(GL_PARAMETER_BUFFER, m_count.id());
+		s_draw_count(mode, GL_UNSIGNED_INT, nullptr, 0, m_objects_count, 0);
+	} else {
+		glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, m_objects_count, 0);
+	}
+
+	// What survived culling is only known to the GPU
+	RenderStatsGL::draw_indirect(m_objects_count);
+}
+
+uint32_t CullingGL::command_buffer() const
+{
+	return m_commands.id();
+}
+
+uint32_t CullingGL::count_buffer() const
+{
+	return m_count.id();
+}
+
+CullingGL::Object CullingGL::object(const GeometryPoolGL::Mesh& mesh, const glm::vec3& center, float radius)
+{
+	return Object{
+		.sphere = glm::vec4(center, radius),
+		.count = mesh.index_count,
+		.first_index = mesh.first_index,
+		.base_vertex = mesh.base_vertex,
+	};
+}
@@ -0,0 +1,133 @@
+#include <string>
+
+#include <glad/gl.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/time.hh"
+#include "pistacchio/gl/debug.hh"
+
+static auto _log = Log("Debug GL");
+
+std::mutex DebugGL::s_mutex;
+std::unordered_map<uint64_t, DebugGL::Counter> DebugGL::s_counters;
+double DebugGL::s_interval = 1.0;
+bool DebugGL::s_enabled = false;
+
+static const char* source_name(GLenum source)
+{
+	switch (source) {
+	case GL_DEBUG_SOURCE_API:             return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   return "Window system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER: return "Shader compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY:     return "Third party";
+	case GL_DEBUG_SOURCE_APPLICATION:     return "Application";
+	default:                              return "Other";
+	}
+}
+
+static const char* type_name(GLenum type)
+{
+	switch (type) {
+	case GL_DEBUG_TYPE_ERROR:               return "error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY:         return "portability";
+	case GL_DEBUG_TYPE_PERFORMANCE:         return "performance";
+	case GL_DEBUG_TYPE_MARKER:              return "marker";
+	default:                                return "other";
+	}
+}
+
+DebugGL::Group::Group(const std::string& name)
+{
+	DebugGL::push(name);
+}
+
+DebugGL::Group::~Group()
+{
+	DebugGL::pop();
+}
+
+void DebugGL::enable(bool synchronous)
+{
+	int32_t flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+		_log.info("Not a debug context, the driver may report little");
+
+	glEnable(GL_DEBUG_OUTPUT);
+
+	if (synchronous)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+	glDebugMessageCallback(callback, nullptr);
+
+	// Our own groups would echo back on every push and pop
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+
+	s_enabled = true;
+}
+
+bool DebugGL::enabled()
+{
+	return s_enabled;
+}
+
+void DebugGL::interval(double seconds)
+{
+	std::lock_guard lock(s_mutex);
+
+	s_interval = seconds;
+}
+
+void DebugGL::push(const std::string& name)
+{
+	glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, name.length(), name.c_str());
+}
+
+void DebugGL::pop()
+{
+	glPopDebugGroup();
+}
+
+void GLAD_API_PTR DebugGL::callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                    GLsizei length, const GLchar* message, const void*)
+{
+	uint32_t suppressed = 0;
+
+	{
+		std::lock_guard lock(s_mutex);
+
+		// IDs are only unique within a source
+		auto& counter = s_counters.try_emplace((uint64_t(source) << 32) | id, Counter{ -s_interval, 0 }).first->second;
+		double now = Time::seconds();
+
+		if (now - counter.last < s_interval) {
+			++counter.suppressed;
+			return;
+		}
+
+		suppressed = counter.suppressed;
+		counter.last = now;
+		counter.suppressed = 0;
+	}
+
+	std::string text = std::string(source_name(source)) + " " + type_name(type) + " " + std::to_string(id) + ": " +
+	                   std::string(message, length >= 0 ? length : std::char_traits<char>::length(message));
+
+	if (suppressed)
+		text += " (" + std::to_string(suppressed) + " more since last time)";
+
+	if (type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH)
+		_log.error(text);
+	else if (type == GL_DEBUG_TYPE_PERFORMANCE || severity == GL_DEBUG_SEVERITY_MEDIUM)
+		_log.warn(text);
+	else if (severity == GL_DEBUG_SEVERITY_LOW)
+		_log.info(text);
+	else
+		_log.debug(text);
+}
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+#include <glad/gl.h>
+#include <glm/mat4x4.hpp>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/debug_draw.hh"
+#include "pistacchio/gl/render_stats.hh"
+#include "pistacchio/gl/state.hh"
+
+static auto _log = Log("Debug Draw GL");
+
+static const std::string VERTEX_SOURCE = R"(#version 450 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+
+uniform mat4 view_projection;
+
+out vec4 frag_color;
+
+void main()
+{
+	frag_color = color;
+	gl_Position = view_projection * vec4(position, 1.0);
+}
+)";
+
+static const std::string FRAGMENT_SOURCE = R"(#version 450 core
+
+in vec4 frag_color;
+
+out vec4 out_color;
+
+void main()
+{
+	out_color = frag_color;
+}
+)";
+
+static uint32_t pack(const glm::vec4& color)
+{
+	uint32_t result = 0;
+
+	for (int i = 0; i < 4; ++i)
+		result |= static_cast<uint32_t>(std::clamp(color[i], 0.0f, 1.0f) * 255.0f + 0.5f) << (i * 8);
+
+	return result;
+}
+
+void DebugDrawGL::Batch::line(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color, Layer layer)
+{
+	auto packed = pack(color);
+
+	m_lines[layer].push_back({ from, packed });
+	m_lines[layer].push_back({ to, packed });
+}
+
+void DebugDrawGL::Batch::triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec4& color, Layer layer)
+{
+	auto packed = pack(color);
+
+	m_triangles[layer].push_back({ a, packed });
+	m_triangles[layer].push_back({ b, packed });
+	m_triangles[layer].push_back({ c, packed });
+}
+
+void DebugDrawGL::Batch::box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, Layer layer)
+{
+	std::array<glm::vec3, 8> corners;
+
+	for (int i = 0; i < 8; ++i)
+		corners[i] = glm::vec3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+
+	cube(corners, color, layer);
+}
+
+void DebugDrawGL::Batch::box(const glm::mat4& transform, const glm::vec4& color, Layer layer)
+{
+	std::array<glm::vec3, 8> corners;
+
+	for (int i = 0; i < 8; ++i)
+		corners[i] = glm::vec3(transform * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f));
+
+	cube(corners, color, layer);
+}
+
+void DebugDrawGL::Batch::sphere(const glm::vec3& center, float radius, const glm::vec4& color, Layer layer, uint32_t segments)
+{
+	auto packed = pack(color);
+	auto& lines = m_lines[layer];
+
+	segments = std::max(segments, 3u);
+
+	for (int axis = 0; axis < 3; ++axis) {
+		glm::vec3 previous;
+
+		for (uint32_t i = 0; i <= segments; ++i) {
+			float angle = 2.0f * 3.14159265f * i / segments;
+			float u = std::cos(angle) * radius;
+			float v = std::sin(angle) * radius;
+
+			glm::vec3 point = center;
+			point[(axis + 1) % 3] += u;
+			point[(axis + 2) % 3] += v;
+
+			if (i > 0) {
+				lines.push_back({ previous, packed });
+				lines.push_back({ point, packed });
+			}
+
+			previous = point;
+		}
+	}
+}
+
+void DebugDrawGL::Batch::frustum(const glm::mat4& view_projection, const glm::vec4& color, Layer layer)
+{
+	auto inverse = glm::inverse(view_projection);
+	std::array<glm::vec3, 8> corners;
+
+	for (int i = 0; i < 8; ++i) {
+		auto corner = inverse * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+		corners[i] = glm::vec3(corner) / corner.w;
+	}
+
+	cube(corners, color, layer);
+}
+
+size_t DebugDrawGL::Batch::size() const
+{
+	size_t result = 0;
+
+	for (uint32_t layer = 0; layer < LAYERS; ++layer)
+		result += m_lines[layer].size() + m_triangles[layer].size();
+
+	return result;
+}
+
+void DebugDrawGL::Batch::clear()
+{
+	for (uint32_t layer = 0; layer < LAYERS; ++layer) {
+		m_lines[layer].clear();
+		m_triangles[layer].clear();
+	}
+}
+
+// Corners are indexed by bit: 1 for +X, 2 for +Y and 4 for +Z
+void DebugDrawGL::Batch::cube(const std::array<glm::vec3, 8>& corners, const glm::vec4& color, Layer layer)
+{
+	auto packed = pack(color);
+	auto& lines = m_lines[layer];
+
+	for (int i = 0; i < 8; ++i) {
+		for (int bit = 1; bit < 8; bit <<= 1) {
+			if (i & bit)
+				continue;
+
+			lines.push_back({ corners[i], packed });
+			lines.push_back({ corners[i | bit], packed });
+		}
+	}
+}
+
+DebugDrawGL::DebugDrawGL(size_t max_vertices) :
+	m_max_vertices(max_vertices),
+	m_vertices(BufferGL::stream(max_vertices * sizeof(Vertex))),
+	m_layout{
+		.attributes = {
+			{ .location = 0, .size = 3, .type = GL_FLOAT, .binding = 0 },
+			{ .location = 1, .size = 4, .type = GL_UNSIGNED_BYTE, .binding = 0, .offset = offsetof(Vertex, color), .normalized = true },
+		},
+		.bindings = {
+			{ .index = 0, .stride = sizeof(Vertex) },
+		},
+	},
+	m_shader(ShaderGL::from_source({
+		{ ShaderGL::VERTEX, VERTEX_SOURCE },
+		{ ShaderGL::FRAGMENT, FRAGMENT_SOURCE },
+	}, {}, "debug_draw"))
+{
+}
+
+DebugDrawGL::Batch& DebugDrawGL::batch()
+{
+	std::lock_guard lock(m_mutex);
+
+	auto id = std::this_thread::get_id();
+
+	for (auto& [thread, batch] : m_batches)
+		if (thread == id)
+			return *batch;
+
+	// Batches live as long as the debug draw so recorders can keep the
+	// reference
+	m_batches.emplace_back(id, std::make_unique<Batch>());
+
+	return *m_batches.back().second;
+}
+
+uint32_t DebugDrawGL::draw(const glm::mat4& view_projection)
+{
+	std::lock_guard lock(m_mutex);
+
+	size_t total = 0;
+
+	for (auto& [thread, batch] : m_batches)
+		total += batch->size();
+
+	if (total == 0)
+		return 0;
+
+	if (total > m_max_vertices) {
+		_log.warn("Too many debug vertices (" + std::to_string(total) + "), skipping frame");
+
+		for (auto& [thread, batch] : m_batches)
+			batch->clear();
+
+		return 0;
+	}
+
+	m_shader.wait();
+
+	auto allocation = m_vertices.allocate(total * sizeof(Vertex), sizeof(Vertex));
+
+	if (!allocation.data || m_shader.state() != ShaderGL::READY) {
+		for (auto& [thread, batch] : m_batches)
+			batch->clear();
+
+		return 0;
+	}
+
+	// Every thread's shapes of the same layer and type end up contiguous, so
+	// each run is a single draw
+
+	struct Range {
+		uint32_t mode;
+		Layer layer;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	std::vector<Range> ranges;
+	auto vertices = static_cast<Vertex*>(allocation.data);
+	uint32_t written = 0;
+
+	for (auto layer : { DEPTH_TESTED, OVERLAY }) {
+		for (auto mode : { GL_LINES, GL_TRIANGLES }) {
+			uint32_t first = written;
+
+			for (auto& [thread, batch] : m_batches) {
+				auto& source = mode == GL_LINES ? batch->m_lines[layer] : batch->m_triangles[layer];
+
+				std::copy(source.begin(), source.end(), vertices + written);
+				written += source.size();
+			}
+
+			if (written > first)
+				ranges.push_back({ static_cast<uint32_t>(mode), layer, first, written - first });
+		}
+	}
+
+	for (auto& [thread, batch] : m_batches)
+		batch->clear();
+
+	m_shader.uniform("view_projection", view_projection);
+
+	StateGL::use_program(m_shader.id());
+	StateGL::bind_vertex_array(m_layout.vao());
+	StateGL::polygon_mode(GL_FILL);
+	m_layout.bind_buffer(0, m_vertices.id(), allocation.offset);
+
+	for (const auto& range : ranges) {
+		StateGL::depth_test(range.layer == DEPTH_TESTED);
+		glDrawArrays(range.mode, range.first, range.count);
+		RenderStatsGL::draw(range.mode, range.count);
+	}
+
+	StateGL::depth_test(true);
+
+	m_vertices.next_frame();
+
+	return ranges.size();
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glad/gl.h>
+
+#include "pistacchio/gl/dynamic_resolution.hh"
+#include "pistacchio/gl/memory.hh"
+
+// Fraction of the frame budget the scene aims for, leaving room for the rest
+// of the frame
+static constexpr double BUDGET = 0.85;
+
+// Relative distance from the ideal scale below which the scale is left alone,
+// so that it doesn't jitter
+static constexpr float HYSTERESIS = 0.02f;
+
+DynamicResolutionGL::DynamicResolutionGL(uint32_t width, uint32_t height) :
+	m_width(0),
+	m_height(0),
+	m_color(0),
+	m_depth(0),
+	m_framebuffer(0),
+	m_enabled(true),
+	m_target_rate(0.0),
+	m_scale(1.0f),
+	m_min_scale(0.5f),
+	m_max_scale(1.0f),
+	m_gpu_time(0.0),
+	m_queries{},
+	m_pending{},
+	m_timing(false),
+	m_frame(0)
+{
+	glCreateQueries(GL_TIME_ELAPSED, QUERIES, m_queries.data());
+
+	resize(width, height);
+}
+
+DynamicResolutionGL::~DynamicResolutionGL()
+{
+	release();
+
+	glDeleteQueries(QUERIES, m_queries.data());
+}
+
+void DynamicResolutionGL::release()
+{
+	if (m_framebuffer)
+		glDeleteFramebuffers(1, &m_framebuffer);
+
+	if (m_color) {
+		MemoryGL::release(MemoryGL::TEXTURE, m_color);
+		glDeleteTextures(1, &m_color);
+	}
+
+	if (m_depth) {
+		MemoryGL::release(MemoryGL::TEXTURE, m_depth);
+		glDeleteTextures(1, &m_depth);
+	}
+
+	m_framebuffer = 0;
+	m_color = 0;
+	m_depth = 0;
+}
+
+void DynamicResolutionGL::resize(uint32_t width, uint32_t height)
+{
+	if (width == m_width && height == m_height)
+		return;
+
+	release();
+
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_color);
+	glTextureStorage2D(m_color, 1, GL_RGBA8, m_width, m_height);
+	MemoryGL::allocate(MemoryGL::TEXTURE, m_color, MemoryGL::texture_size(GL_RGBA8, m_width, m_height), "dynamic resolution");
+	glTextureParameteri(m_color, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_color, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depth);
+	glTextureStorage2D(m_depth, 1, GL_DEPTH_COMPONENT32F, m_width, m_height);
+	MemoryGL::allocate(MemoryGL::TEXTURE, m_depth, MemoryGL::texture_size(GL_DEPTH_COMPONENT32F, m_width, m_height), "dynamic resolution");
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_color, 0);
+	glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_depth, 0);
+}
+
+bool DynamicResolutionGL::enabled() const
+{
+	return m_enabled;
+}
+
+void DynamicResolutionGL::enabled(bool value)
+{
+	m_enabled = value;
+}
+
+void DynamicResolutionGL::target_rate(double value)
+{
+	m_target_rate = value;
+}
+
+void DynamicResolutionGL::scale_limits(float min, float max)
+{
+	m_min_scale = std::clamp(min, 0.1f, 1.0f);
+	m_max_scale = std::clamp(max, m_min_scale, 1.0f);
+	m_scale = std::clamp(m_scale, m_min_scale, m_max_scale);
+}
+
+float DynamicResolutionGL::scale() const
+{
+	return m_enabled ? m_scale : 1.0f;
+}
+
+double DynamicResolutionGL::gpu_time() const
+{
+	return m_gpu_time;
+}
+
+uint32_t DynamicResolutionGL::render_width() const
+{
+	return std::max<uint32_t>(std::lround(m_width * scale()), 1);
+}
+
+uint32_t DynamicResolutionGL::render_height() const
+{
+	return std::max<uint32_t>(std::lround(m_height * scale()), 1);
+}
+
+uint32_t DynamicResolutionGL::framebuffer() const
+{
+	return m_framebuffer;
+}
+
+uint32_t DynamicResolutionGL::color_texture() const
+{
+	return m_color;
+}
+
+uint32_t DynamicResolutionGL::depth_texture() const
+{
+	return m_depth;
+}
+
+void DynamicResolutionGL::begin()
+{
+	auto slot = m_frame % QUERIES;
+
+	// Still waiting on the result from `QUERIES` frames ago, skip timing this
+	// frame rather than stall
+	m_timing = !m_pending[slot];
+
+	if (m_timing) {
+		glBeginQuery(GL_TIME_ELAPSED, m_queries[slot]);
+		m_pending[slot] = true;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, render_width(), render_height());
+}
+
+void DynamicResolutionGL::end()
+{
+	if (m_timing)
+		glEndQuery(GL_TIME_ELAPSED);
+
+	glBlitNamedFramebuffer(m_framebuffer, 0,
+		0, 0, render_width(), render_height(),
+		0, 0, m_width, m_height,
+		GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_width, m_height);
+
+	adjust();
+
+	++m_frame;
+}
+
+void DynamicResolutionGL::adjust()
+{
+	for (uint32_t i = 0; i < QUERIES; ++i) {
+		if (!m_pending[i])
+			continue;
+
+		int32_t available = GL_FALSE;
+		glGetQueryObjectiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (!available)
+			continue;
+
+		uint64_t elapsed = 0;
+		glGetQueryObjectui64v(m_queries[i], GL_QUERY_RESULT, &elapsed);
+
+		m_pending[i] = false;
+
+		double milliseconds = elapsed / 1e+6;
+		m_gpu_time = (m_gpu_time == 0.0) ? milliseconds : m_gpu_time * 0.9 + milliseconds * 0.1;
+	}
+
+	if (!m_enabled || m_target_rate <= 0.0 || m_gpu_time <= 0.0)
+		return;
+
+	// GPU time grows with the pixel count, i.e. with the scale squared. Move
+	// only part of the way there each frame to stay stable.
+
+	double budget = 1000.0 / m_target_rate * BUDGET;
+	float ideal = m_scale * std::sqrt(budget / m_gpu_time);
+
+	// The deadband is on the error, the damping only on the step taken
+	if (std::abs(ideal - m_scale) > HYSTERESIS * m_scale)
+		m_scale = std::clamp(m_scale + (ideal - m_scale) * 0.1f, m_min_scale, m_max_scale);
+}
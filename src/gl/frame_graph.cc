@@ -0,0 +1,476 @@
+#include <algorithm>
+
+#include <glad/gl.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/debug.hh"
+#include "pistacchio/gl/frame_graph.hh"
+#include "pistacchio/gl/memory.hh"
+
+static auto _log = Log("Frame Graph GL");
+
+static uint32_t attachment_point(uint32_t format)
+{
+	switch (format) {
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+		return GL_DEPTH_ATTACHMENT;
+	case GL_DEPTH24_STENCIL8:
+	case GL_DEPTH32F_STENCIL8:
+		return GL_DEPTH_STENCIL_ATTACHMENT;
+	case GL_STENCIL_INDEX8:
+		return GL_STENCIL_ATTACHMENT;
+	default:
+		return GL_COLOR_ATTACHMENT0;
+	}
+}
+
+//
+// FrameGraphGL::Builder
+//
+
+FrameGraphGL::Builder::Builder(FrameGraphGL& graph, PassNode& pass) :
+	m_graph(graph),
+	m_pass(pass)
+{
+}
+
+FrameGraphGL::Resource FrameGraphGL::Builder::create(const std::string& name, const TextureDesc& desc)
+{
+	m_graph.m_resources.push_back(ResourceNode{
+		.name = name,
+		.desc = desc,
+		.texture = 0,
+		.imported = false,
+		.writers = {},
+		.readers = 0,
+		.first = -1,
+		.last = -1,
+		.stored = false
+	});
+
+	return m_graph.m_resources.size() - 1;
+}
+
+FrameGraphGL::Resource FrameGraphGL::Builder::read(Resource resource)
+{
+	m_pass.reads.push_back(resource);
+	++m_graph.m_resources[resource].readers;
+
+	return resource;
+}
+
+FrameGraphGL::Resource FrameGraphGL::Builder::write(Resource resource, Access access)
+{
+	m_pass.writes.emplace_back(resource, access);
+	m_graph.m_resources[resource].writers.push_back(&m_pass - m_graph.m_passes.data());
+
+	return resource;
+}
+
+void FrameGraphGL::Builder::side_effect()
+{
+	m_pass.side_effect = true;
+}
+
+//
+// FrameGraphGL::Context
+//
+
+FrameGraphGL::Context::Context(const FrameGraphGL& graph, uint32_t framebuffer) :
+	m_graph(graph),
+	m_framebuffer(framebuffer)
+{
+}
+
+uint32_t FrameGraphGL::Context::texture(Resource resource) const
+{
+	return m_graph.m_resources[resource].texture;
+}
+
+uint32_t FrameGraphGL::Context::framebuffer() const
+{
+	return m_framebuffer;
+}
+
+//
+// FrameGraphGL
+//
+
+FrameGraphGL::FrameGraphGL() :
+	m_frame(0)
+{
+	m_resources.push_back(ResourceNode{
+		.name = "Backbuffer",
+		.desc = TextureDesc{ 0, 0, GL_RGBA8 },
+		.texture = 0,
+		.imported = true,
+		.writers = {},
+		.readers = 0,
+		.first = -1,
+		.last = -1,
+		.stored = false
+	});
+}
+
+FrameGraphGL::~FrameGraphGL()
+{
+	for (const auto& [attachments, name] : m_framebuffers)
+		glDeleteFramebuffers(1, &name);
+
+	for (const auto& texture : m_pool) {
+		MemoryGL::release(MemoryGL::TEXTURE, texture.name);
+		glDeleteTextures(1, &texture.name);
+	}
+
+	for (auto& queries : m_queries)
+		if (!queries.queries.empty())
+			glDeleteQueries(queries.queries.size(), queries.queries.data());
+}
+
+void FrameGraphGL::backbuffer(uint32_t width, uint32_t height)
+{
+	m_resources[BACKBUFFER].desc.width = width;
+	m_resources[BACKBUFFER].desc.height = height;
+}
+
+FrameGraphGL::Resource FrameGraphGL::import(const std::string& name, uint32_t texture, const TextureDesc& desc)
+{
+	m_resources.push_back(ResourceNode{
+		.name = name,
+		.desc = desc,
+		.texture = texture,
+		.imported = true,
+		.writers = {},
+		.readers = 0,
+		.first = -1,
+		.last = -1,
+		.stored = false
+	});
+
+	return m_resources.size() - 1;
+}
+
+void FrameGraphGL::add_pass(const std::string& name,
+                            const std::function<void(Builder&)>& setup,
+                            const std::function<void(const Context&)>& execute)
+{
+	m_passes.push_back(PassNode{
+		.name = name,
+		.execute = execute,
+		.reads = {},
+		.writes = {},
+		.side_effect = false,
+		.references = 0
+	});
+
+	Builder builder(*this, m_passes.back());
+	setup(builder);
+}
+
+// Culls passes by reference counting backwards from whatever is used outside
+// the graph: imported resources count as having an extra reader.
+void FrameGraphGL::cull()
+{
+	for (auto& pass : m_passes)
+		pass.references = pass.writes.size();
+
+	std::vector<Resource> unused;
+
+	for (Resource r = 0; r < m_resources.size(); ++r) {
+		if (m_resources[r].imported)
+			++m_resources[r].readers;
+
+		if (m_resources[r].readers == 0)
+			unused.push_back(r);
+	}
+
+	while (!unused.empty()) {
+		auto resource = unused.back();
+		unused.pop_back();
+
+		for (auto writer : m_resources[resource].writers) {
+			auto& pass = m_passes[writer];
+
+			if (--pass.references > 0 || pass.side_effect)
+				continue;
+
+			for (auto read : pass.reads)
+				if (--m_resources[read].readers == 0)
+					unused.push_back(read);
+		}
+	}
+}
+
+uint32_t FrameGraphGL::acquire(const TextureDesc& desc)
+{
+	for (auto& texture : m_pool) {
+		if (!texture.in_use && texture.desc == desc) {
+			texture.in_use = true;
+			texture.unused_frames = 0;
+			return texture.name;
+		}
+	}
+
+	uint32_t name = 0;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &name);
+	glTextureStorage2D(name, 1, desc.format, desc.width, desc.height);
+	MemoryGL::allocate(MemoryGL::TEXTURE, name, MemoryGL::texture_size(desc.format, desc.width, desc.height), "frame graph");
+	glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(name, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(name, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	m_pool.push_back(PooledTexture{ desc, name, 0, true });
+
+	return name;
+}
+
+void FrameGraphGL::release(uint32_t name)
+{
+	for (auto& texture : m_pool)
+		if (texture.name == name)
+			texture.in_use = false;
+}
+
+// Frees textures that weren't used for a while, with their framebuffers
+void FrameGraphGL::collect()
+{
+	for (auto it = m_pool.begin(); it != m_pool.end();) {
+		if (it->in_use || ++it->unused_frames <= FRAMES) {
+			++it;
+			continue;
+		}
+
+		forget(it->name);
+
+		MemoryGL::release(MemoryGL::TEXTURE, it->name);
+		glDeleteTextures(1, &it->name);
+		it = m_pool.erase(it);
+	}
+}
+
+// Deletes every cached framebuffer with `texture` attached
+void FrameGraphGL::forget(uint32_t texture)
+{
+	for (auto fb = m_framebuffers.begin(); fb != m_framebuffers.end();) {
+		if (std::find(fb->first.begin(), fb->first.end(), texture) != fb->first.end()) {
+			glDeleteFramebuffers(1, &fb->second);
+			fb = m_framebuffers.erase(fb);
+		} else {
+			++fb;
+		}
+	}
+}
+
+uint32_t FrameGraphGL::framebuffer(const std::vector<Resource>& attachments)
+{
+	std::vector<uint32_t> key;
+
+	for (auto resource : attachments)
+		key.push_back(m_resources[resource].texture);
+
+	if (auto it = m_framebuffers.find(key); it != m_framebuffers.end())
+		return it->second;
+
+	uint32_t name = 0;
+	glCreateFramebuffers(1, &name);
+
+	std::vector<uint32_t> draw_buffers;
+
+	for (auto resource : attachments) {
+		const auto& node = m_resources[resource];
+		auto point = attachment_point(node.desc.format);
+
+		if (point == GL_COLOR_ATTACHMENT0) {
+			point += draw_buffers.size();
+			draw_buffers.push_back(point);
+		}
+
+		glNamedFramebufferTexture(name, point, node.texture, 0);
+	}
+
+	if (draw_buffers.empty())
+		glNamedFramebufferDrawBuffer(name, GL_NONE);
+	else
+		glNamedFramebufferDrawBuffers(name, draw_buffers.size(), draw_buffers.data());
+
+	if (glCheckNamedFramebufferStatus(name, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		_log.warn("Incomplete framebuffer");
+
+	m_framebuffers.emplace(key, name);
+
+	return name;
+}
+
+void FrameGraphGL::read_timings(Queries& queries)
+{
+	if (queries.used == 0)
+		return;
+
+	m_timings.clear();
+
+	for (uint32_t i = 0; i < queries.names.size(); ++i) {
+		uint64_t begin = 0;
+		uint64_t end = 0;
+
+		glGetQueryObjectui64v(queries.queries[i * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(queries.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+		m_timings.push_back(Timing{ queries.names[i], (end - begin) / 1e+6 });
+	}
+
+	queries.names.clear();
+	queries.used = 0;
+}
+
+void FrameGraphGL::execute()
+{
+	cull();
+
+	std::vector<uint32_t> live;
+
+	for (uint32_t i = 0; i < m_passes.size(); ++i)
+		if (m_passes[i].references > 0 || m_passes[i].side_effect)
+			live.push_back(i);
+
+	// Lifetimes, in positions of `live`
+
+	for (int32_t position = 0; position < static_cast<int32_t>(live.size()); ++position) {
+		const auto& pass = m_passes[live[position]];
+
+		auto use = [&](Resource resource) {
+			auto& node = m_resources[resource];
+
+			if (node.first == -1)
+				node.first = position;
+
+			node.last = position;
+		};
+
+		for (auto resource : pass.reads)
+			use(resource);
+
+		for (const auto& [resource, access] : pass.writes)
+			use(resource);
+	}
+
+	// Results from `FRAMES` frames ago should be ready by now
+
+	auto& queries = m_queries[m_frame % FRAMES];
+	read_timings(queries);
+
+	if (queries.queries.size() < live.size() * 2) {
+		auto first = queries.queries.size();
+		queries.queries.resize(live.size() * 2);
+		glCreateQueries(GL_TIMESTAMP, queries.queries.size() - first, queries.queries.data() + first);
+	}
+
+	for (int32_t position = 0; position < static_cast<int32_t>(live.size()); ++position) {
+		const auto& pass = m_passes[live[position]];
+
+		for (auto& node : m_resources)
+			if (!node.imported && node.first == position)
+				node.texture = acquire(node.desc);
+
+		uint32_t barriers = 0;
+
+		for (auto resource : pass.reads)
+			if (m_resources[resource].stored)
+				barriers |= GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+
+		for (const auto& [resource, access] : pass.writes)
+			if (m_resources[resource].stored)
+				barriers |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+
+		if (barriers)
+			glMemoryBarrier(barriers);
+
+		// Framebuffer and viewport for attachment writes
+
+		std::vector<Resource> attachments;
+		bool backbuffer = false;
+
+		for (const auto& [resource, access] : pass.writes) {
+			if (access != ATTACHMENT)
+				continue;
+
+			if (resource == BACKBUFFER)
+				backbuffer = true;
+			else
+				attachments.push_back(resource);
+		}
+
+		uint32_t fb = 0;
+
+		// The default framebuffer can't be combined with textures
+		if (backbuffer && !attachments.empty() && m_mixed_backbuffer.insert(pass.name).second)
+			_log.warn("Pass " + pass.name + " writes the backbuffer and other attachments, only the backbuffer is bound");
+
+		if (backbuffer || !attachments.empty()) {
+			const auto& desc = m_resources[backbuffer ? BACKBUFFER : attachments[0]].desc;
+
+			if (!backbuffer)
+				fb = framebuffer(attachments);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, fb);
+			glViewport(0, 0, desc.width, desc.height);
+		}
+
+		glQueryCounter(queries.queries[position * 2], GL_TIMESTAMP);
+
+		{
+			// Same scope as the timing, so captures line up with `timings()`
+			DebugGL::Group group(pass.name);
+
+			pass.execute(Context(*this, fb));
+		}
+
+		glQueryCounter(queries.queries[position * 2 + 1], GL_TIMESTAMP);
+
+		queries.names.push_back(pass.name);
+
+		for (const auto& [resource, access] : pass.writes)
+			m_resources[resource].stored = (access == STORAGE);
+
+		for (auto& node : m_resources)
+			if (!node.imported && node.last == position)
+				release(node.texture);
+	}
+
+	queries.used = live.size();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	collect();
+
+	// Imported textures are owned elsewhere and their names can be reused for
+	// new textures once deleted, so their framebuffers only last a frame
+	for (Resource r = BACKBUFFER + 1; r < m_resources.size(); ++r)
+		if (m_resources[r].imported && m_resources[r].texture)
+			forget(m_resources[r].texture);
+
+	// Only the backbuffer survives to the next frame
+	m_passes.clear();
+	m_resources.resize(1);
+	m_resources[BACKBUFFER].writers.clear();
+	m_resources[BACKBUFFER].readers = 0;
+	m_resources[BACKBUFFER].first = -1;
+	m_resources[BACKBUFFER].last = -1;
+	m_resources[BACKBUFFER].stored = false;
+
+	++m_frame;
+}
+
+const std::vector<FrameGraphGL::Timing>& FrameGraphGL::timings() const
+{
+	return m_timings;
+}
+
+size_t FrameGraphGL::pooled_textures() const
+{
+	return m_pool.size();
+}
@@ -0,0 +1,218 @@
+#include <string>
+
+#include <glad/gl.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/geometry_pool.hh"
+#include "pistacchio/gl/render_stats.hh"
+
+static auto _log = Log("Geometry Pool GL");
+
+// Frames the GPU may lag behind, sizes the streaming rings
+static constexpr uint32_t FRAMES_IN_FLIGHT = 3;
+
+//
+// GeometryPoolGL::FreeList
+//
+
+bool GeometryPoolGL::FreeList::allocate(uint32_t count, uint32_t& first)
+{
+	for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+		if (it->count < count)
+			continue;
+
+		first = it->first;
+
+		it->first += count;
+		it->count -= count;
+
+		if (it->count == 0)
+			ranges.erase(it);
+
+		return true;
+	}
+
+	return false;
+}
+
+void GeometryPoolGL::FreeList::release(uint32_t first, uint32_t count)
+{
+	// Keep ranges sorted and merge with the neighbours
+
+	auto it = ranges.begin();
+
+	while (it != ranges.end() && it->first < first)
+		++it;
+
+	it = ranges.insert(it, Range{ first, count });
+
+	auto next = it + 1;
+
+	if (next != ranges.end() && it->first + it->count == next->first) {
+		it->count += next->count;
+		ranges.erase(next);
+	}
+
+	if (it != ranges.begin()) {
+		auto previous = it - 1;
+
+		if (previous->first + previous->count == it->first) {
+			previous->count += it->count;
+			ranges.erase(it);
+		}
+	}
+}
+
+//
+// GeometryPoolGL
+//
+
+GeometryPoolGL::GeometryPoolGL(uint32_t max_vertices, uint32_t max_indices) :
+	m_vertices(max_vertices * sizeof(glm::vec3), nullptr, BufferGL::DYNAMIC),
+	m_normals(max_vertices * sizeof(glm::vec3), nullptr, BufferGL::DYNAMIC),
+	m_indices(max_indices * sizeof(uint32_t), nullptr, BufferGL::DYNAMIC)
+{
+	m_free_vertices.ranges.push_back({ 0, max_vertices });
+	m_free_indices.ranges.push_back({ 0, max_indices });
+}
+
+GeometryPoolGL::Mesh GeometryPoolGL::add(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<uint32_t>& indices)
+{
+	if (vertices.empty() || indices.empty() || normals.size() != vertices.size()) {
+		_log.warn("Invalid mesh");
+		return Mesh{};
+	}
+
+	uint32_t base_vertex = 0;
+	uint32_t first_index = 0;
+
+	if (!m_free_vertices.allocate(vertices.size(), base_vertex)) {
+		_log.warn("Out of vertex space for " + std::to_string(vertices.size()) + " vertices");
+		return Mesh{};
+	}
+
+	if (!m_free_indices.allocate(indices.size(), first_index)) {
+		_log.warn("Out of index space for " + std::to_string(indices.size()) + " indices");
+		m_free_vertices.release(base_vertex, vertices.size());
+		return Mesh{};
+	}
+
+	m_vertices.update(base_vertex * sizeof(glm::vec3), vertices.size() * sizeof(glm::vec3), vertices.data());
+	m_normals.update(base_vertex * sizeof(glm::vec3), normals.size() * sizeof(glm::vec3), normals.data());
+	m_indices.update(first_index * sizeof(uint32_t), indices.size() * sizeof(uint32_t), indices.data());
+
+	return Mesh{
+		.first_index = first_index,
+		.index_count = static_cast<uint32_t>(indices.size()),
+		.base_vertex = static_cast<int32_t>(base_vertex),
+		.vertex_count = static_cast<uint32_t>(vertices.size())
+	};
+}
+
+void GeometryPoolGL::remove(const Mesh& mesh)
+{
+	if (mesh.index_count == 0)
+		return;
+
+	m_free_vertices.release(mesh.base_vertex, mesh.vertex_count);
+	m_free_indices.release(mesh.first_index, mesh.index_count);
+}
+
+uint32_t GeometryPoolGL::vertex_buffer() const
+{
+	return m_vertices.id();
+}
+
+uint32_t GeometryPoolGL::normal_buffer() const
+{
+	return m_normals.id();
+}
+
+uint32_t GeometryPoolGL::index_buffer() const
+{
+	return m_indices.id();
+}
+
+void GeometryPoolGL::bind(const VertexLayout& layout, uint32_t vertex_binding, uint32_t normal_binding) const
+{
+	layout.bind_buffer(vertex_binding, vertex_buffer());
+	layout.bind_buffer(normal_binding, normal_buffer());
+	layout.bind_index_buffer(index_buffer());
+}
+
+//
+// DrawListGL
+//
+
+DrawListGL::DrawListGL(uint32_t max_draws, uint32_t data_stride) :
+	m_max_draws(max_draws),
+	m_data_stride(data_stride),
+	m_command_ring(BufferGL::stream(max_draws * sizeof(Command), FRAMES_IN_FLIGHT)),
+	m_data_ring(BufferGL::stream(max_draws * data_stride, FRAMES_IN_FLIGHT))
+{
+	m_commands.reserve(max_draws);
+	m_data.reserve(max_draws * data_stride);
+}
+
+void DrawListGL::clear()
+{
+	m_commands.clear();
+	m_data.clear();
+
+	m_command_ring.next_frame();
+	m_data_ring.next_frame();
+}
+
+void DrawListGL::add(const GeometryPoolGL::Mesh& mesh, const void* data, size_t size, uint32_t instances)
+{
+	if (size != m_data_stride) {
+		_log.warn("Per-draw data of " + std::to_string(size) + " bytes, the list expects " + std::to_string(m_data_stride));
+		return;
+	}
+
+	if (mesh.index_count == 0)
+		return;
+
+	if (m_commands.size() == m_max_draws) {
+		_log.warn("Draw list full");
+		return;
+	}
+
+	m_commands.push_back(Command{
+		.count = mesh.index_count,
+		.instance_count = instances,
+		.first_index = mesh.first_index,
+		.base_vertex = mesh.base_vertex,
+		.base_instance = static_cast<uint32_t>(m_commands.size())
+	});
+
+	auto bytes = static_cast<const uint8_t*>(data);
+	m_data.insert(m_data.end(), bytes, bytes + m_data_stride);
+}
+
+size_t DrawListGL::size() const
+{
+	return m_commands.size();
+}
+
+void DrawListGL::submit(uint32_t data_binding, uint32_t mode)
+{
+	if (m_commands.empty())
+		return;
+
+	auto commands = m_command_ring.write(m_commands);
+	auto data = m_data_ring.write(m_data, BufferGL::offset_alignment());
+
+	if (!commands.data || !data.data)
+		return;
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, data_binding, m_data_ring.id(), data.offset, data.size);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_ring.id());
+
+	glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(static_cast<uintptr_t>(commands.offset)),
+		m_commands.size(), 0);
+
+	for (const auto& command : m_commands)
+		RenderStatsGL::draw(mode, command.count, command.instance_count);
+}
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/hiz.hh"
+#include "pistacchio/gl/memory.hh"
+
+static auto _log = Log("HiZ GL");
+
+// Levels read back for the CPU test are at most this wide
+static constexpr uint32_t READBACK_WIDTH = 128;
+
+static const char* REDUCE_SOURCE = R"(#version 450 core
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#ifdef DEPTH_INPUT
+uniform sampler2D source;
+#else
+layout(rg32f, binding = 0) readonly uniform image2D source;
+#endif
+
+layout(rg32f, binding = 1) writeonly uniform image2D destination;
+
+uniform ivec2 source_size;
+uniform ivec2 destination_size;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+	if (any(greaterThanEqual(texel, destination_size)))
+		return;
+
+#ifdef DEPTH_INPUT
+	float depth = texelFetch(source, texel, 0).r;
+
+	imageStore(destination, texel, vec4(depth, depth, 0.0, 0.0));
+#else
+	// With odd source sizes the last texel also covers the extra row/column,
+	// so that no source texel is ever skipped.
+	ivec2 first = texel * 2;
+	ivec2 last = min(first + 1 + ivec2(equal(texel, destination_size - 1)) * (source_size & 1), source_size - 1);
+
+	vec2 result = vec2(1.0, 0.0);
+
+	for (int y = first.y; y <= last.y; ++y) {
+		for (int x = first.x; x <= last.x; ++x) {
+			vec2 depth = imageLoad(source, ivec2(x, y)).rg;
+			result = vec2(min(result.x, depth.x), max(result.y, depth.y));
+		}
+	}
+
+	imageStore(destination, texel, vec4(result, 0.0, 0.0));
+#endif
+}
+)";
+
+HiZGL::HiZGL(uint32_t width, uint32_t height) :
+	m_texture(0),
+	m_width(0),
+	m_height(0),
+	m_levels(0),
+	m_built(false),
+	m_view_projection(1.0f),
+	m_reduce_depth(ComputeGL::from_source(REDUCE_SOURCE, { "DEPTH_INPUT" }, "hiz_depth.comp")),
+	m_reduce(ComputeGL::from_source(REDUCE_SOURCE, {}, "hiz.comp")),
+	m_readback_level(0),
+	m_readback_fence(nullptr),
+	m_readback_view_projection(1.0f)
+{
+	resize(width, height);
+}
+
+HiZGL::~HiZGL()
+{
+	release();
+}
+
+void HiZGL::release()
+{
+	if (m_readback_fence)
+		glDeleteSync(m_readback_fence);
+
+	if (m_texture) {
+		MemoryGL::release(MemoryGL::TEXTURE, m_texture);
+		glDeleteTextures(1, &m_texture);
+	}
+
+	m_readback_fence = nullptr;
+	m_texture = 0;
+	m_built = false;
+	m_readback = BufferGL();
+	m_cpu.clear();
+}
+
+void HiZGL::resize(uint32_t width, uint32_t height)
+{
+	if (width == m_width && height == m_height)
+		return;
+
+	release();
+
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+	m_levels = std::floor(std::log2(std::max(m_width, m_height))) + 1;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+	glTextureStorage2D(m_texture, m_levels, GL_RG32F, m_width, m_height);
+	MemoryGL::allocate(MemoryGL::TEXTURE, m_texture, MemoryGL::texture_size(GL_RG32F, m_width, m_height, m_levels), "hiz");
+	glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	m_readback_level = 0;
+
+	while (m_readback_level + 1 < m_levels && std::max(m_width >> m_readback_level, 1u) > READBACK_WIDTH)
+		++m_readback_level;
+
+	uint32_t readback_width = std::max(m_width >> m_readback_level, 1u);
+	uint32_t readback_height = std::max(m_height >> m_readback_level, 1u);
+
+	m_readback = BufferGL(readback_width * readback_height * sizeof(glm::vec2), nullptr, GL_MAP_READ_BIT);
+}
+
+void HiZGL::build(uint32_t depth_texture, const glm::mat4& view_projection)
+{
+	// Skipped until both programs are linked, the CPU test just answers
+	// "not occluded" in the meantime
+	bool ready = m_reduce_depth.ready();
+
+	if (!m_reduce.ready() || !ready)
+		return;
+
+	m_built = true;
+	m_view_projection = view_projection;
+
+	auto size = glm::ivec2(m_width, m_height);
+
+	m_reduce_depth.bind_texture(0, depth_texture);
+	m_reduce_depth.bind_image("destination", m_texture, GL_WRITE_ONLY, GL_RG32F);
+
+	m_reduce_depth.uniform("source", 0);
+	m_reduce_depth.uniform("source_size", size);
+	m_reduce_depth.uniform("destination_size", size);
+
+	m_reduce_depth.dispatch_threads(size.x, size.y);
+
+	for (uint32_t level = 1; level < m_levels; ++level) {
+		auto source_size = size;
+		size = glm::ivec2(std::max(size.x / 2, 1), std::max(size.y / 2, 1));
+
+		ComputeGL::image_barrier();
+
+		m_reduce.bind_image("source", m_texture, GL_READ_ONLY, GL_RG32F, level - 1);
+		m_reduce.bind_image("destination", m_texture, GL_WRITE_ONLY, GL_RG32F, level);
+
+		m_reduce.uniform("source_size", source_size);
+		m_reduce.uniform("destination_size", size);
+
+		m_reduce.dispatch_threads(size.x, size.y);
+	}
+
+	// Consumers sample the pyramid or read it back
+	ComputeGL::barrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+}
+
+void HiZGL::readback()
+{
+	if (!m_built)
+		return;
+
+	uint32_t width = std::max(m_width >> m_readback_level, 1u);
+	uint32_t height = std::max(m_height >> m_readback_level, 1u);
+
+	if (m_readback_fence) {
+		auto status = glClientWaitSync(m_readback_fence, 0, 0);
+
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			return;
+
+		glDeleteSync(m_readback_fence);
+		m_readback_fence = nullptr;
+
+		std::vector<glm::vec2> depth(width * height);
+		glGetNamedBufferSubData(m_readback.id(), 0, depth.size() * sizeof(glm::vec2), depth.data());
+
+		// Only the farthest depths matter to occlusion, the CPU rebuilds the
+		// rest of the chain, it's small at this point
+		std::vector<float> farthest(depth.size());
+
+		for (size_t i = 0; i < depth.size(); ++i)
+			farthest[i] = depth[i].y;
+
+		m_cpu.build(width, height, std::move(farthest), m_readback_view_projection);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_readback.id());
+	glGetTextureImage(m_texture, m_readback_level, GL_RG, GL_FLOAT, m_readback.size(), nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_readback_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_readback_view_projection = m_view_projection;
+}
+
+bool HiZGL::occluded(const glm::vec3& min, const glm::vec3& max) const
+{
+	return m_cpu.occluded(min, max);
+}
+
+const DepthPyramid& HiZGL::cpu() const
+{
+	return m_cpu;
+}
+
+uint32_t HiZGL::texture() const
+{
+	return m_texture;
+}
+
+uint32_t HiZGL::width() const
+{
+	return m_width;
+}
+
+uint32_t HiZGL::height() const
+{
+	return m_height;
+}
+
+uint32_t HiZGL::levels() const
+{
+	return m_levels;
+}
+
+const glm::mat4& HiZGL::view_projection() const
+{
+	return m_view_projection;
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <string>
+
+#include <glad/gl.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/memory.hh"
+#include "pistacchio/gl/texture.hh"
+
+static auto _log = Log("Memory GL");
+
+std::mutex MemoryGL::s_mutex;
+std::unordered_map<uint64_t, MemoryGL::Allocation> MemoryGL::s_allocations;
+std::array<MemoryGL::Usage, MemoryGL::TYPES> MemoryGL::s_types;
+std::unordered_map<std::string, MemoryGL::Usage> MemoryGL::s_tags;
+MemoryGL::Usage MemoryGL::s_total;
+size_t MemoryGL::s_budget = 0;
+bool MemoryGL::s_over_budget = false;
+
+static const char* type_name(MemoryGL::Type type)
+{
+	switch (type) {
+	case MemoryGL::BUFFER:  return "buffer";
+	case MemoryGL::TEXTURE: return "texture";
+	default:                return "unknown";
+	}
+}
+
+static std::string megabytes(size_t bytes)
+{
+	return std::to_string(bytes / (1024 * 1024)) + "." + std::to_string(bytes % (1024 * 1024) * 10 / (1024 * 1024)) + " MiB";
+}
+
+// GL names are only unique per object type
+static uint64_t key(MemoryGL::Type type, uint32_t name)
+{
+	return (static_cast<uint64_t>(type) << 32) | name;
+}
+
+void MemoryGL::allocate(Type type, uint32_t name, size_t bytes, const std::string& tag)
+{
+	if (!name)
+		return;
+
+	release(type, name);
+
+	std::lock_guard lock(s_mutex);
+
+	s_allocations.emplace(key(type, name), Allocation{ bytes, tag });
+
+	add(s_types[type], bytes);
+	add(s_tags[tag], bytes);
+	add(s_total, bytes);
+
+	if (s_budget && s_total.bytes > s_budget && !s_over_budget) {
+		_log.warn("Over budget: " + megabytes(s_total.bytes) + " of " + megabytes(s_budget) + " after a " +
+		          megabytes(bytes) + " " + type_name(type) + " (" + tag + ")");
+		s_over_budget = true;
+	}
+}
+
+void MemoryGL::release(Type type, uint32_t name)
+{
+	std::lock_guard lock(s_mutex);
+
+	auto found = s_allocations.find(key(type, name));
+
+	if (found == s_allocations.end())
+		return;
+
+	auto& allocation = found->second;
+
+	remove(s_types[type], allocation.bytes);
+	remove(s_tags[allocation.tag], allocation.bytes);
+	remove(s_total, allocation.bytes);
+
+	s_allocations.erase(found);
+
+	if (s_budget && s_total.bytes <= s_budget)
+		s_over_budget = false;
+}
+
+void MemoryGL::tag(Type type, uint32_t name, const std::string& tag)
+{
+	std::lock_guard lock(s_mutex);
+
+	auto found = s_allocations.find(key(type, name));
+
+	if (found == s_allocations.end() || found->second.tag == tag)
+		return;
+
+	auto& allocation = found->second;
+
+	remove(s_tags[allocation.tag], allocation.bytes);
+	add(s_tags[tag], allocation.bytes);
+
+	allocation.tag = tag;
+}
+
+MemoryGL::Usage MemoryGL::usage()
+{
+	std::lock_guard lock(s_mutex);
+
+	return s_total;
+}
+
+MemoryGL::Usage MemoryGL::usage(Type type)
+{
+	std::lock_guard lock(s_mutex);
+
+	return s_types[type];
+}
+
+MemoryGL::Usage MemoryGL::usage(const std::string& tag)
+{
+	std::lock_guard lock(s_mutex);
+
+	auto found = s_tags.find(tag);
+
+	return found != s_tags.end() ? found->second : Usage{};
+}
+
+std::unordered_map<std::string, MemoryGL::Usage> MemoryGL::tags()
+{
+	std::lock_guard lock(s_mutex);
+
+	return s_tags;
+}
+
+void MemoryGL::budget(size_t bytes)
+{
+	std::lock_guard lock(s_mutex);
+
+	s_budget = bytes;
+	s_over_budget = false;
+}
+
+size_t MemoryGL::budget()
+{
+	std::lock_guard lock(s_mutex);
+
+	return s_budget;
+}
+
+uint32_t MemoryGL::leaks()
+{
+	std::lock_guard lock(s_mutex);
+
+	_log.info("Peak usage: " + megabytes(s_total.peak) + " (buffers " + megabytes(s_types[BUFFER].peak) +
+	          ", textures " + megabytes(s_types[TEXTURE].peak) + ")");
+
+	for (const auto& [id, allocation] : s_allocations) {
+		auto type = static_cast<Type>(id >> 32);
+		auto name = static_cast<uint32_t>(id);
+
+		_log.warn("Leaked " + std::string(type_name(type)) + " " + std::to_string(name) + ": " +
+		          std::to_string(allocation.bytes) + " bytes (" + allocation.tag + ")");
+	}
+
+	return s_allocations.size();
+}
+
+size_t MemoryGL::texture_size(uint32_t format, uint32_t width, uint32_t height, uint32_t levels, uint32_t depth)
+{
+	size_t texel;
+
+	switch (format) {
+	case GL_R8:
+		texel = 1;
+		break;
+	case GL_RG8:
+	case GL_R16:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		texel = 2;
+		break;
+	case GL_RG32F:
+	case GL_RGBA16:
+	case GL_RGBA16F:
+		texel = 8;
+		break;
+	case GL_RGBA32F:
+		texel = 16;
+		break;
+	default:
+		// RGBA8, SRGB8_ALPHA8, R32F, R32UI, RG16F and depth formats. RGB8 is
+		// padded to 4 bytes by every driver
+		texel = 4;
+		break;
+	}
+
+	// Block-compressed formats take `block` bytes per 4x4 texels
+	size_t block = 0;
+
+	switch (format) {
+	case TextureGL::COMPRESSED_RGBA_S3TC_DXT1:
+	case TextureGL::COMPRESSED_SRGB_ALPHA_S3TC_DXT1:
+	case GL_COMPRESSED_RED_RGTC1:
+		block = 8;
+		break;
+	case TextureGL::COMPRESSED_RGBA_S3TC_DXT5:
+	case TextureGL::COMPRESSED_SRGB_ALPHA_S3TC_DXT5:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		block = 16;
+		break;
+	}
+
+	size_t bytes = 0;
+
+	for (uint32_t level = 0; level < std::max(levels, 1u); ++level) {
+		size_t w = std::max(width >> level, 1u);
+		size_t h = std::max(height >> level, 1u);
+		size_t d = std::max(depth >> level, 1u);
+
+		if (block)
+			bytes += block * ((w + 3) / 4) * ((h + 3) / 4) * d;
+		else
+			bytes += texel * w * h * d;
+	}
+
+	return bytes;
+}
+
+void MemoryGL::add(Usage& usage, size_t bytes)
+{
+	usage.bytes += bytes;
+	usage.peak = std::max(usage.peak, usage.bytes);
+	++usage.count;
+}
+
+void MemoryGL::remove(Usage& usage, size_t bytes)
+{
+	usage.bytes -= bytes;
+	--usage.count;
+}
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <utility>
+
+#include <glad/gl.h>
+
+#include "pistacchio/gl/mesh.hh"
+#include "pistacchio/gl/render_stats.hh"
+
+//
+// Stream
+//
+
+template<class Ty>
+void MeshGL::Stream<Ty>::assign(std::vector<Ty>&& values)
+{
+	data = std::move(values);
+	begin = 0;
+	end = data.size();
+}
+
+template<class Ty>
+void MeshGL::Stream<Ty>::set(size_t index, const Ty& value)
+{
+	if (index >= data.size())
+		return;
+
+	data[index] = value;
+	touch(index, 1);
+}
+
+template<class Ty>
+void MeshGL::Stream<Ty>::touch(size_t first, size_t count)
+{
+	if (count == 0)
+		return;
+
+	if (begin >= end) {
+		begin = first;
+		end = first + count;
+	} else {
+		begin = std::min(begin, first);
+		end = std::max(end, first + count);
+	}
+
+	end = std::min(end, data.size());
+}
+
+template<class Ty>
+bool MeshGL::Stream<Ty>::dirty() const
+{
+	return begin < end;
+}
+
+template<class Ty>
+size_t MeshGL::Stream<Ty>::upload()
+{
+	if (!dirty())
+		return 0;
+
+	size_t bytes = data.size() * sizeof(Ty);
+	size_t uploaded = 0;
+
+	if (bytes > buffer.size()) {
+		// Outgrown, reallocate with the whole data
+		buffer = BufferGL(bytes, data.data(), BufferGL::DYNAMIC);
+		uploaded = bytes;
+	} else {
+		uploaded = (end - begin) * sizeof(Ty);
+		buffer.update(begin * sizeof(Ty), uploaded, data.data() + begin);
+	}
+
+	begin = end = 0;
+
+	return uploaded;
+}
+
+template struct MeshGL::Stream<glm::vec3>;
+template struct MeshGL::Stream<uint32_t>;
+
+//
+// MeshGL
+//
+
+MeshGL::MeshGL(std::vector<glm::vec3> vertices, std::vector<glm::vec3> normals, std::vector<uint32_t> indices)
+{
+	m_vertices.assign(std::move(vertices));
+	m_normals.assign(std::move(normals));
+	m_indices.assign(std::move(indices));
+}
+
+const std::vector<glm::vec3>& MeshGL::vertices() const
+{
+	return m_vertices.data;
+}
+
+const std::vector<glm::vec3>& MeshGL::normals() const
+{
+	return m_normals.data;
+}
+
+const std::vector<uint32_t>& MeshGL::indices() const
+{
+	return m_indices.data;
+}
+
+void MeshGL::vertices(std::vector<glm::vec3> values)
+{
+	m_vertices.assign(std::move(values));
+}
+
+void MeshGL::normals(std::vector<glm::vec3> values)
+{
+	m_normals.assign(std::move(values));
+}
+
+void MeshGL::indices(std::vector<uint32_t> values)
+{
+	m_indices.assign(std::move(values));
+}
+
+void MeshGL::vertex(size_t index, const glm::vec3& value)
+{
+	m_vertices.set(index, value);
+}
+
+void MeshGL::normal(size_t index, const glm::vec3& value)
+{
+	m_normals.set(index, value);
+}
+
+void MeshGL::index(size_t index, uint32_t value)
+{
+	m_indices.set(index, value);
+}
+
+glm::vec3* MeshGL::vertex_data()
+{
+	return m_vertices.data.data();
+}
+
+glm::vec3* MeshGL::normal_data()
+{
+	return m_normals.data.data();
+}
+
+uint32_t* MeshGL::index_data()
+{
+	return m_indices.data.data();
+}
+
+void MeshGL::touch_vertices(size_t first, size_t count)
+{
+	m_vertices.touch(first, count);
+}
+
+void MeshGL::touch_normals(size_t first, size_t count)
+{
+	m_normals.touch(first, count);
+}
+
+void MeshGL::touch_indices(size_t first, size_t count)
+{
+	m_indices.touch(first, count);
+}
+
+bool MeshGL::dirty() const
+{
+	return m_vertices.dirty() || m_normals.dirty() || m_indices.dirty();
+}
+
+size_t MeshGL::upload()
+{
+	return m_vertices.upload() + m_normals.upload() + m_indices.upload();
+}
+
+uint32_t MeshGL::vertex_buffer() const
+{
+	return m_vertices.buffer.id();
+}
+
+uint32_t MeshGL::normal_buffer() const
+{
+	return m_normals.buffer.id();
+}
+
+uint32_t MeshGL::index_buffer() const
+{
+	return m_indices.buffer.id();
+}
+
+void MeshGL::bind(const VertexLayout& layout, uint32_t vertex_binding, uint32_t normal_binding) const
+{
+	layout.bind_buffer(vertex_binding, vertex_buffer());
+	layout.bind_buffer(normal_binding, normal_buffer());
+	layout.bind_index_buffer(index_buffer());
+}
+
+void MeshGL::draw(uint32_t mode, uint32_t instances) const
+{
+	if (instances == 0)
+		return;
+
+	if (!m_indices.data.empty()) {
+		glDrawElementsInstanced(mode, m_indices.data.size(), GL_UNSIGNED_INT, nullptr, instances);
+		RenderStatsGL::draw(mode, m_indices.data.size(), instances);
+	} else {
+		glDrawArraysInstanced(mode, 0, m_vertices.data.size(), instances);
+		RenderStatsGL::draw(mode, m_vertices.data.size(), instances);
+	}
+}
@@ -0,0 +1,253 @@
+#include <cstdint>
+#include <string>
+
+#include <glad/gl.h>
+#include <glm/mat4x4.hpp>
+
+#include "pistacchio/input.hh"
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/picking.hh"
+#include "pistacchio/gl/memory.hh"
+#include "pistacchio/gl/state.hh"
+
+static auto _log = Log("Picking GL");
+
+static const std::string VERTEX_SOURCE = R"(#version 450 core
+
+layout(location = 0) in vec3 position;
+
+uniform mat4 view_projection;
+uniform mat4 model;
+
+void main()
+{
+	gl_Position = view_projection * model * vec4(position, 1.0);
+}
+)";
+
+static const std::string FRAGMENT_SOURCE = R"(#version 450 core
+
+uniform int object;
+
+layout(location = 0) out uint out_object;
+layout(location = 1) out uint out_primitive;
+
+void main()
+{
+	out_object = uint(object);
+	out_primitive = uint(gl_PrimitiveID);
+}
+)";
+
+PickingGL::PickingGL(uint32_t size) :
+	m_size(size | 1), // Odd, so that the cursor has a center pixel
+	m_next(0),
+	m_previous_framebuffer(0),
+	m_previous_viewport{},
+	m_x(0),
+	m_y(0),
+	m_view_projection(1.0f),
+	m_shader(ShaderGL::from_source({
+		{ ShaderGL::VERTEX, VERTEX_SOURCE },
+		{ ShaderGL::FRAGMENT, FRAGMENT_SOURCE },
+	}, {}, "picking"))
+{
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_objects);
+	glTextureStorage2D(m_objects, 1, GL_R32UI, m_size, m_size);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_primitives);
+	glTextureStorage2D(m_primitives, 1, GL_R32UI, m_size, m_size);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depth);
+	glTextureStorage2D(m_depth, 1, GL_DEPTH_COMPONENT32F, m_size, m_size);
+
+	for (auto texture : { m_objects, m_primitives, m_depth })
+		MemoryGL::allocate(MemoryGL::TEXTURE, texture, MemoryGL::texture_size(GL_R32UI, m_size, m_size), "picking");
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_objects, 0);
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT1, m_primitives, 0);
+	glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_depth, 0);
+
+	uint32_t draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(m_framebuffer, 2, draw_buffers);
+
+	if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		_log.error("Picking framebuffer is incomplete");
+
+	// Objects, primitives and depth, one after the other
+	for (auto& slot : m_slots)
+		slot.buffer = BufferGL(m_size * m_size * 3 * sizeof(uint32_t), nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+}
+
+PickingGL::~PickingGL()
+{
+	for (auto& slot : m_slots)
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+
+	for (auto texture : { m_objects, m_primitives, m_depth })
+		MemoryGL::release(MemoryGL::TEXTURE, texture);
+
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteTextures(1, &m_objects);
+	glDeleteTextures(1, &m_primitives);
+	glDeleteTextures(1, &m_depth);
+}
+
+glm::mat4 PickingGL::begin(const glm::mat4& view_projection, int width, int height)
+{
+	collect();
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previous_framebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_previous_viewport.data());
+
+	// GL window coordinates go bottom-up
+	m_x = Input::mouse_x();
+	m_y = height - 1 - Input::mouse_y();
+
+	// Maps the region around the cursor to the whole of clip space, like
+	// gluPickMatrix
+	float center_x = m_x + 0.5f;
+	float center_y = m_y + 0.5f;
+
+	glm::mat4 pick = glm::mat4(1.0f);
+	pick[0][0] = float(width) / m_size;
+	pick[1][1] = float(height) / m_size;
+	pick[3][0] = (width - 2.0f * center_x) / m_size;
+	pick[3][1] = (height - 2.0f * center_y) / m_size;
+
+	m_view_projection = pick * view_projection;
+
+	uint32_t none = 0;
+	float far = 1.0f;
+	glClearNamedFramebufferuiv(m_framebuffer, GL_COLOR, 0, &none);
+	glClearNamedFramebufferuiv(m_framebuffer, GL_COLOR, 1, &none);
+	glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &far);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_size, m_size);
+
+	return m_view_projection;
+}
+
+void PickingGL::object(uint32_t id, const glm::mat4& model)
+{
+	m_shader.wait();
+
+	if (m_shader.state() != ShaderGL::READY)
+		return;
+
+	m_shader.uniform("view_projection", m_view_projection);
+	m_shader.uniform("model", model);
+	m_shader.uniform("object", static_cast<int>(id));
+
+	StateGL::use_program(m_shader.id());
+}
+
+void PickingGL::end()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_previous_framebuffer);
+	glViewport(m_previous_viewport[0], m_previous_viewport[1], m_previous_viewport[2], m_previous_viewport[3]);
+
+	auto& slot = m_slots[m_next];
+
+	// Only happens if the GPU is several frames behind, drop the oldest
+	if (slot.fence) {
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+	}
+
+	slot.x = m_x;
+	slot.y = m_y;
+
+	uint32_t plane = m_size * m_size * sizeof(uint32_t);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer.id());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	glNamedFramebufferReadBuffer(m_framebuffer, GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, m_size, m_size, GL_RED_INTEGER, GL_UNSIGNED_INT, reinterpret_cast<void*>(0));
+	glNamedFramebufferReadBuffer(m_framebuffer, GL_COLOR_ATTACHMENT1);
+	glReadPixels(0, 0, m_size, m_size, GL_RED_INTEGER, GL_UNSIGNED_INT, reinterpret_cast<void*>(uintptr_t(plane)));
+	glReadPixels(0, 0, m_size, m_size, GL_DEPTH_COMPONENT, GL_FLOAT, reinterpret_cast<void*>(uintptr_t(2 * plane)));
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_next = (m_next + 1) % FRAMES;
+
+	collect();
+}
+
+const PickingGL::Hit& PickingGL::hovered()
+{
+	collect();
+
+	return m_hovered;
+}
+
+// Newest finished readback wins, older ones are just released
+void PickingGL::collect()
+{
+	for (uint32_t i = 0; i < FRAMES; ++i) {
+		auto& slot = m_slots[(m_next + i) % FRAMES];
+
+		if (!slot.fence)
+			continue;
+
+		auto status = glClientWaitSync(slot.fence, 0, 0);
+
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		uint32_t pixels = m_size * m_size;
+		auto data = static_cast<const uint32_t*>(glMapNamedBufferRange(slot.buffer.id(), 0, pixels * 3 * sizeof(uint32_t), GL_MAP_READ_BIT));
+
+		if (!data)
+			continue;
+
+		auto objects = data;
+		auto primitives = data + pixels;
+		auto depths = reinterpret_cast<const float*>(data + 2 * pixels);
+
+		Hit hit;
+		int center = m_size / 2;
+		int closest = INT32_MAX;
+
+		for (uint32_t y = 0; y < m_size; ++y) {
+			for (uint32_t x = 0; x < m_size; ++x) {
+				auto index = y * m_size + x;
+
+				if (!objects[index])
+					continue;
+
+				int dx = int(x) - center;
+				int dy = int(y) - center;
+				int distance = dx * dx + dy * dy;
+
+				if (distance < closest) {
+					closest = distance;
+
+					hit.valid = true;
+					hit.object = objects[index];
+					hit.primitive = primitives[index];
+					hit.depth = depths[index];
+					hit.x = slot.x + dx;
+					hit.y = slot.y + dy;
+				}
+			}
+		}
+
+		glUnmapNamedBuffer(slot.buffer.id());
+
+		m_hovered = hit;
+		Input::hovered(hit);
+	}
+}
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cassert>
+
+#include <glad/gl.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "pistacchio/gl/render_queue.hh"
+#include "pistacchio/gl/render_stats.hh"
+#include "pistacchio/gl/state.hh"
+
+// Asserts that recording into `counter`'s command buffer doesn't overlap
+// with a flush: recorders count themselves in before checking the flag, and
+// `flush` raises the flag before checking the counters.
+class RecordingCheck {
+#ifndef NDEBUG
+private:
+	std::atomic<uint32_t>& m_counter;
+public:
+	RecordingCheck(std::atomic<uint32_t>& counter, const std::atomic<bool>& flushing) :
+		m_counter(counter)
+	{
+		++m_counter;
+		assert(!flushing && "Recording into a RenderQueueGL during flush");
+	}
+
+	~RecordingCheck()
+	{
+		--m_counter;
+	}
+#else
+public:
+	RecordingCheck(std::atomic<uint32_t>&, const std::atomic<bool>&) {}
+#endif
+};
+
+//
+// RenderQueueGL::CommandBuffer
+//
+
+uint32_t RenderQueueGL::CommandBuffer::bindings(const Bindings& bindings)
+{
+	RecordingCheck check(m_recording, *m_flushing);
+
+	m_bindings.push_back(bindings);
+
+	return m_bindings.size() - 1;
+}
+
+uint32_t RenderQueueGL::CommandBuffer::model(const glm::mat4& model)
+{
+	RecordingCheck check(m_recording, *m_flushing);
+
+	m_models.push_back(model);
+
+	return m_models.size() - 1;
+}
+
+void RenderQueueGL::CommandBuffer::push(uint64_t key, const Draw& draw)
+{
+	RecordingCheck check(m_recording, *m_flushing);
+
+	m_keys.push_back(key);
+	m_draws.push_back(draw);
+}
+
+size_t RenderQueueGL::CommandBuffer::size() const
+{
+	return m_draws.size();
+}
+
+//
+// RenderQueueGL
+//
+
+RenderQueueGL::CommandBuffer& RenderQueueGL::buffer()
+{
+	std::lock_guard lock(m_mutex);
+
+	auto id = std::this_thread::get_id();
+
+	for (auto& [thread, buffer] : m_buffers)
+		if (thread == id)
+			return *buffer;
+
+	// Buffers live as long as the queue so recorders can keep the reference
+	auto& buffer = m_buffers.emplace_back(id, std::make_unique<CommandBuffer>()).second;
+	buffer->m_flushing = &m_flushing;
+
+	return *buffer;
+}
+
+uint64_t RenderQueueGL::key(uint8_t pass, uint16_t shader, uint16_t material, float depth, bool back_to_front)
+{
+	uint64_t quantized = std::clamp(depth, 0.0f, 1.0f) * 0xFFFFFF;
+
+	if (back_to_front)
+		quantized = 0xFFFFFF - quantized;
+
+	return (static_cast<uint64_t>(pass) << 56) |
+	       (static_cast<uint64_t>(shader) << 40) |
+	       (static_cast<uint64_t>(material) << 24) |
+	       quantized;
+}
+
+// LSD radix sort, a byte at a time. Bytes that are the same in every key
+// (e.g. a single pass) are skipped.
+void RenderQueueGL::sort()
+{
+	m_scratch.resize(m_entries.size());
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		std::array<uint32_t, 256> histogram = {};
+
+		for (const auto& entry : m_entries)
+			++histogram[(entry.key >> shift) & 0xFF];
+
+		if (histogram[(m_entries[0].key >> shift) & 0xFF] == m_entries.size())
+			continue;
+
+		uint32_t offset = 0;
+
+		for (auto& count : histogram) {
+			auto next = offset + count;
+			count = offset;
+			offset = next;
+		}
+
+		for (const auto& entry : m_entries)
+			m_scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+
+		m_entries.swap(m_scratch);
+	}
+}
+
+uint32_t RenderQueueGL::flush()
+{
+	std::lock_guard lock(m_mutex);
+
+	m_flushing = true;
+
+#ifndef NDEBUG
+	for (const auto& [thread, buffer] : m_buffers)
+		assert(buffer->m_recording == 0 && "RenderQueueGL flushed while a thread is still recording");
+#endif
+
+	m_entries.clear();
+
+	for (uint32_t b = 0; b < m_buffers.size(); ++b) {
+		const auto& buffer = *m_buffers[b].second;
+
+		for (uint32_t d = 0; d < buffer.m_draws.size(); ++d)
+			m_entries.push_back(Entry{ buffer.m_keys[d], b, d });
+	}
+
+	if (!m_entries.empty()) {
+		sort();
+		replay();
+	}
+
+	for (auto& [thread, buffer] : m_buffers) {
+		buffer->m_keys.clear();
+		buffer->m_draws.clear();
+		buffer->m_bindings.clear();
+		buffer->m_models.clear();
+	}
+
+	m_flushing = false;
+
+	return m_entries.size();
+}
+
+void RenderQueueGL::replay()
+{
+	// Vertex and index buffers attached to the current VAO, by binding. Only
+	// known within this flush.
+
+	uint32_t vao = 0;
+	std::array<VertexBuffer, 16> vertex_buffers = {};
+	uint32_t index_buffer = 0;
+
+	for (const auto& entry : m_entries) {
+		const auto& buffer = *m_buffers[entry.buffer].second;
+		const auto& draw = buffer.m_draws[entry.draw];
+
+		StateGL::use_program(draw.program);
+		StateGL::bind_vertex_array(draw.vao);
+
+		if (draw.vao != vao) {
+			vao = draw.vao;
+			vertex_buffers = {};
+			index_buffer = 0;
+		}
+
+		if (draw.bindings != NONE) {
+			const auto& bindings = buffer.m_bindings[draw.bindings];
+
+			for (const auto& vb : bindings.vertex_buffers) {
+				if (!vb.buffer)
+					continue;
+
+				if (vb.binding >= vertex_buffers.size()) {
+					glVertexArrayVertexBuffer(vao, vb.binding, vb.buffer, vb.offset, vb.stride);
+					continue;
+				}
+
+				auto& bound = vertex_buffers[vb.binding];
+
+				if (vb.buffer != bound.buffer || vb.offset != bound.offset || vb.stride != bound.stride) {
+					glVertexArrayVertexBuffer(vao, vb.binding, vb.buffer, vb.offset, vb.stride);
+					bound = vb;
+				}
+			}
+
+			for (const auto& texture : bindings.textures)
+				if (texture.texture)
+					StateGL::bind_texture(texture.unit, texture.texture);
+		}
+
+		if (draw.index_buffer && draw.index_buffer != index_buffer) {
+			glVertexArrayElementBuffer(vao, draw.index_buffer);
+			index_buffer = draw.index_buffer;
+		}
+
+		if (draw.model != NONE && draw.model_location >= 0) {
+			glProgramUniformMatrix4fv(draw.program, draw.model_location, 1, GL_FALSE, glm::value_ptr(buffer.m_models[draw.model]));
+			RenderStatsGL::uniform();
+		}
+
+		if (draw.index_buffer)
+			glDrawElementsInstancedBaseVertex(draw.mode, draw.count, GL_UNSIGNED_INT,
+				reinterpret_cast<const void*>(static_cast<uintptr_t>(draw.first) * sizeof(uint32_t)),
+				draw.instances, draw.base_vertex);
+		else
+			glDrawArraysInstanced(draw.mode, draw.first, draw.count, draw.instances);
+
+		RenderStatsGL::draw(draw.mode, draw.count, draw.instances);
+	}
+}
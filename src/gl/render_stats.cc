@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <utility>
+
+#include <glad/gl.h>
+
+#include "pistacchio/gl/render_stats.hh"
+#include "pistacchio/gl/state.hh"
+
+std::mutex RenderStatsGL::s_mutex;
+std::vector<RenderStatsGL::Counters*> RenderStatsGL::s_threads;
+uint64_t RenderStatsGL::s_retired[COUNTERS] = {};
+RenderStatsGL::Stats RenderStatsGL::s_last_frame;
+
+RenderStatsGL::Counters::Counters()
+{
+	std::lock_guard lock(s_mutex);
+
+	s_threads.push_back(this);
+}
+
+// Counts of a thread that ends mid-frame still make it into that frame
+RenderStatsGL::Counters::~Counters()
+{
+	std::lock_guard lock(s_mutex);
+
+	for (uint32_t i = 0; i < COUNTERS; ++i)
+		s_retired[i] += values[i].load(std::memory_order_relaxed);
+
+	s_threads.erase(std::find(s_threads.begin(), s_threads.end(), this));
+}
+
+void RenderStatsGL::draw(uint32_t mode, uint32_t count, uint32_t instances)
+{
+	add(DRAWS, 1);
+	add(INSTANCES, instances);
+	add(PRIMITIVES, primitives(mode, count) * instances);
+}
+
+void RenderStatsGL::draw_indirect(uint32_t draws)
+{
+	add(DRAWS, draws);
+}
+
+void RenderStatsGL::program_bind()
+{
+	add(PROGRAM_BINDS, 1);
+}
+
+void RenderStatsGL::vao_bind()
+{
+	add(VAO_BINDS, 1);
+}
+
+void RenderStatsGL::texture_bind()
+{
+	add(TEXTURE_BINDS, 1);
+}
+
+void RenderStatsGL::uniform()
+{
+	add(UNIFORMS, 1);
+}
+
+void RenderStatsGL::buffer_upload(uint64_t bytes)
+{
+	add(BUFFER_UPLOAD_BYTES, bytes);
+}
+
+void RenderStatsGL::texture_upload(uint64_t bytes)
+{
+	add(TEXTURE_UPLOAD_BYTES, bytes);
+}
+
+void RenderStatsGL::new_frame()
+{
+	uint64_t totals[COUNTERS];
+
+	{
+		std::lock_guard lock(s_mutex);
+
+		for (uint32_t i = 0; i < COUNTERS; ++i) {
+			totals[i] = std::exchange(s_retired[i], 0);
+
+			for (auto counters : s_threads)
+				totals[i] += counters->values[i].exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	StateGL::new_frame();
+	auto state = StateGL::stats();
+
+	s_last_frame = Stats{
+		.draws = totals[DRAWS],
+		.instances = totals[INSTANCES],
+		.primitives = totals[PRIMITIVES],
+		.program_binds = totals[PROGRAM_BINDS],
+		.vao_binds = totals[VAO_BINDS],
+		.texture_binds = totals[TEXTURE_BINDS],
+		.uniforms = totals[UNIFORMS],
+		.buffer_upload_bytes = totals[BUFFER_UPLOAD_BYTES],
+		.texture_upload_bytes = totals[TEXTURE_UPLOAD_BYTES],
+		.state_issued = state.issued,
+		.state_elided = state.elided,
+	};
+}
+
+RenderStatsGL::Stats RenderStatsGL::stats()
+{
+	return s_last_frame;
+}
+
+uint64_t RenderStatsGL::primitives(uint32_t mode, uint32_t count)
+{
+	switch (mode) {
+	case GL_POINTS:
+		return count;
+	case GL_LINES:
+		return count / 2;
+	case GL_LINE_STRIP:
+		return count > 0 ? count - 1 : 0;
+	case GL_LINE_LOOP:
+		return count;
+	case GL_TRIANGLE_STRIP:
+	case GL_TRIANGLE_FAN:
+		return count > 2 ? count - 2 : 0;
+	default:
+		return count / 3;
+	}
+}
+
+RenderStatsGL::Counters& RenderStatsGL::local()
+{
+	thread_local Counters counters;
+
+	return counters;
+}
+
+// Uncontended, a relaxed add on a cache line no other thread writes
+void RenderStatsGL::add(Counter counter, uint64_t value)
+{
+	local().values[counter].fetch_add(value, std::memory_order_relaxed);
+}
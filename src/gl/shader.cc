@@ -1,17 +1,40 @@
+#include <algorithm>
 #include <array>
 #include <fstream>
+#include <memory>
 #include <sstream>
 
 #include <glad/gl.h>
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <SDL.h>
 #include <string>
 
+#include "pistacchio/gl/render_stats.hh"
 #include "pistacchio/gl/shader.hh"
+#include "pistacchio/gl/state.hh"
 #include "pistacchio/log.hh"
 
+// GL_KHR_parallel_shader_compile is not part of the generated glad loader. The
+// ARB version of the extension shares the same enums.
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (GLAD_API_PTR *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
 static auto _log = Log("Shader GL");
 
+// Virtual files registered with `ShaderGL::include`, by name. Function-local
+// so that other translation units can register files during static
+// initialization.
+static std::unordered_map<std::string, std::string>& includes()
+{
+	static std::unordered_map<std::string, std::string> s_includes;
+
+	return s_includes;
+}
+
 int32_t status(uint32_t shader)
 {
 	int32_t status;
@@ -21,60 +44,376 @@ int32_t status(uint32_t shader)
 	return status;
 }
 
-ShaderGL::ShaderGL(const std::unordered_map<uint32_t, std::string>& shaders) :
-	m_last_binding_index(0)
+std::string directory(const std::string& path)
 {
-	uint32_t program = glCreateProgram();
+	auto separator = path.find_last_of("/\\");
 
-	uint32_t vao = 0;
-	glCreateVertexArrays(1, &vao);
+	if (separator == std::string::npos)
+		return "";
 
-	for (const auto& [stage, path] : shaders) {
-		uint32_t shader = glCreateShader(stage);
+	return path.substr(0, separator + 1);
+}
 
-		std::ifstream file(path);
+// Returns true if `line` is the preprocessor directive `directive`, ignoring
+// leading whitespace.
+bool is_directive(const std::string& line, const std::string& directive)
+{
+	auto first = line.find_first_not_of(" \t");
 
-		if (!file.is_open())
-			_log.warn("Unable to open " + path);
+	return first != std::string::npos && line.compare(first, directive.length(), directive) == 0;
+}
 
-		std::stringstream buffer;
+void preprocess_file(const std::string& path, const std::string& defines, std::vector<std::string>& files, std::string& output)
+{
+	std::unique_ptr<std::istream> file;
 
-		buffer << file.rdbuf();
+	if (auto it = includes().find(path); it != includes().end())
+		file = std::make_unique<std::istringstream>(it->second);
+	else
+		file = std::make_unique<std::ifstream>(path);
 
-		std::string source_str(buffer.str());
-		const char* source = source_str.c_str();
+	if (!*file) {
+		_log.warn("Unable to open " + path);
+		return;
+	}
 
-		glShaderSource(shader, 1, &source, nullptr);
+	auto index = std::to_string(files.size());
+	bool root = files.empty();
 
-		glCompileShader(shader);
+	files.push_back(path);
 
-		if (status(shader)) {
-			glAttachShader(program, shader);
-			glDeleteShader(shader);
+	if (!root)
+		output += "#line 1 " + index + "\n";
+
+	std::string line;
+	uint32_t number = 0;
+
+	while (std::getline(*file, line)) {
+		++number;
+
+		if (is_directive(line, "#version")) {
+			// Defines must come after `#version`, which in turn must be
+			// the first thing in the source.
+			if (root)
+				output += line + "\n" + defines + "#line " + std::to_string(number + 1) + " " + index + "\n";
+			else
+				output += "\n";
+		} else if (is_directive(line, "#include")) {
+			auto open = line.find_first_of("\"<");
+			auto close = (open == std::string::npos) ? open : line.find_first_of("\">", open + 1);
+
+			if (close == std::string::npos) {
+				_log.warn(path + ":" + std::to_string(number) + ": Malformed #include");
+				output += "\n";
+				continue;
+			}
+
+			auto include = line.substr(open + 1, close - open - 1);
+
+			if (!includes().contains(include))
+				include = directory(path) + include;
+
+			if (std::find(files.begin(), files.end(), include) == files.end()) {
+				preprocess_file(include, defines, files, output);
+				output += "#line " + std::to_string(number + 1) + " " + index + "\n";
+			} else {
+				output += "\n";
+			}
 		} else {
+			output += line + "\n";
+		}
+	}
+}
+
+std::string define_lines(const std::vector<std::string>& defines)
+{
+	std::string output;
+
+	for (const auto& define : defines) {
+		auto separator = define.find('=');
+
+		if (separator == std::string::npos)
+			output += "#define " + define + "\n";
+		else
+			output += "#define " + define.substr(0, separator) + " " + define.substr(separator + 1) + "\n";
+	}
+
+	return output;
+}
+
+std::string ShaderGL::preprocess(const std::string& path, const std::vector<std::string>& defines, std::vector<std::string>* files)
+{
+	std::vector<std::string> included;
+	std::string output;
+
+	preprocess_file(path, define_lines(defines), included, output);
+
+	if (files)
+		*files = included;
+
+	return output;
+}
+
+void ShaderGL::include(const std::string& name, const std::string& source)
+{
+	includes()[name] = source;
+}
+
+bool ShaderGL::parallel_compile()
+{
+	static int supported = -1;
+
+	if (supported != -1)
+		return supported;
+
+	const char* function = nullptr;
+
+	if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile"))
+		function = "glMaxShaderCompilerThreadsKHR";
+	else if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile"))
+		function = "glMaxShaderCompilerThreadsARB";
+
+	auto max_threads = function ?
+		reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(SDL_GL_GetProcAddress(function)) :
+		nullptr;
+
+	// 0xFFFFFFFF lets the driver pick as many threads as it wants
+	if (max_threads)
+		max_threads(0xFFFFFFFF);
+
+	supported = (max_threads != nullptr);
+
+	_log.debug("Parallel shader compilation: " + std::string(supported ? "yes" : "no"));
+
+	return supported;
+}
+
+ShaderGL::ShaderGL() :
+	m_state(COMPILING),
+	m_prewarmed(false)
+{
+	parallel_compile();
+
+	m_name = glCreateProgram();
+}
+
+ShaderGL::ShaderGL(const std::unordered_map<uint32_t, std::string>& shaders, const std::vector<std::string>& defines) :
+	ShaderGL()
+{
+	// Submit every stage and the link without querying anything, so that
+	// the driver is free to do the work in the background.
+
+	for (const auto& [stage, path] : shaders) {
+		std::vector<std::string> files;
+		std::string source = preprocess(path, defines, &files);
+
+		submit(stage, path, source, files);
+	}
+
+	glLinkProgram(m_name);
+}
+
+ShaderGL ShaderGL::from_source(const std::unordered_map<uint32_t, std::string>& sources, const std::vector<std::string>& defines, const std::string& name)
+{
+	ShaderGL shader;
+
+	for (const auto& [stage, source] : sources) {
+		std::string output = source;
+
+		// Same as `preprocess`: defines go right after `#version`
+		auto version = output.find("#version");
+		auto end = (version == std::string::npos) ? version : output.find('\n', version);
+
+		if (end != std::string::npos) {
+			auto line = std::count(output.begin(), output.begin() + end, '\n') + 2;
+			output.insert(end + 1, define_lines(defines) + "#line " + std::to_string(line) + "\n");
+		}
+
+		shader.submit(stage, name, output, { name });
+	}
+
+	glLinkProgram(shader.m_name);
+
+	return shader;
+}
+
+uint32_t ShaderGL::id() const
+{
+	return m_name;
+}
+
+VertexLayout ShaderGL::layout(const std::vector<std::string>& per_instance) const
+{
+	VertexLayout result;
+
+	for (const auto& [name, attribute] : m_attributes) {
+		auto attributes = VertexLayout::format(attribute.type, attribute.location, attribute.location);
+		bool instanced = std::find(per_instance.begin(), per_instance.end(), name) != per_instance.end();
+
+		result.attributes.insert(result.attributes.end(), attributes.begin(), attributes.end());
+		result.bindings.push_back(VertexLayout::Binding{
+			.index = attribute.location,
+			.stride = VertexLayout::size(attribute.type),
+			.divisor = instanced ? 1u : 0u
+		});
+	}
+
+	// Iteration order of `m_attributes` is unspecified, sort so that equal
+	// layouts hash the same.
+
+	std::sort(result.attributes.begin(), result.attributes.end(), [](const auto& a, const auto& b) {
+		return a.location < b.location;
+	});
+
+	std::sort(result.bindings.begin(), result.bindings.end(), [](const auto& a, const auto& b) {
+		return a.index < b.index;
+	});
+
+	return result;
+}
+
+uint32_t ShaderGL::vao() const
+{
+	return layout().vao();
+}
+
+ShaderGL::State ShaderGL::state() const
+{
+	return m_state;
+}
+
+ShaderGL::AttributesMap ShaderGL::attributes() const
+{
+	return m_attributes;
+}
+
+ShaderGL::UniformsMap ShaderGL::uniforms() const
+{
+	return m_uniforms;
+}
+
+bool ShaderGL::ready()
+{
+	if (m_state != COMPILING)
+		return m_state == READY;
+
+	if (parallel_compile()) {
+		int32_t completed = GL_FALSE;
+		glGetProgramiv(m_name, GL_COMPLETION_STATUS_KHR, &completed);
+
+		if (!completed)
+			return false;
+	}
+
+	link();
+
+	return m_state == READY;
+}
+
+void ShaderGL::wait()
+{
+	if (m_state == COMPILING)
+		link();
+}
+
+void ShaderGL::prewarm()
+{
+	static uint32_t empty_vao = 0;
+
+	wait();
+
+	if (m_prewarmed || m_state != READY)
+		return;
+
+	// No attributes are enabled on `empty_vao` so every vertex reads the same
+	// constant value, the triangle has no area and nothing gets rasterized.
+
+	if (!empty_vao)
+		glCreateVertexArrays(1, &empty_vao);
+
+	StateGL::use_program(m_name);
+	StateGL::bind_vertex_array(empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	m_prewarmed = true;
+}
+
+void ShaderGL::submit(uint32_t type, const std::string& path, const std::string& source, const std::vector<std::string>& files)
+{
+	uint32_t shader = glCreateShader(type);
+	const char* source_ptr = source.c_str();
+
+	glShaderSource(shader, 1, &source_ptr, nullptr);
+
+	glCompileShader(shader);
+	glAttachShader(m_name, shader);
+
+	m_stages.push_back(Stage{
+		.name = shader,
+		.path = path,
+		.files = files
+	});
+}
+
+void ShaderGL::link()
+{
+	int32_t linked = GL_FALSE;
+	glGetProgramiv(m_name, GL_LINK_STATUS, &linked);
+
+	for (const auto& stage : m_stages) {
+		if (!status(stage.name)) {
 			int32_t error_length;
 
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &error_length);
+			glGetShaderiv(stage.name, GL_INFO_LOG_LENGTH, &error_length);
 
 			std::string error;
 			error.resize(error_length);
 
-			glGetShaderInfoLog(shader, error_length, nullptr, error.data());
+			glGetShaderInfoLog(stage.name, error_length, nullptr, error.data());
 
-			_log.warn("Unable to compile shader " + path);
+			_log.warn("Unable to compile shader " + stage.path);
 
-			printf("\n\t");
-			for (auto c : error) {
-				if (c == '\n')
-					printf("\n\t");
-				else
-					printf("%c", c);
-			}
-			printf("\n");
+			for (uint32_t i = 1; i < stage.files.size(); ++i)
+				_log.warn("  " + std::to_string(i) + ": " + stage.files[i]);
+
+			// c_str() stops at the log's terminating null
+			std::istringstream lines(error.c_str());
+
+			for (std::string line; std::getline(lines, line);)
+				if (!line.empty())
+					_log.warn("    " + line);
 		}
+
+		glDetachShader(m_name, stage.name);
+		glDeleteShader(stage.name);
+	}
+
+	m_stages.clear();
+
+	if (!linked) {
+		int32_t error_length;
+
+		glGetProgramiv(m_name, GL_INFO_LOG_LENGTH, &error_length);
+
+		std::string error;
+		error.resize(error_length);
+
+		glGetProgramInfoLog(m_name, error_length, nullptr, error.data());
+
+		_log.warn("Unable to link program: " + error);
+
+		m_state = FAILED;
+		return;
 	}
 
-	glLinkProgram(program);
+	reflect();
+
+	m_state = READY;
+}
+
+void ShaderGL::reflect()
+{
+	uint32_t program = m_name;
 
 	int32_t attribute_count = 0;
 	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attribute_count);
@@ -93,16 +432,18 @@ ShaderGL::ShaderGL(const std::unordered_map<uint32_t, std::string>& shaders) :
 			glGetActiveAttrib(program, i, max_length, &length, &size, &type, name.data());
 			name.resize(length);
 
-			uint32_t location = glGetAttribLocation(program, name.c_str());
+			int32_t location = glGetAttribLocation(program, name.c_str());
+
+			// Built-ins like gl_VertexID have no location
+			if (location < 0)
+				continue;
 
 			m_attributes.emplace(name, Attribute{
 				.size = size,
 				.type = type,
 				.name = name,
-				.location = location
+				.location = static_cast<uint32_t>(location)
 			});
-
-			glEnableVertexArrayAttrib(vao, i);
 		}
 	}
 
@@ -127,29 +468,6 @@ ShaderGL::ShaderGL(const std::unordered_map<uint32_t, std::string>& shaders) :
 			m_uniforms.emplace(name, location);
 		}
 	}
-
-	m_name = program;
-	m_vao = vao;
-}
-
-uint32_t ShaderGL::id() const
-{
-	return m_name;
-}
-
-uint32_t ShaderGL::vao() const
-{
-	return m_vao;
-}
-
-ShaderGL::AttributesMap ShaderGL::attributes() const
-{
-	return m_attributes;
-}
-
-ShaderGL::UniformsMap ShaderGL::uniforms() const
-{
-	return m_uniforms;
 }
 
 template<>
@@ -159,6 +477,7 @@ void ShaderGL::uniform(const char* uniform, const int& value)
 		return;
 
 	glProgramUniform1i(m_name, m_uniforms[uniform], value);
+	RenderStatsGL::uniform();
 }
 
 template<>
@@ -168,6 +487,7 @@ void ShaderGL::uniform(const char* uniform, const bool& value)
 		return;
 
 	glProgramUniform1i(m_name, m_uniforms[uniform], value);
+	RenderStatsGL::uniform();
 }
 
 template<>
@@ -177,6 +497,7 @@ void ShaderGL::uniform(const char* uniform, const float& value)
 		return;
 
 	glProgramUniform1f(m_name, m_uniforms[uniform], value);
+	RenderStatsGL::uniform();
 }
 
 
@@ -187,64 +508,47 @@ void ShaderGL::uniform(const char* uniform, const std::array<float, 4>& value)
 		return;
 
 	glProgramUniform4fv(m_name, m_uniforms[uniform], 1, value.data());
+	RenderStatsGL::uniform();
 }
 
 template<>
-void ShaderGL::uniform(const char* uniform, const glm::vec3& value)
+void ShaderGL::uniform(const char* uniform, const glm::vec2& value)
 {
-	if (!m_uniforms.contains(uniform)) {
+	if (!m_uniforms.contains(uniform))
 		return;
-	}
 
-	glProgramUniform3fv(m_name, m_uniforms[uniform], 1, glm::value_ptr(value));
+	glProgramUniform2fv(m_name, m_uniforms[uniform], 1, glm::value_ptr(value));
+	RenderStatsGL::uniform();
 }
 
 template<>
-void ShaderGL::uniform(const char* uniform, const glm::mat4& value)
+void ShaderGL::uniform(const char* uniform, const glm::ivec2& value)
 {
-	if (!m_uniforms.contains(uniform)) {
+	if (!m_uniforms.contains(uniform))
 		return;
-	}
-
-	glProgramUniformMatrix4fv(m_name, m_uniforms[uniform], 1, GL_FALSE, glm::value_ptr(value));
-}
 
-void ShaderGL::bind_buffer(uint32_t binding_point, uint32_t vbo, void *offset, uint32_t stride)
-{
-	glVertexArrayVertexBuffer(m_vao, binding_point, vbo, (GLintptr)offset, stride);
+	glProgramUniform2iv(m_name, m_uniforms[uniform], 1, glm::value_ptr(value));
+	RenderStatsGL::uniform();
 }
 
-void ShaderGL::bind_attribute(const char *attribute, uint32_t binding_point)
+template<>
+void ShaderGL::uniform(const char* uniform, const glm::vec3& value)
 {
-	if (!m_attributes.contains(attribute))
+	if (!m_uniforms.contains(uniform)) {
 		return;
+	}
 
-	glVertexArrayAttribBinding(m_vao, m_attributes[attribute].location, binding_point);
+	glProgramUniform3fv(m_name, m_uniforms[uniform], 1, glm::value_ptr(value));
+	RenderStatsGL::uniform();
 }
 
-void ShaderGL::attribute_format(const char *attribute, uint32_t offset)
+template<>
+void ShaderGL::uniform(const char* uniform, const glm::mat4& value)
 {
-	uint32_t type = 0;
-	uint32_t size = 0;
-
-	auto attr = m_attributes[attribute];
-
-	switch (m_attributes[attribute].type) {
-	case GL_FLOAT_VEC2:
-		type = GL_FLOAT;
-		size = 2;
-		break;
-	case GL_FLOAT_VEC3:
-		type = GL_FLOAT;
-		size = 3;
-		break;
-	case GL_FLOAT_VEC4:
-		type = GL_FLOAT;
-		size = 4;
-		break;
-	default:
-		_log.debug("Attribute " + std::string(attribute) + ": Unknown type " + std::to_string(attr.type));
+	if (!m_uniforms.contains(uniform)) {
+		return;
 	}
 
-	glVertexArrayAttribFormat(m_vao, m_attributes[attribute].location, size, type, GL_FALSE, offset);
+	glProgramUniformMatrix4fv(m_name, m_uniforms[uniform], 1, GL_FALSE, glm::value_ptr(value));
+	RenderStatsGL::uniform();
 }
@@ -0,0 +1,45 @@
+#include <memory>
+
+#include "pistacchio/gl/shader_variants.hh"
+#include "pistacchio/log.hh"
+
+static auto _log = Log("Shader Variants GL");
+
+ShaderVariantsGL::ShaderVariantsGL(const std::unordered_map<uint32_t, std::string>& shaders, const std::vector<std::string>& features) :
+	m_shaders(shaders),
+	m_features(features)
+{
+	if (m_features.size() > 32)
+		_log.warn("Only the first 32 of " + std::to_string(m_features.size()) + " features can be selected");
+}
+
+ShaderGL& ShaderVariantsGL::get(uint32_t mask)
+{
+	auto it = m_variants.find(mask);
+
+	if (it == m_variants.end())
+		it = m_variants.emplace(mask, std::make_unique<ShaderGL>(m_shaders, defines(mask))).first;
+
+	return *it->second;
+}
+
+void ShaderVariantsGL::prepare(uint32_t mask)
+{
+	get(mask);
+}
+
+std::vector<std::string> ShaderVariantsGL::defines(uint32_t mask) const
+{
+	std::vector<std::string> result;
+
+	for (uint32_t i = 0; i < m_features.size() && i < 32; ++i)
+		if (mask & (1u << i))
+			result.push_back(m_features[i]);
+
+	return result;
+}
+
+size_t ShaderVariantsGL::size() const
+{
+	return m_variants.size();
+}
@@ -0,0 +1,159 @@
+#include <glad/gl.h>
+
+#include "pistacchio/gl/render_stats.hh"
+#include "pistacchio/gl/state.hh"
+
+StateGL::State StateGL::s_state = StateGL::unknown();
+
+StateGL::Stats StateGL::s_frame;
+StateGL::Stats StateGL::s_last_frame;
+
+void toggle(uint32_t capability, bool enabled)
+{
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+bool StateGL::change(uint32_t& current, uint32_t value)
+{
+	if (current == value) {
+		++s_frame.elided;
+		return false;
+	}
+
+	current = value;
+	++s_frame.issued;
+
+	return true;
+}
+
+void StateGL::use_program(uint32_t program)
+{
+	if (change(s_state.program, program)) {
+		glUseProgram(program);
+		RenderStatsGL::program_bind();
+	}
+}
+
+void StateGL::bind_vertex_array(uint32_t vao)
+{
+	if (change(s_state.vao, vao)) {
+		glBindVertexArray(vao);
+		RenderStatsGL::vao_bind();
+	}
+}
+
+void StateGL::bind_texture(uint32_t unit, uint32_t texture)
+{
+	// Units past the shadowed range are always forwarded
+	if (unit >= TEXTURE_UNITS) {
+		++s_frame.issued;
+		glBindTextureUnit(unit, texture);
+		RenderStatsGL::texture_bind();
+		return;
+	}
+
+	if (change(s_state.textures[unit], texture)) {
+		glBindTextureUnit(unit, texture);
+		RenderStatsGL::texture_bind();
+	}
+}
+
+void StateGL::blend(bool enabled)
+{
+	if (change(s_state.blend, enabled))
+		toggle(GL_BLEND, enabled);
+}
+
+void StateGL::blend_func(uint32_t source, uint32_t destination)
+{
+	bool source_changed = (s_state.blend_source != source);
+	bool destination_changed = (s_state.blend_destination != destination);
+
+	if (!source_changed && !destination_changed) {
+		++s_frame.elided;
+		return;
+	}
+
+	s_state.blend_source = source;
+	s_state.blend_destination = destination;
+	++s_frame.issued;
+
+	glBlendFunc(source, destination);
+}
+
+void StateGL::depth_test(bool enabled)
+{
+	if (change(s_state.depth_test, enabled))
+		toggle(GL_DEPTH_TEST, enabled);
+}
+
+void StateGL::depth_func(uint32_t func)
+{
+	if (change(s_state.depth_func, func))
+		glDepthFunc(func);
+}
+
+void StateGL::depth_mask(bool enabled)
+{
+	if (change(s_state.depth_mask, enabled))
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void StateGL::cull_face(bool enabled)
+{
+	if (change(s_state.cull_face, enabled))
+		toggle(GL_CULL_FACE, enabled);
+}
+
+void StateGL::cull_mode(uint32_t mode)
+{
+	if (change(s_state.cull_mode, mode))
+		glCullFace(mode);
+}
+
+void StateGL::polygon_mode(uint32_t mode)
+{
+	if (change(s_state.polygon_mode, mode))
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+StateGL::State StateGL::unknown()
+{
+	State state = {
+		.program = UNKNOWN,
+		.vao = UNKNOWN,
+		.textures = {},
+		.blend = UNKNOWN,
+		.blend_source = UNKNOWN,
+		.blend_destination = UNKNOWN,
+		.depth_test = UNKNOWN,
+		.depth_func = UNKNOWN,
+		.depth_mask = UNKNOWN,
+		.cull_face = UNKNOWN,
+		.cull_mode = UNKNOWN,
+		.polygon_mode = UNKNOWN,
+	};
+
+	state.textures.fill(UNKNOWN);
+
+	return state;
+}
+
+void StateGL::invalidate()
+{
+	s_state = unknown();
+}
+
+void StateGL::new_frame()
+{
+	s_last_frame = s_frame;
+	s_frame = Stats{};
+}
+
+StateGL::Stats StateGL::stats()
+{
+	return s_last_frame;
+}
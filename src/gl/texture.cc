@@ -1,49 +1,319 @@
+#include <algorithm>
+#include <cctype>
 #include <stdint.h>
+#include <unordered_map>
+#include <utility>
 #define STB_IMAGE_IMPLEMENTATION
 #include <glad/gl.h>
 #include <stb_image.h>
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/memory.hh"
+#include "pistacchio/gl/render_stats.hh"
 #include "pistacchio/gl/texture.hh"
 
+static auto _log = Log("Texture GL");
+
+// Internal format for an image of `channels` (3 is loaded as 4)
+static uint32_t internal_format(int channels, bool is_16_bit, bool is_hdr, bool srgb)
+{
+	if (is_hdr) {
+		switch (channels) {
+		case 1:  return GL_R16F;
+		case 2:  return GL_RG16F;
+		default: return GL_RGBA16F;
+		}
+	}
+
+	if (is_16_bit) {
+		switch (channels) {
+		case 1:  return GL_R16;
+		case 2:  return GL_RG16;
+		default: return GL_RGBA16;
+		}
+	}
+
+	switch (channels) {
+	case 1:  return GL_R8;
+	case 2:  return GL_RG8;
+	default: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	}
+}
+
+// Internal format of a block-compressed image
+static uint32_t internal_format(CompressedImage::Format format, bool srgb)
+{
+	switch (format) {
+	case CompressedImage::BC1: return srgb ? TextureGL::COMPRESSED_SRGB_ALPHA_S3TC_DXT1 : TextureGL::COMPRESSED_RGBA_S3TC_DXT1;
+	case CompressedImage::BC3: return srgb ? TextureGL::COMPRESSED_SRGB_ALPHA_S3TC_DXT5 : TextureGL::COMPRESSED_RGBA_S3TC_DXT5;
+	case CompressedImage::BC4: return GL_COMPRESSED_RED_RGTC1;
+	case CompressedImage::BC5: return GL_COMPRESSED_RG_RGTC2;
+	case CompressedImage::BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default:                   return 0;
+	}
+}
+
+static bool is_compressed(const std::string& path)
+{
+	auto extension = path.substr(std::min(path.rfind('.'), path.size()));
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+	return extension == ".dds" || extension == ".ktx2";
+}
+
+// Min filter without its mipmap part, for single-level textures
+static uint32_t base_filter(uint32_t filter)
+{
+	switch (filter) {
+	case GL_NEAREST_MIPMAP_NEAREST:
+	case GL_NEAREST_MIPMAP_LINEAR:
+		return GL_NEAREST;
+	case GL_LINEAR_MIPMAP_NEAREST:
+	case GL_LINEAR_MIPMAP_LINEAR:
+		return GL_LINEAR;
+	default:
+		return filter;
+	}
+}
+
 // This creates an invalid texture
-TextureGL::TextureGL() : m_name(0), m_width(0), m_height(0)
+TextureGL::TextureGL() : m_name(0), m_width(0), m_height(0), m_format(0), m_levels(0)
 {}
 
-TextureGL::TextureGL(const std::string& path)
+TextureGL::TextureGL(const std::string& path, bool srgb, bool mipmaps) :
+	TextureGL()
 {
+	if (is_compressed(path)) {
+		auto image = CompressedImage::load(path);
+
+		if (image.valid())
+			create(image, srgb);
+
+		return;
+	}
+
 	int width = 0;
 	int height = 0;
 	int channels = 0;
-	int desired_channels = 0;
 
-	uint8_t* data = stbi_load(path.c_str(), &width, &height, &channels, desired_channels);
+	if (!stbi_info(path.c_str(), &width, &height, &channels)) {
+		_log.warn("Unable to load " + path + ": " + stbi_failure_reason());
+		return;
+	}
 
-	if (data) {
-		glCreateTextures(GL_TEXTURE_2D, 1, &m_name);
+	bool is_hdr = stbi_is_hdr(path.c_str());
+	bool is_16_bit = !is_hdr && stbi_is_16_bit(path.c_str());
 
-		glTextureParameteri(m_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTextureParameteri(m_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// RGB has no 3-byte texel in practice, ask stb for the padding
+	int desired_channels = (channels == 3) ? 4 : channels;
+	void* data;
 
-		glTextureStorage2D(m_name, 1, GL_RGBA8, width, height);
-		glTextureSubImage2D(m_name, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	if (is_hdr)
+		data = stbi_loadf(path.c_str(), &width, &height, &channels, desired_channels);
+	else if (is_16_bit)
+		data = stbi_load_16(path.c_str(), &width, &height, &channels, desired_channels);
+	else
+		data = stbi_load(path.c_str(), &width, &height, &channels, desired_channels);
+
+	if (!data) {
+		_log.warn("Unable to load " + path + ": " + stbi_failure_reason());
+		return;
 	}
 
-	m_width = width;
-	m_height = height;
+	auto format = internal_format(desired_channels, is_16_bit, is_hdr, srgb);
+
+	if (!mipmaps) {
+		create(data, width, height, format);
+	} else if (!is_hdr && !is_16_bit) {
+		auto mips = MipChain::generate(static_cast<uint8_t*>(data), width, height, desired_channels, MipChain::KAISER, srgb);
+		create(data, width, height, format, 1 + mips.size());
+		upload(mips);
+	} else {
+		create(data, width, height, format, MipChain::levels(width, height));
+		generate_mipmaps();
+	}
 
 	stbi_image_free(data);
 }
 
 TextureGL::TextureGL(uint8_t* data, int width, int height) :
-	m_width(width),
-	m_height(height)
+	TextureGL()
+{
+	create(data, width, height, GL_RGBA8);
+}
+
+TextureGL::TextureGL(const void* data, uint32_t width, uint32_t height, uint32_t internal_format, uint32_t levels) :
+	TextureGL()
+{
+	create(data, width, height, internal_format, levels ? levels : MipChain::levels(width, height));
+}
+
+TextureGL::TextureGL(const void* data, uint32_t width, uint32_t height, uint32_t internal_format,
+                     const std::vector<MipChain::Level>& mips) :
+	TextureGL()
+{
+	create(data, width, height, internal_format, 1 + mips.size());
+	upload(mips);
+}
+
+TextureGL::TextureGL(const CompressedImage& image, bool srgb) :
+	TextureGL()
+{
+	if (image.valid())
+		create(image, srgb);
+}
+
+TextureGL::TextureGL(TextureGL&& other) noexcept :
+	TextureGL()
+{
+	*this = std::move(other);
+}
+
+TextureGL::~TextureGL()
+{
+	release();
+}
+
+TextureGL& TextureGL::operator=(TextureGL&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	release();
+
+	m_name = std::exchange(other.m_name, 0);
+	m_width = std::exchange(other.m_width, 0);
+	m_height = std::exchange(other.m_height, 0);
+	m_format = std::exchange(other.m_format, 0);
+	m_levels = std::exchange(other.m_levels, 0);
+
+	return *this;
+}
+
+void TextureGL::create(const void* data, uint32_t width, uint32_t height, uint32_t internal_format, uint32_t levels)
+{
+	auto pixel = pixel_format(internal_format);
+
+	m_width = width;
+	m_height = height;
+	m_format = internal_format;
+	m_levels = levels;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_name);
+
+	if (levels > 1) {
+		glTextureParameteri(m_name, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(m_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	} else {
+		glTextureParameteri(m_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	// Sample one channel as gray and two as gray + alpha
+	if (pixel.format == GL_RED) {
+		int32_t swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTextureParameteriv(m_name, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	} else if (pixel.format == GL_RG) {
+		int32_t swizzle[] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+		glTextureParameteriv(m_name, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+
+	glTextureStorage2D(m_name, levels, internal_format, width, height);
+
+	if (data) {
+		// Rows of 1 and 2 byte pixels aren't 4-byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(m_name, 0, 0, 0, width, height, pixel.format, pixel.type, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		RenderStatsGL::texture_upload(static_cast<uint64_t>(width) * height * pixel.size);
+	}
+
+	MemoryGL::allocate(MemoryGL::TEXTURE, m_name, MemoryGL::texture_size(internal_format, width, height, levels));
+}
+
+void TextureGL::create(const CompressedImage& image, bool srgb)
 {
+	srgb = srgb || image.srgb;
+
+	auto format = internal_format(image.format, srgb);
+	auto levels = static_cast<uint32_t>(image.levels.size());
+
+	if (!supported(format)) {
+		_log.info(std::string(CompressedImage::to_string(image.format)) + " is not supported by the driver, decompressing " +
+		          std::to_string(image.width) + "x" + std::to_string(image.height) + " on the CPU");
+
+		auto channels = CompressedImage::channels(image.format);
+		std::vector<MipChain::Level> mips;
+
+		for (auto& level : image.levels) {
+			MipChain::Level pixels{ level.width, level.height, std::vector<uint8_t>(size_t(level.width) * level.height * channels) };
+			CompressedImage::decompress(image.format, level.data, level.width, level.height, pixels.pixels.data());
+			mips.push_back(std::move(pixels));
+		}
+
+		auto base = std::move(mips.front());
+		mips.erase(mips.begin());
+
+		create(base.pixels.data(), image.width, image.height,
+		       (channels == 1) ? GL_R8 : (channels == 2) ? GL_RG8 : (srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8), levels);
+		upload(mips);
+
+		// Sample like the compressed format would, (r, 0, 0, 1) and
+		// (r, g, 0, 1), not as gray
+		int32_t swizzle[] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+		glTextureParameteriv(m_name, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		return;
+	}
+
+	m_width = image.width;
+	m_height = image.height;
+	m_format = format;
+	m_levels = levels;
+
 	glCreateTextures(GL_TEXTURE_2D, 1, &m_name);
 
-	glTextureParameteri(m_name, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(m_name, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(m_name, GL_TEXTURE_MIN_FILTER, (levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTextureParameteri(m_name, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glTextureStorage2D(m_name, levels, format, m_width, m_height);
+
+	// Straight from the mapping, the driver copies what it needs
+	for (uint32_t i = 0; i < levels; ++i) {
+		auto& level = image.levels[i];
+		glCompressedTextureSubImage2D(m_name, i, 0, 0, level.width, level.height, format, level.size, level.data);
+		RenderStatsGL::texture_upload(level.size);
+	}
+
+	MemoryGL::allocate(MemoryGL::TEXTURE, m_name, MemoryGL::texture_size(format, m_width, m_height, levels));
+}
+
+void TextureGL::upload(const std::vector<MipChain::Level>& mips)
+{
+	auto pixel = pixel_format(m_format);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (uint32_t i = 0; i < mips.size(); ++i) {
+		auto& mip = mips[i];
+		glTextureSubImage2D(m_name, i + 1, 0, 0, mip.width, mip.height, pixel.format, pixel.type, mip.pixels.data());
+		RenderStatsGL::texture_upload(mip.pixels.size());
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
 
-	glTextureStorage2D(m_name, 1, GL_RGBA8, width, height);
-	glTextureSubImage2D(m_name, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+void TextureGL::release()
+{
+	if (m_name) {
+		MemoryGL::release(MemoryGL::TEXTURE, m_name);
+		glDeleteTextures(1, &m_name);
+	}
+
+	m_name = 0;
+	m_width = 0;
+	m_height = 0;
+	m_format = 0;
+	m_levels = 0;
 }
 
 uint32_t TextureGL::id()
@@ -60,3 +330,78 @@ uint32_t TextureGL::height()
 {
 	return m_height;
 }
+
+uint32_t TextureGL::format()
+{
+	return m_format;
+}
+
+uint32_t TextureGL::levels()
+{
+	return m_levels;
+}
+
+void TextureGL::sampler(const Sampler& sampler)
+{
+	auto min_filter = (m_levels > 1) ? sampler.min_filter : base_filter(sampler.min_filter);
+
+	glTextureParameteri(m_name, GL_TEXTURE_MIN_FILTER, min_filter);
+	glTextureParameteri(m_name, GL_TEXTURE_MAG_FILTER, sampler.mag_filter);
+	glTextureParameteri(m_name, GL_TEXTURE_WRAP_S, sampler.wrap_s);
+	glTextureParameteri(m_name, GL_TEXTURE_WRAP_T, sampler.wrap_t);
+	glTextureParameterf(m_name, GL_TEXTURE_LOD_BIAS, sampler.lod_bias);
+	glTextureParameterf(m_name, GL_TEXTURE_MIN_LOD, sampler.min_lod);
+	glTextureParameterf(m_name, GL_TEXTURE_MAX_LOD, sampler.max_lod);
+
+	static float max_anisotropy = [] {
+		float result = 1.0f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &result);
+		return result;
+	}();
+
+	glTextureParameterf(m_name, GL_TEXTURE_MAX_ANISOTROPY, std::clamp(sampler.anisotropy, 1.0f, max_anisotropy));
+}
+
+void TextureGL::generate_mipmaps()
+{
+	if (m_levels > 1)
+		glGenerateTextureMipmap(m_name);
+}
+
+void TextureGL::tag(const std::string& tag) const
+{
+	MemoryGL::tag(MemoryGL::TEXTURE, m_name, tag);
+}
+
+TextureGL::PixelFormat TextureGL::pixel_format(uint32_t internal_format)
+{
+	switch (internal_format) {
+	case GL_R8:      return { GL_RED,  GL_UNSIGNED_BYTE,  1 };
+	case GL_RG8:     return { GL_RG,   GL_UNSIGNED_BYTE,  2 };
+	case GL_R16:     return { GL_RED,  GL_UNSIGNED_SHORT, 2 };
+	case GL_RG16:    return { GL_RG,   GL_UNSIGNED_SHORT, 4 };
+	case GL_RGBA16:  return { GL_RGBA, GL_UNSIGNED_SHORT, 8 };
+	case GL_R16F:
+	case GL_R32F:    return { GL_RED,  GL_FLOAT,          4 };
+	case GL_RG16F:
+	case GL_RG32F:   return { GL_RG,   GL_FLOAT,          8 };
+	case GL_RGBA16F:
+	case GL_RGBA32F: return { GL_RGBA, GL_FLOAT,          16 };
+	default:         return { GL_RGBA, GL_UNSIGNED_BYTE,  4 };  // RGBA8, SRGB8_ALPHA8
+	}
+}
+
+bool TextureGL::supported(uint32_t internal_format)
+{
+	static std::unordered_map<uint32_t, bool> formats;
+
+	auto found = formats.find(internal_format);
+
+	if (found != formats.end())
+		return found->second;
+
+	int32_t result = GL_FALSE;
+	glGetInternalformativ(GL_TEXTURE_2D, internal_format, GL_INTERNALFORMAT_SUPPORTED, 1, &result);
+
+	return formats[internal_format] = (result == GL_TRUE);
+}
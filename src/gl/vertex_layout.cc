@@ -0,0 +1,177 @@
+#include <unordered_map>
+#include <utility>
+
+#include <glad/gl.h>
+
+#include "pistacchio/log.hh"
+#include "pistacchio/gl/vertex_layout.hh"
+
+static auto _log = Log("Vertex Layout GL");
+
+// Cached VAOs by layout hash. Layouts with colliding hashes share a bucket.
+static std::unordered_map<uint64_t, std::vector<std::pair<VertexLayout, uint32_t>>> s_vaos;
+
+struct GLSLType {
+	uint32_t type;       // Component type
+	int32_t size;        // Components per column
+	uint32_t columns;
+};
+
+GLSLType glsl_type(uint32_t type)
+{
+	switch (type) {
+	case GL_FLOAT:             return { GL_FLOAT, 1, 1 };
+	case GL_FLOAT_VEC2:        return { GL_FLOAT, 2, 1 };
+	case GL_FLOAT_VEC3:        return { GL_FLOAT, 3, 1 };
+	case GL_FLOAT_VEC4:        return { GL_FLOAT, 4, 1 };
+	case GL_INT:               return { GL_INT, 1, 1 };
+	case GL_INT_VEC2:          return { GL_INT, 2, 1 };
+	case GL_INT_VEC3:          return { GL_INT, 3, 1 };
+	case GL_INT_VEC4:          return { GL_INT, 4, 1 };
+	case GL_UNSIGNED_INT:      return { GL_UNSIGNED_INT, 1, 1 };
+	case GL_UNSIGNED_INT_VEC2: return { GL_UNSIGNED_INT, 2, 1 };
+	case GL_UNSIGNED_INT_VEC3: return { GL_UNSIGNED_INT, 3, 1 };
+	case GL_UNSIGNED_INT_VEC4: return { GL_UNSIGNED_INT, 4, 1 };
+	case GL_DOUBLE:            return { GL_DOUBLE, 1, 1 };
+	case GL_DOUBLE_VEC2:       return { GL_DOUBLE, 2, 1 };
+	case GL_DOUBLE_VEC3:       return { GL_DOUBLE, 3, 1 };
+	case GL_DOUBLE_VEC4:       return { GL_DOUBLE, 4, 1 };
+	case GL_FLOAT_MAT2:        return { GL_FLOAT, 2, 2 };
+	case GL_FLOAT_MAT2x3:      return { GL_FLOAT, 3, 2 };
+	case GL_FLOAT_MAT2x4:      return { GL_FLOAT, 4, 2 };
+	case GL_FLOAT_MAT3:        return { GL_FLOAT, 3, 3 };
+	case GL_FLOAT_MAT3x2:      return { GL_FLOAT, 2, 3 };
+	case GL_FLOAT_MAT3x4:      return { GL_FLOAT, 4, 3 };
+	case GL_FLOAT_MAT4:        return { GL_FLOAT, 4, 4 };
+	case GL_FLOAT_MAT4x2:      return { GL_FLOAT, 2, 4 };
+	case GL_FLOAT_MAT4x3:      return { GL_FLOAT, 3, 4 };
+	default:
+		_log.debug("Unknown attribute type " + std::to_string(type));
+		return { GL_FLOAT, 4, 1 };
+	}
+}
+
+uint32_t component_size(uint32_t type)
+{
+	switch (type) {
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return 2;
+	case GL_DOUBLE:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+// FNV-1a
+void hash_combine(uint64_t& hash, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i) {
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 0x100000001B3;
+	}
+}
+
+uint64_t VertexLayout::hash() const
+{
+	uint64_t hash = 0xCBF29CE484222325;
+
+	for (const auto& a : attributes) {
+		hash_combine(hash, a.location);
+		hash_combine(hash, a.size);
+		hash_combine(hash, a.type);
+		hash_combine(hash, a.binding);
+		hash_combine(hash, a.offset);
+		hash_combine(hash, a.normalized | (a.integer << 1));
+	}
+
+	for (const auto& b : bindings) {
+		hash_combine(hash, b.index);
+		hash_combine(hash, b.stride);
+		hash_combine(hash, b.divisor);
+	}
+
+	return hash;
+}
+
+uint32_t VertexLayout::vao() const
+{
+	auto& bucket = s_vaos[hash()];
+
+	for (const auto& [layout, vao] : bucket)
+		if (layout == *this)
+			return vao;
+
+	uint32_t vao = 0;
+	glCreateVertexArrays(1, &vao);
+
+	for (const auto& a : attributes) {
+		glEnableVertexArrayAttrib(vao, a.location);
+
+		if (a.type == GL_DOUBLE)
+			glVertexArrayAttribLFormat(vao, a.location, a.size, a.type, a.offset);
+		else if (a.integer)
+			glVertexArrayAttribIFormat(vao, a.location, a.size, a.type, a.offset);
+		else
+			glVertexArrayAttribFormat(vao, a.location, a.size, a.type, a.normalized, a.offset);
+
+		glVertexArrayAttribBinding(vao, a.location, a.binding);
+	}
+
+	for (const auto& b : bindings)
+		if (b.divisor)
+			glVertexArrayBindingDivisor(vao, b.index, b.divisor);
+
+	bucket.emplace_back(*this, vao);
+
+	return vao;
+}
+
+void VertexLayout::bind_buffer(uint32_t binding, uint32_t buffer, intptr_t offset) const
+{
+	uint32_t stride = 0;
+
+	for (const auto& b : bindings)
+		if (b.index == binding)
+			stride = b.stride;
+
+	glVertexArrayVertexBuffer(vao(), binding, buffer, offset, stride);
+}
+
+void VertexLayout::bind_index_buffer(uint32_t buffer) const
+{
+	glVertexArrayElementBuffer(vao(), buffer);
+}
+
+std::vector<VertexLayout::Attribute> VertexLayout::format(uint32_t glsl, uint32_t location, uint32_t binding, uint32_t offset)
+{
+	auto t = glsl_type(glsl);
+
+	std::vector<Attribute> result;
+
+	for (uint32_t column = 0; column < t.columns; ++column) {
+		result.push_back(Attribute{
+			.location = location + column,
+			.size = t.size,
+			.type = t.type,
+			.binding = binding,
+			.offset = offset + column * t.size * component_size(t.type),
+			.normalized = false,
+			.integer = (t.type == GL_INT || t.type == GL_UNSIGNED_INT),
+		});
+	}
+
+	return result;
+}
+
+uint32_t VertexLayout::size(uint32_t glsl)
+{
+	auto t = glsl_type(glsl);
+
+	return t.columns * t.size * component_size(t.type);
+}
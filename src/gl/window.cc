@@ -1,21 +1,28 @@
 #include <iostream>
 #include <string>
 
-#define GLAD_GL_IMPLEMENTATION
-#include <glad/gl.h>
 #include <SDL.h>
 
 #include "pistacchio/window.hh"
+#include "pistacchio/gl/debug.hh"
+#include "pistacchio/gl/memory.hh"
+#include "pistacchio/gl/render_stats.hh"
 #include "pistacchio/gl/window.hh"
 #include "pistacchio/log.hh"
 
+// The headers above already include glad, its implementation section is not
+// guarded so it has to come after them
+#define GLAD_GL_IMPLEMENTATION
+#include <glad/gl.h>
+
 static auto _log = Log("Window GL");
 
-WindowGL::WindowGL(const std::string& title, int x, int y, int width, int height, uint32_t flags) :
+WindowGL::WindowGL(const std::string& title, int x, int y, int width, int height, uint32_t flags, bool debug) :
 	Window(title, x, y, width, height, flags | SDL_WINDOW_OPENGL)
 {
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, debug ? SDL_GL_CONTEXT_DEBUG_FLAG : 0);
 
 	m_gl_context = SDL_GL_CreateContext(m_sdl_window);
 
@@ -25,6 +32,9 @@ WindowGL::WindowGL(const std::string& title, int x, int y, int width, int height
 	if (!gladLoadGL(reinterpret_cast<GLADloadfunc>(SDL_GL_GetProcAddress)))
 		_log.error("Unable to load OpenGL functions");
 
+	if (debug)
+		DebugGL::enable();
+
 	glViewport(0, 0, width, height);
 
 	// glEnable(GL_BLEND);
@@ -33,6 +43,13 @@ WindowGL::WindowGL(const std::string& title, int x, int y, int width, int height
 
 WindowGL::~WindowGL()
 {
+	// Pending readbacks need the context, the worker does not
+	if (m_gl_context)
+		m_capture.finish();
+
+	// Anything still registered outlived the window and its context
+	MemoryGL::leaks();
+
 	if (m_gl_context)
 		SDL_GL_DeleteContext(m_gl_context);
 
@@ -43,3 +60,20 @@ void* WindowGL::data()
 {
 	return m_gl_context;
 }
+
+CaptureGL& WindowGL::capture()
+{
+	return m_capture;
+}
+
+void WindowGL::swap()
+{
+	int width, height;
+	SDL_GL_GetDrawableSize(m_sdl_window, &width, &height);
+
+	m_capture.capture(width, height);
+
+	SDL_GL_SwapWindow(m_sdl_window);
+
+	RenderStatsGL::new_frame();
+}
@@ -1,6 +1,12 @@
+#include <SDL2/SDL_mouse.h>
+
 #include "pistacchio/input.hh"
 
 std::vector<SDL_Event> Input::s_events;
+int Input::s_mouse_x = 0;
+int Input::s_mouse_y = 0;
+uint32_t Input::s_mouse_buttons = 0;
+Input::Hit Input::s_hovered;
 
 void Input::update()
 {
@@ -11,9 +17,36 @@ void Input::update()
 	while (SDL_PollEvent(&event)) {
 		s_events.push_back(event);
 	}
+
+	s_mouse_buttons = SDL_GetMouseState(&s_mouse_x, &s_mouse_y);
 }
 
 std::vector<SDL_Event> Input::sdl()
 {
 	return s_events;
 }
+
+int Input::mouse_x()
+{
+	return s_mouse_x;
+}
+
+int Input::mouse_y()
+{
+	return s_mouse_y;
+}
+
+uint32_t Input::mouse_buttons()
+{
+	return s_mouse_buttons;
+}
+
+const Input::Hit& Input::hovered()
+{
+	return s_hovered;
+}
+
+void Input::hovered(const Input::Hit& hit)
+{
+	s_hovered = hit;
+}
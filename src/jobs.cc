@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pistacchio/jobs.hh"
+#include "pistacchio/log.hh"
+
+static auto _log = Log("Jobs");
+
+// One loop runs at a time, workers pick up indices from `next` until they run
+// past `count`.
+struct Pool {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// Serializes `parallel_for` calls from different threads
+	std::mutex submit;
+
+	const std::function<void(uint32_t)>* job = nullptr;
+	uint32_t count = 0;
+	std::atomic<uint32_t> next = 0;
+	uint32_t busy = 0;
+	uint64_t generation = 0;
+	bool stop = false;
+
+	// Joins the workers at exit, in case nobody called `Jobs::stop`
+	~Pool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stop = true;
+		}
+
+		wake.notify_all();
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+};
+
+static Pool s_pool;
+
+// Set on workers, and on the calling thread while it runs jobs of its own
+// loop, so that nested loops run inline instead of waiting on the pool
+static thread_local bool t_in_job = false;
+
+static void run(const std::function<void(uint32_t)>& job, uint32_t count)
+{
+	for (uint32_t i = s_pool.next++; i < count; i = s_pool.next++)
+		job(i);
+}
+
+static void worker()
+{
+	t_in_job = true;
+
+	uint64_t generation = 0;
+
+	while (true) {
+		std::unique_lock lock(s_pool.mutex);
+
+		s_pool.wake.wait(lock, [&] {
+			return s_pool.stop || s_pool.generation != generation;
+		});
+
+		if (s_pool.stop)
+			return;
+
+		generation = s_pool.generation;
+
+		// Woke up too late, the loop is over (and its job may be gone)
+		if (s_pool.next >= s_pool.count)
+			continue;
+
+		auto job = s_pool.job;
+		auto count = s_pool.count;
+		++s_pool.busy;
+
+		lock.unlock();
+
+		run(*job, count);
+
+		lock.lock();
+
+		if (--s_pool.busy == 0)
+			s_pool.done.notify_all();
+	}
+}
+
+void Jobs::start(uint32_t threads)
+{
+	stop();
+
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	s_pool.stop = false;
+
+	for (uint32_t i = 0; i < threads; ++i)
+		s_pool.threads.emplace_back(worker);
+
+	_log.debug("Started " + std::to_string(threads) + " workers");
+}
+
+void Jobs::stop()
+{
+	{
+		std::lock_guard lock(s_pool.mutex);
+		s_pool.stop = true;
+	}
+
+	s_pool.wake.notify_all();
+
+	for (auto& thread : s_pool.threads)
+		thread.join();
+
+	s_pool.threads.clear();
+}
+
+uint32_t Jobs::threads()
+{
+	return s_pool.threads.size();
+}
+
+void Jobs::parallel_for(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	if (t_in_job || count == 1) {
+		for (uint32_t i = 0; i < count; ++i)
+			job(i);
+
+		return;
+	}
+
+	std::lock_guard submit(s_pool.submit);
+
+	if (s_pool.threads.empty())
+		start();
+
+	{
+		std::lock_guard lock(s_pool.mutex);
+
+		s_pool.job = &job;
+		s_pool.count = count;
+		s_pool.next = 0;
+		++s_pool.generation;
+	}
+
+	s_pool.wake.notify_all();
+
+	t_in_job = true;
+	run(job, count);
+	t_in_job = false;
+
+	// Indices are all handed out, wait for the workers still on one
+	std::unique_lock lock(s_pool.mutex);
+	s_pool.done.wait(lock, [] { return s_pool.busy == 0; });
+}
@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "pistacchio/jobs.hh"
+#include "pistacchio/mip_chain.hh"
+
+//
+// SIMD wrappers, vertical passes run `LANES` floats at a time and horizontal
+// ones a whole RGBA texel at a time when there's SSE
+//
+
+// Picked like in the occlusion rasterizer, PISTACCHIO_NO_SIMD included
+#if defined(__AVX2__) && !defined(PISTACCHIO_NO_SIMD)
+#include <immintrin.h>
+
+static constexpr uint32_t LANES = 8;
+static constexpr const char* SIMD = "AVX2";
+
+using Float = __m256;
+
+static inline Float splat(float v) { return _mm256_set1_ps(v); }
+static inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+static inline Float load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+
+#define TEXEL_SSE
+
+#elif (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(PISTACCHIO_NO_SIMD)
+#include <emmintrin.h>
+
+static constexpr uint32_t LANES = 4;
+static constexpr const char* SIMD = "SSE2";
+
+using Float = __m128;
+
+static inline Float splat(float v) { return _mm_set1_ps(v); }
+static inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+static inline Float load(const float* p) { return _mm_loadu_ps(p); }
+static inline void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+
+#define TEXEL_SSE
+
+#else
+
+static constexpr uint32_t LANES = 1;
+static constexpr const char* SIMD = "scalar";
+
+using Float = float;
+
+static inline Float splat(float v) { return v; }
+static inline Float add(Float a, Float b) { return a + b; }
+static inline Float mul(Float a, Float b) { return a * b; }
+static inline Float load(const float* p) { return *p; }
+static inline void store(float* p, Float v) { *p = v; }
+
+#endif
+
+// Rows handed to each job
+static constexpr uint32_t ROWS_PER_JOB = 16;
+
+// Encoding to sRGB goes through a table indexed by quantized linear values,
+// fine enough to be exact in 8 bits
+static constexpr uint32_t ENCODE_STEPS = 16384;
+
+// Taps of a downsampling filter: destination texel `x` reads source texels
+// `2 * x + first` onwards
+struct Kernel {
+	int32_t first;
+	std::vector<float> weights;
+};
+
+static float srgb_to_linear(float c)
+{
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float c)
+{
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static const std::array<float, 256>& decode_table()
+{
+	static const auto table = [] {
+		std::array<float, 256> result;
+
+		for (uint32_t i = 0; i < 256; ++i)
+			result[i] = srgb_to_linear(i / 255.0f);
+
+		return result;
+	}();
+
+	return table;
+}
+
+static const std::vector<uint8_t>& encode_table()
+{
+	static const auto table = [] {
+		std::vector<uint8_t> result(ENCODE_STEPS + 1);
+
+		for (uint32_t i = 0; i <= ENCODE_STEPS; ++i)
+			result[i] = static_cast<uint8_t>(linear_to_srgb(float(i) / ENCODE_STEPS) * 255.0f + 0.5f);
+
+		return result;
+	}();
+
+	return table;
+}
+
+// Modified Bessel function of the first kind, order 0
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k = 1; k < 32; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static Kernel kernel(MipChain::Filter filter)
+{
+	if (filter == MipChain::BOX)
+		return Kernel{ 0, { 0.5f, 0.5f } };
+
+	// Sinc at the destination rate, windowed over 3 source texels each side
+	constexpr double BETA = 4.0;
+	constexpr double RADIUS = 3.0;
+	constexpr double PI = 3.14159265358979323846;
+
+	Kernel result{ -2, {} };
+	double total = 0.0;
+
+	for (int i = -2; i <= 3; ++i) {
+		double distance = i - 0.5;   // From the source texel's center to the destination's
+		double x = distance / 2.0;
+		double sinc = std::sin(PI * x) / (PI * x);
+		double ratio = distance / RADIUS;
+		double window = bessel_i0(BETA * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / bessel_i0(BETA);
+
+		result.weights.push_back(sinc * window);
+		total += sinc * window;
+	}
+
+	for (auto& weight : result.weights)
+		weight /= total;
+
+	return result;
+}
+
+// Horizontal pass of one row, `width` source texels to `width / 2`
+static void filter_row(const float* source, float* destination, uint32_t width, uint32_t destination_width,
+                       uint32_t channels, const Kernel& kernel)
+{
+	int32_t last = static_cast<int32_t>(width) - 1;
+
+	for (uint32_t x = 0; x < destination_width; ++x) {
+		int32_t first = 2 * static_cast<int32_t>(x) + kernel.first;
+		float* out = destination + x * channels;
+
+#if defined(TEXEL_SSE)
+		if (channels == 4) {
+			__m128 sum = _mm_setzero_ps();
+
+			for (uint32_t i = 0; i < kernel.weights.size(); ++i) {
+				auto texel = std::clamp(first + static_cast<int32_t>(i), 0, last);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + texel * 4), _mm_set1_ps(kernel.weights[i])));
+			}
+
+			_mm_storeu_ps(out, sum);
+			continue;
+		}
+#endif
+
+		for (uint32_t c = 0; c < channels; ++c)
+			out[c] = 0.0f;
+
+		for (uint32_t i = 0; i < kernel.weights.size(); ++i) {
+			auto texel = std::clamp(first + static_cast<int32_t>(i), 0, last);
+
+			for (uint32_t c = 0; c < channels; ++c)
+				out[c] += source[texel * channels + c] * kernel.weights[i];
+		}
+	}
+}
+
+// Vertical pass of one destination row, a weighted sum of whole rows
+static void filter_column(const float* const* rows, const std::vector<float>& weights, float* destination, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + LANES <= count; i += LANES) {
+		Float sum = splat(0.0f);
+
+		for (uint32_t tap = 0; tap < weights.size(); ++tap)
+			sum = add(sum, mul(load(rows[tap] + i), splat(weights[tap])));
+
+		store(destination + i, sum);
+	}
+
+	for (; i < count; ++i) {
+		float sum = 0.0f;
+
+		for (uint32_t tap = 0; tap < weights.size(); ++tap)
+			sum += rows[tap][i] * weights[tap];
+
+		destination[i] = sum;
+	}
+}
+
+uint32_t MipChain::levels(uint32_t width, uint32_t height)
+{
+	uint32_t result = 1;
+
+	while (width > 1 || height > 1) {
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		++result;
+	}
+
+	return result;
+}
+
+std::vector<MipChain::Level> MipChain::generate(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels,
+                                                Filter filter, bool srgb)
+{
+	std::vector<Level> result;
+
+	if (!pixels || width == 0 || height == 0 || channels == 0 || channels > 4)
+		return result;
+
+	// Alpha is the last channel of gray + alpha and RGBA
+	auto is_color = [&](uint32_t c) {
+		return srgb && !((channels == 2 || channels == 4) && c == channels - 1);
+	};
+
+	auto& decode = decode_table();
+	auto& encode = encode_table();
+	auto taps = kernel(filter);
+
+	// Level 0 in linear float
+
+	std::vector<float> current(size_t(width) * height * channels);
+
+	Jobs::parallel_for((height + ROWS_PER_JOB - 1) / ROWS_PER_JOB, [&](uint32_t job) {
+		uint32_t end = std::min((job + 1) * ROWS_PER_JOB, height);
+
+		for (uint32_t y = job * ROWS_PER_JOB; y < end; ++y) {
+			for (uint32_t x = 0; x < width * channels; ++x) {
+				size_t i = size_t(y) * width * channels + x;
+				current[i] = is_color(x % channels) ? decode[pixels[i]] : pixels[i] / 255.0f;
+			}
+		}
+	});
+
+	std::vector<float> horizontal;
+	std::vector<float> next;
+
+	while (width > 1 || height > 1) {
+		uint32_t next_width = std::max(width / 2, 1u);
+		uint32_t next_height = std::max(height / 2, 1u);
+		uint32_t source_row = width * channels;
+		uint32_t row = next_width * channels;
+
+		// A dimension that is already 1 is copied, not filtered
+		const Kernel identity{ 0, { 1.0f } };
+		const Kernel& horizontal_taps = (width > 1) ? taps : identity;
+		const Kernel& vertical_taps = (height > 1) ? taps : identity;
+
+		horizontal.resize(size_t(row) * height);
+		next.resize(size_t(row) * next_height);
+
+		Jobs::parallel_for((height + ROWS_PER_JOB - 1) / ROWS_PER_JOB, [&](uint32_t job) {
+			uint32_t end = std::min((job + 1) * ROWS_PER_JOB, height);
+
+			for (uint32_t y = job * ROWS_PER_JOB; y < end; ++y)
+				filter_row(current.data() + size_t(y) * source_row, horizontal.data() + size_t(y) * row,
+				           width, next_width, channels, horizontal_taps);
+		});
+
+		Level level{ next_width, next_height, std::vector<uint8_t>(size_t(row) * next_height) };
+
+		Jobs::parallel_for((next_height + ROWS_PER_JOB - 1) / ROWS_PER_JOB, [&](uint32_t job) {
+			uint32_t end = std::min((job + 1) * ROWS_PER_JOB, next_height);
+			std::vector<const float*> rows(vertical_taps.weights.size());
+
+			for (uint32_t y = job * ROWS_PER_JOB; y < end; ++y) {
+				int32_t first = (height > 1 ? 2 * static_cast<int32_t>(y) : 0) + vertical_taps.first;
+
+				for (uint32_t tap = 0; tap < rows.size(); ++tap)
+					rows[tap] = horizontal.data() + size_t(std::clamp(first + static_cast<int32_t>(tap), 0, static_cast<int32_t>(height) - 1)) * row;
+
+				float* out = next.data() + size_t(y) * row;
+				filter_column(rows.data(), vertical_taps.weights, out, row);
+
+				uint8_t* bytes = level.pixels.data() + size_t(y) * row;
+
+				for (uint32_t x = 0; x < row; ++x) {
+					float value = std::clamp(out[x], 0.0f, 1.0f);
+
+					// Kaiser lobes can go slightly negative or above 1, keep
+					// the clamped value for the next level too
+					out[x] = value;
+					bytes[x] = is_color(x % channels) ? encode[static_cast<uint32_t>(value * ENCODE_STEPS + 0.5f)]
+					                                  : static_cast<uint8_t>(value * 255.0f + 0.5f);
+				}
+			}
+		});
+
+		result.push_back(std::move(level));
+
+		std::swap(current, next);
+		width = next_width;
+		height = next_height;
+	}
+
+	return result;
+}
+
+const char* MipChain::simd()
+{
+	return SIMD;
+}
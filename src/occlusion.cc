@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "pistacchio/jobs.hh"
+#include "pistacchio/occlusion.hh"
+
+//
+// SIMD wrappers, rows are rasterized `LANES` pixels at a time
+//
+
+// Defining PISTACCHIO_NO_SIMD selects the scalar code even where SIMD is
+// available, the tests build every variant
+#if defined(__AVX2__) && !defined(PISTACCHIO_NO_SIMD)
+#include <immintrin.h>
+
+static constexpr uint32_t LANES = 8;
+static constexpr const char* SIMD = "AVX2";
+
+using Float = __m256;
+
+static inline Float splat(float v) { return _mm256_set1_ps(v); }
+static inline Float lanes() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+static inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+static inline Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+static inline Float ge(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline Float both(Float a, Float b) { return _mm256_and_ps(a, b); }
+static inline Float select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+static inline bool any(Float mask) { return _mm256_movemask_ps(mask) != 0; }
+static inline Float load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+
+#elif (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(PISTACCHIO_NO_SIMD)
+#include <emmintrin.h>
+
+static constexpr uint32_t LANES = 4;
+static constexpr const char* SIMD = "SSE2";
+
+using Float = __m128;
+
+static inline Float splat(float v) { return _mm_set1_ps(v); }
+static inline Float lanes() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+static inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+static inline Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+static inline Float ge(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+static inline Float both(Float a, Float b) { return _mm_and_ps(a, b); }
+static inline Float select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+static inline bool any(Float mask) { return _mm_movemask_ps(mask) != 0; }
+static inline Float load(const float* p) { return _mm_loadu_ps(p); }
+static inline void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+
+#else
+
+static constexpr uint32_t LANES = 1;
+static constexpr const char* SIMD = "scalar";
+
+using Float = float;
+
+static inline Float splat(float v) { return v; }
+static inline Float lanes() { return 0.0f; }
+static inline Float add(Float a, Float b) { return a + b; }
+static inline Float mul(Float a, Float b) { return a * b; }
+static inline Float min(Float a, Float b) { return std::min(a, b); }
+static inline Float ge(Float a, Float b) { return a >= b ? 1.0f : 0.0f; }
+static inline Float both(Float a, Float b) { return a * b; }
+static inline Float select(Float mask, Float a, Float b) { return mask != 0.0f ? a : b; }
+static inline bool any(Float mask) { return mask != 0.0f; }
+static inline Float load(const float* p) { return *p; }
+static inline void store(float* p, Float v) { *p = v; }
+
+#endif
+
+static_assert(OcclusionBuffer::TILE_WIDTH % LANES == 0, "Rows of a tile must split evenly in SIMD lanes");
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) :
+	m_width(0),
+	m_height(0),
+	m_pitch(0),
+	m_rows(0),
+	m_view_projection(1.0f)
+{
+	resize(width, height);
+}
+
+void OcclusionBuffer::resize(uint32_t width, uint32_t height)
+{
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+	m_pitch = (m_width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH;
+	m_rows = (m_height + TILE_HEIGHT - 1) / TILE_HEIGHT * TILE_HEIGHT;
+
+	m_depth.assign(m_pitch * m_rows, 1.0f);
+	m_bins.assign((m_pitch / TILE_WIDTH) * (m_rows / TILE_HEIGHT), {});
+}
+
+void OcclusionBuffer::begin(const glm::mat4& view_projection)
+{
+	m_view_projection = view_projection;
+
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+	m_triangles.clear();
+}
+
+void OcclusionBuffer::add_occluder(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, const glm::mat4& model)
+{
+	auto transform = m_view_projection * model;
+
+	std::vector<glm::vec4> clip(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+		clip[i] = transform * glm::vec4(vertices[i], 1.0f);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		glm::vec4 in[3] = { clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]] };
+
+		// Clip against the near plane (z >= -w), which leaves up to four
+		// vertices to fan out
+
+		glm::vec4 out[4];
+		uint32_t count = 0;
+
+		for (uint32_t v = 0; v < 3; ++v) {
+			const auto& a = in[v];
+			const auto& b = in[(v + 1) % 3];
+			float da = a.z + a.w;
+			float db = b.z + b.w;
+
+			if (da >= 0.0f)
+				out[count++] = a;
+
+			if ((da >= 0.0f) != (db >= 0.0f))
+				out[count++] = a + (b - a) * (da / (da - db));
+		}
+
+		for (uint32_t v = 1; v + 1 < count; ++v)
+			setup(out[0], out[v], out[v + 1]);
+	}
+}
+
+void OcclusionBuffer::setup(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+{
+	glm::vec3 v[3];
+	const glm::vec4* clip[3] = { &c0, &c1, &c2 };
+
+	for (int i = 0; i < 3; ++i) {
+		const auto& c = *clip[i];
+
+		// Clipped to the near plane already, `w` can't be 0 here
+		v[i] = glm::vec3(
+			(c.x / c.w * 0.5f + 0.5f) * m_width,
+			(c.y / c.w * 0.5f + 0.5f) * m_height,
+			c.z / c.w * 0.5f + 0.5f);
+	}
+
+	float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+
+	// Back-facing or degenerate
+	if (area <= 0.0f)
+		return;
+
+	Triangle t;
+
+	t.min_x = std::max<int32_t>(std::floor(std::min({ v[0].x, v[1].x, v[2].x })), 0);
+	t.min_y = std::max<int32_t>(std::floor(std::min({ v[0].y, v[1].y, v[2].y })), 0);
+	t.max_x = std::min<int32_t>(std::ceil(std::max({ v[0].x, v[1].x, v[2].x })), m_width - 1);
+	t.max_y = std::min<int32_t>(std::ceil(std::max({ v[0].y, v[1].y, v[2].y })), m_height - 1);
+
+	if (t.min_x > t.max_x || t.min_y > t.max_y)
+		return;
+
+	// Edge `i` goes from vertex `i` to the next one and is positive inside.
+	// Divided by the area it's the barycentric weight of the opposite vertex.
+
+	for (int i = 0; i < 3; ++i) {
+		const auto& a = v[i];
+		const auto& b = v[(i + 1) % 3];
+
+		t.a[i] = a.y - b.y;
+		t.b[i] = b.x - a.x;
+		t.c[i] = -(t.a[i] * a.x + t.b[i] * a.y);
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		// Weights of vertices 0, 1 and 2 come from edges 1, 2 and 0
+		float (&plane)[3] = (i == 0) ? t.a : (i == 1) ? t.b : t.c;
+		t.z[i] = (plane[1] * v[0].z + plane[2] * v[1].z + plane[0] * v[2].z) / area;
+	}
+
+	m_triangles.push_back(t);
+}
+
+void OcclusionBuffer::rasterize()
+{
+	uint32_t tiles_x = m_pitch / TILE_WIDTH;
+
+	for (auto& bin : m_bins)
+		bin.clear();
+
+	for (uint32_t i = 0; i < m_triangles.size(); ++i) {
+		const auto& t = m_triangles[i];
+
+		for (int32_t y = t.min_y / TILE_HEIGHT; y <= t.max_y / static_cast<int32_t>(TILE_HEIGHT); ++y)
+			for (int32_t x = t.min_x / TILE_WIDTH; x <= t.max_x / static_cast<int32_t>(TILE_WIDTH); ++x)
+				m_bins[y * tiles_x + x].push_back(i);
+	}
+
+	Jobs::parallel_for(m_bins.size(), [this](uint32_t tile) {
+		rasterize_tile(tile);
+	});
+}
+
+void OcclusionBuffer::rasterize_tile(uint32_t tile)
+{
+	uint32_t tiles_x = m_pitch / TILE_WIDTH;
+	int32_t tile_x = (tile % tiles_x) * TILE_WIDTH;
+	int32_t tile_y = (tile / tiles_x) * TILE_HEIGHT;
+
+	const Float zero = splat(0.0f);
+	const Float offsets = lanes();
+
+	for (auto index : m_bins[tile]) {
+		const auto& t = m_triangles[index];
+
+		// Start at a lane boundary, tiles are whole multiples of `LANES` so
+		// spans never spill into a neighbour tile
+		int32_t x0 = std::max(t.min_x, tile_x) / LANES * LANES;
+		int32_t x1 = std::min<int32_t>(t.max_x, tile_x + TILE_WIDTH - 1);
+		int32_t y0 = std::max(t.min_y, tile_y);
+		int32_t y1 = std::min<int32_t>(t.max_y, tile_y + TILE_HEIGHT - 1);
+
+		const Float a0 = splat(t.a[0]), a1 = splat(t.a[1]), a2 = splat(t.a[2]);
+		const Float az = splat(t.z[0]);
+
+		for (int32_t y = y0; y <= y1; ++y) {
+			float py = y + 0.5f;
+
+			const Float row0 = splat(t.b[0] * py + t.c[0]);
+			const Float row1 = splat(t.b[1] * py + t.c[1]);
+			const Float row2 = splat(t.b[2] * py + t.c[2]);
+			const Float rowz = splat(t.z[1] * py + t.z[2]);
+
+			float* depth = &m_depth[y * m_pitch];
+
+			for (int32_t x = x0; x <= x1; x += LANES) {
+				Float px = add(splat(x + 0.5f), offsets);
+
+				Float inside = both(both(
+					ge(add(mul(a0, px), row0), zero),
+					ge(add(mul(a1, px), row1), zero)),
+					ge(add(mul(a2, px), row2), zero));
+
+				if (!any(inside))
+					continue;
+
+				Float z = add(mul(az, px), rowz);
+				Float current = load(depth + x);
+
+				store(depth + x, select(inside, min(current, z), current));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::visible(const glm::vec3& min, const glm::vec3& max) const
+{
+	glm::vec2 rect_min = glm::vec2(static_cast<float>(m_width), static_cast<float>(m_height));
+	glm::vec2 rect_max = glm::vec2(0.0f);
+	float nearest = 1.0f;
+
+	for (int i = 0; i < 8; ++i) {
+		glm::vec4 corner = {
+			(i & 1) ? max.x : min.x,
+			(i & 2) ? max.y : min.y,
+			(i & 4) ? max.z : min.z,
+			1.0f
+		};
+
+		glm::vec4 clip = m_view_projection * corner;
+
+		// Crossing the near plane, assume visible
+		if (clip.w <= 0.0f)
+			return true;
+
+		glm::vec2 pixel = {
+			(clip.x / clip.w * 0.5f + 0.5f) * m_width,
+			(clip.y / clip.w * 0.5f + 0.5f) * m_height
+		};
+
+		rect_min = glm::min(rect_min, pixel);
+		rect_max = glm::max(rect_max, pixel);
+		nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	int32_t x0 = std::max<int32_t>(std::floor(rect_min.x), 0);
+	int32_t y0 = std::max<int32_t>(std::floor(rect_min.y), 0);
+	int32_t x1 = std::min<int32_t>(std::ceil(rect_max.x), m_width - 1);
+	int32_t y1 = std::min<int32_t>(std::ceil(rect_max.y), m_height - 1);
+
+	if (x0 > x1 || y0 > y1 || nearest > 1.0f)
+		return false;
+
+	for (int32_t y = y0; y <= y1; ++y)
+		for (int32_t x = x0; x <= x1; ++x)
+			if (nearest <= m_depth[y * m_pitch + x])
+				return true;
+
+	return false;
+}
+
+uint32_t OcclusionBuffer::width() const
+{
+	return m_width;
+}
+
+uint32_t OcclusionBuffer::height() const
+{
+	return m_height;
+}
+
+float OcclusionBuffer::depth(uint32_t x, uint32_t y) const
+{
+	return m_depth[y * m_pitch + x];
+}
+
+const char* OcclusionBuffer::simd()
+{
+	return SIMD;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdio>
+
+// Just enough for the CPU-only tests: failed checks are printed and counted,
+// and `main` returns the count.
+
+inline int s_failures = 0;
+
+#define CHECK(condition)                                                                      \
+	do {                                                                                      \
+		if (!(condition)) {                                                                   \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);          \
+			++s_failures;                                                                     \
+		}                                                                                     \
+	} while (0)
@@ -0,0 +1,195 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "pistacchio/filesystem/compressed_image.hh"
+
+#include "check.hh"
+
+// Writes `bits` values of `count` bits each, least significant first, like
+// BC7 reads them
+struct BitWriter {
+	uint8_t block[16] = {};
+	uint32_t position = 0;
+
+	void write(uint32_t value, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i, ++position)
+			if ((value >> i) & 1)
+				block[position >> 3] |= 1 << (position & 7);
+	}
+};
+
+static std::vector<uint8_t> decompress(CompressedImage::Format format, const uint8_t* block, uint32_t width = 4, uint32_t height = 4)
+{
+	std::vector<uint8_t> pixels(width * height * CompressedImage::channels(format));
+	CompressedImage::decompress(format, block, width, height, pixels.data());
+
+	return pixels;
+}
+
+static bool texel(const std::vector<uint8_t>& pixels, uint32_t index, std::vector<uint8_t> expected)
+{
+	return std::memcmp(pixels.data() + index * expected.size(), expected.data(), expected.size()) == 0;
+}
+
+static void bc1()
+{
+	// Red and blue with c0 > c1: four colors, texels use indices 0 to 3
+	uint8_t opaque[8] = { 0x00, 0xF8, 0x1F, 0x00, 0b11100100, 0, 0, 0 };
+	auto pixels = decompress(CompressedImage::BC1, opaque);
+
+	CHECK(texel(pixels, 0, { 255, 0, 0, 255 }));
+	CHECK(texel(pixels, 1, { 0, 0, 255, 255 }));
+	CHECK(texel(pixels, 2, { 170, 0, 85, 255 }));
+	CHECK(texel(pixels, 3, { 85, 0, 170, 255 }));
+	CHECK(texel(pixels, 4, { 255, 0, 0, 255 }));
+
+	// c0 <= c1: three colors and transparent black
+	uint8_t punchthrough[8] = { 0x1F, 0x00, 0x00, 0xF8, 0b11100100, 0, 0, 0 };
+	pixels = decompress(CompressedImage::BC1, punchthrough);
+
+	CHECK(texel(pixels, 0, { 0, 0, 255, 255 }));
+	CHECK(texel(pixels, 2, { 128, 0, 128, 255 }));
+	CHECK(texel(pixels, 3, { 0, 0, 0, 0 }));
+}
+
+static void bc4()
+{
+	// r0 > r1: eight values, indices 0, 1, 2 and 7 on the first texels
+	uint8_t eight[8] = { 200, 100, 0b10001000, 0b00001110, 0, 0, 0, 0 };
+	auto pixels = decompress(CompressedImage::BC4, eight);
+
+	CHECK(pixels[0] == 200);
+	CHECK(pixels[1] == 100);
+	CHECK(pixels[2] == 186);
+	CHECK(pixels[3] == 114);
+	CHECK(pixels[4] == 200);
+
+	// r0 <= r1: six values plus 0 and 255, indices 2, 6 and 7
+	uint8_t six[8] = { 50, 150, 0b11110010, 0b00000001, 0, 0, 0, 0 };
+	pixels = decompress(CompressedImage::BC4, six);
+
+	CHECK(pixels[0] == 70);
+	CHECK(pixels[1] == 0);
+	CHECK(pixels[2] == 255);
+}
+
+static void bc7()
+{
+	// Mode 6: one subset, 7-bit RGBA endpoints with a p-bit each, 4-bit
+	// indices. Endpoints 201 and 40 for color, 255 and 0 for alpha, texel i
+	// uses index i
+	BitWriter mode6;
+	mode6.write(1 << 6, 7);
+
+	for (int c = 0; c < 3; ++c) {
+		mode6.write(100, 7);
+		mode6.write(20, 7);
+	}
+
+	mode6.write(127, 7);
+	mode6.write(0, 7);
+	mode6.write(1, 1);
+	mode6.write(0, 1);
+
+	for (uint32_t i = 0; i < 16; ++i)
+		mode6.write(i, i == 0 ? 3 : 4);
+
+	auto pixels = decompress(CompressedImage::BC7, mode6.block);
+
+	CHECK(texel(pixels, 0, { 201, 201, 201, 255 }));
+	CHECK(texel(pixels, 1, { 191, 191, 191, 239 }));
+	CHECK(texel(pixels, 8, { 115, 115, 115, 120 }));
+	CHECK(texel(pixels, 15, { 40, 40, 40, 0 }));
+
+	// Mode 5 with rotation 1, alpha and red swapped after interpolation
+	BitWriter mode5;
+	mode5.write(1 << 5, 6);
+	mode5.write(1, 2);
+
+	for (int c = 0; c < 3; ++c) {
+		mode5.write(127, 7);
+		mode5.write(0, 7);
+	}
+
+	mode5.write(255, 8);
+	mode5.write(0, 8);
+
+	for (uint32_t i = 0; i < 16; ++i)
+		mode5.write(3, i == 0 ? 1 : 2);
+
+	for (uint32_t i = 0; i < 16; ++i)
+		mode5.write(0, i == 0 ? 1 : 2);
+
+	CHECK(mode5.position == 128);
+
+	pixels = decompress(CompressedImage::BC7, mode5.block);
+
+	CHECK(texel(pixels, 0, { 255, 171, 171, 171 }));
+	CHECK(texel(pixels, 1, { 255, 0, 0, 0 }));
+
+	// Reserved mode
+	uint8_t reserved[16] = {};
+	pixels = decompress(CompressedImage::BC7, reserved);
+
+	CHECK(texel(pixels, 0, { 0, 0, 0, 0 }));
+}
+
+static void partial_blocks()
+{
+	// A 3x2 image is the top left of one block
+	uint8_t block[8] = { 200, 100, 0b10001000, 0b00001110, 0, 0, 0, 0 };
+	auto pixels = decompress(CompressedImage::BC4, block, 3, 2);
+
+	CHECK(pixels.size() == 6);
+	CHECK(pixels[0] == 200 && pixels[1] == 100 && pixels[2] == 186);
+	CHECK(pixels[3] == 200);
+}
+
+static void dds()
+{
+	auto path = std::filesystem::temp_directory_path() / "pistacchio_test.dds";
+
+	// 8x4 BC4 with three levels: 2 blocks, then 1 and 1
+	std::vector<uint8_t> file(4 + 124, 0);
+	auto write = [&](size_t offset, uint32_t value) { std::memcpy(file.data() + offset, &value, 4); };
+
+	std::memcpy(file.data(), "DDS ", 4);
+	write(4, 124);
+	write(12, 4);
+	write(16, 8);
+	write(28, 3);
+	write(80, 0x4);
+	std::memcpy(file.data() + 84, "ATI1", 4);
+	file.resize(file.size() + 4 * 8, 7);
+
+	std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), file.size());
+
+	auto image = CompressedImage::load(path.string());
+
+	CHECK(image.valid());
+	CHECK(image.format == CompressedImage::BC4);
+	CHECK(image.width == 8 && image.height == 4);
+	CHECK(image.levels.size() == 3);
+	CHECK(image.levels.size() == 3 && image.levels[1].width == 4 && image.levels[2].width == 2 && image.levels[2].height == 1);
+	CHECK(image.levels.size() == 3 && image.levels[0].size == 16 && image.levels[2].size == 8);
+
+	// One byte short of the last level
+	std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), file.size() - 1);
+	CHECK(!CompressedImage::load(path.string()).valid());
+
+	std::filesystem::remove(path);
+}
+
+int main()
+{
+	bc1();
+	bc4();
+	bc7();
+	partial_blocks();
+	dds();
+
+	return s_failures;
+}
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <SDL.h>
+
+#include "pistacchio/gl/culling.hh"
+#include "pistacchio/gl/window.hh"
+
+#include "check.hh"
+
+// Runs the culling pass on a real context, meant for Mesa's llvmpipe on CI
+// (see CMakeLists.txt). Skipped when no GL 4.6 context can be created.
+
+static constexpr int SKIP = 77;
+
+// Orthographic view-projection whose frustum is the box `center` +- 5
+static glm::mat4 box_frustum(const glm::vec3& center)
+{
+	glm::mat4 result(0.2f);
+	result[3] = glm::vec4(-center * 0.2f, 1.0f);
+
+	return result;
+}
+
+// Pumps `cull` until the compute shader is ready
+static bool cull(CullingGL& culling, const glm::mat4& view_projection)
+{
+	for (int i = 0; i < 10000; ++i) {
+		if (culling.cull(view_projection))
+			return true;
+
+		SDL_Delay(1);
+	}
+
+	return false;
+}
+
+// Objects drawn by the last pass, as the `base_instance` of their command,
+// compacted or not
+static std::vector<uint32_t> survivors(const CullingGL& culling)
+{
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	std::vector<DrawListGL::Command> commands(culling.size());
+	glGetNamedBufferSubData(culling.command_buffer(), 0, commands.size() * sizeof(DrawListGL::Command), commands.data());
+
+	uint32_t count = 0;
+	glGetNamedBufferSubData(culling.count_buffer(), 0, sizeof(count), &count);
+
+	std::vector<uint32_t> result;
+
+	if (CullingGL::compaction()) {
+		CHECK(count <= commands.size());
+		commands.resize(std::min<size_t>(count, commands.size()));
+	}
+
+	for (size_t i = 0; i < commands.size(); ++i) {
+		const auto& command = commands[i];
+		uint32_t id = command.base_instance;
+
+		if (id >= culling.size()) {
+			CHECK(!"command of an unknown object");
+			continue;
+		}
+
+		// Every command still describes its own object
+		CHECK(command.count == 3 * (id + 1));
+		CHECK(command.first_index == id * 100);
+		CHECK(command.base_vertex == static_cast<int32_t>(id));
+
+		if (!CullingGL::compaction())
+			CHECK(id == i);
+
+		if (command.instance_count == 1)
+			result.push_back(id);
+		else
+			CHECK(command.instance_count == 0 && !CullingGL::compaction());
+	}
+
+	std::sort(result.begin(), result.end());
+
+	return result;
+}
+
+int main()
+{
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		std::printf("No video: %s\n", SDL_GetError());
+		return SKIP;
+	}
+
+	int status = SKIP;
+
+	{
+		WindowGL window("Culling test", Window::UNDEFINED, Window::UNDEFINED, 64, 64, SDL_WINDOW_HIDDEN);
+
+		if (window.data()) {
+			std::printf("%s, compaction: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)), CullingGL::compaction() ? "yes" : "no");
+
+			CullingGL culling(8);
+
+			std::vector<glm::vec4> spheres = {
+				{ 0.0f, 0.0f, 0.0f, 1.0f },     // Inside
+				{ 10.0f, 0.0f, 0.0f, 1.0f },    // Outside
+				{ 5.5f, 0.0f, 0.0f, 1.0f },     // Crossing a plane
+				{ 0.0f, -7.0f, 0.0f, 1.0f },    // Outside
+				{ 0.0f, 0.0f, 4.0f, 2.0f },     // Crossing the far plane
+				{ -6.5f, 0.0f, 0.0f, 1.0f },    // Just outside
+			};
+
+			std::vector<CullingGL::Object> objects;
+
+			for (uint32_t i = 0; i < spheres.size(); ++i)
+				objects.push_back(CullingGL::Object{ spheres[i], 3 * (i + 1), i * 100, static_cast<int32_t>(i) });
+
+			culling.set(objects);
+			CHECK(culling.size() == spheres.size());
+
+			CHECK(cull(culling, box_frustum(glm::vec3(0.0f))));
+			CHECK(survivors(culling) == std::vector<uint32_t>({ 0, 2, 4 }));
+
+			// The count restarts from zero on every pass
+			CHECK(cull(culling, box_frustum(glm::vec3(10.0f, 0.0f, 0.0f))));
+			CHECK(survivors(culling) == std::vector<uint32_t>({ 1, 2 }));
+
+			// Moving an object
+			culling.set(5, CullingGL::Object{ glm::vec4(12.0f, 1.0f, 0.0f, 1.0f), 18, 500, 5 });
+
+			CHECK(cull(culling, box_frustum(glm::vec3(10.0f, 0.0f, 0.0f))));
+			CHECK(survivors(culling) == std::vector<uint32_t>({ 1, 2, 5 }));
+
+			CHECK(glGetError() == GL_NO_ERROR);
+
+			status = s_failures;
+		} else {
+			std::printf("No GL 4.6 context\n");
+		}
+	}
+
+	SDL_Quit();
+
+	return status;
+}
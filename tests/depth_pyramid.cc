@@ -0,0 +1,77 @@
+#include <vector>
+
+#include "pistacchio/depth_pyramid.hh"
+
+#include "check.hh"
+
+int main()
+{
+	// Nothing is occluded before the first build
+
+	DepthPyramid pyramid;
+	CHECK(pyramid.empty());
+	CHECK(!pyramid.occluded(glm::vec3(-0.1f, -0.1f, 0.9f), glm::vec3(0.1f, 0.1f, 0.95f)));
+
+	// Levels go down to 1x1, the last texel of odd sizes covers the extra
+	// column so the far texel in it is never skipped
+
+	std::vector<float> odd(5 * 3, 0.25f);
+	odd[1 * 5 + 4] = 0.75f;
+
+	pyramid.build(5, 3, odd, glm::mat4(1.0f));
+
+	const auto& odd_levels = pyramid.levels();
+	CHECK(odd_levels.size() == 3);
+	CHECK(odd_levels[1].width == 2 && odd_levels[1].height == 1);
+	CHECK(odd_levels[1].depth[0] == 0.25f);
+	CHECK(odd_levels[1].depth[1] == 0.75f);
+	CHECK(odd_levels[2].width == 1 && odd_levels[2].height == 1);
+	CHECK(odd_levels[2].depth[0] == 0.75f);
+
+	// Sizes that don't match the depth leave it empty
+	pyramid.build(4, 4, odd, glm::mat4(1.0f));
+	CHECK(pyramid.empty());
+
+	// A 64x64 wall at depth 0.5 (z = 0 with an identity view-projection),
+	// with a hole down to the far plane in the bottom-left texel
+
+	std::vector<float> wall(64 * 64, 0.5f);
+	wall[0] = 1.0f;
+
+	pyramid.build(64, 64, wall, glm::mat4(1.0f));
+	CHECK(pyramid.levels().size() == 7);
+
+	// Level selection: the finest level where the box spans at most 2x2
+	// texels
+
+	CHECK(pyramid.level(2.0f / 64.0f, 2.0f / 64.0f) == 0);
+	CHECK(pyramid.level(3.0f / 64.0f, 1.0f / 64.0f) == 1);
+	CHECK(pyramid.level(0.1f, 0.1f) == 2);
+	CHECK(pyramid.level(1.0f, 1.0f) == 5);
+
+	// A small box behind the wall, far from the hole, is occluded. Only a fine
+	// level can tell: coarser ones include the hole's far depth.
+	CHECK(pyramid.occluded(glm::vec3(-0.05f, -0.05f, 0.4f), glm::vec3(0.05f, 0.05f, 0.6f)));
+
+	// In front of the wall, or crossing it
+	CHECK(!pyramid.occluded(glm::vec3(-0.05f, -0.05f, -0.6f), glm::vec3(0.05f, 0.05f, -0.4f)));
+	CHECK(!pyramid.occluded(glm::vec3(-0.05f, -0.05f, -0.1f), glm::vec3(0.05f, 0.05f, 0.6f)));
+
+	// Behind the wall but seen through the hole
+	CHECK(!pyramid.occluded(glm::vec3(-1.0f, -1.0f, 0.4f), glm::vec3(-0.99f, -0.99f, 0.6f)));
+
+	// Big boxes use a coarse level, where the hole spreads to a whole quarter
+	CHECK(!pyramid.occluded(glm::vec3(-0.9f, -0.9f, 0.4f), glm::vec3(0.9f, 0.9f, 0.6f)));
+
+	// Boxes crossing the near plane are never occluded
+	auto behind_camera = glm::mat4(1.0f);
+	behind_camera[3][3] = -1.0f;
+
+	pyramid.build(64, 64, wall, behind_camera);
+	CHECK(!pyramid.occluded(glm::vec3(-0.05f, -0.05f, 0.4f), glm::vec3(0.05f, 0.05f, 0.6f)));
+
+	pyramid.clear();
+	CHECK(pyramid.empty());
+
+	return s_failures;
+}
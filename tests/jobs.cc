@@ -0,0 +1,25 @@
+#include <atomic>
+
+#include "pistacchio/jobs.hh"
+
+#include "check.hh"
+
+int main()
+{
+	// More workers than cores is fine, it makes races more likely
+	Jobs::start(8);
+
+	std::atomic<uint64_t> sum = 0;
+	Jobs::parallel_for(1000, [&](uint32_t i) { sum += i; });
+	CHECK(sum == 999 * 1000 / 2);
+
+	// Nested loops run inline, on workers and on the calling thread alike
+	std::atomic<uint32_t> nested = 0;
+	Jobs::parallel_for(64, [&](uint32_t) {
+		Jobs::parallel_for(4, [&](uint32_t) { ++nested; });
+	});
+	CHECK(nested == 64 * 4);
+
+	// Leaving without `Jobs::stop` must not hang
+	return s_failures;
+}
@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#include "pistacchio/mip_chain.hh"
+
+#include "check.hh"
+
+// Close enough for a value that went through float filtering and rounding
+static bool near(int a, int b)
+{
+	return std::abs(a - b) <= 1;
+}
+
+// Hashes every level of a few chains into `path`, for comparing builds
+static void dump(const char* path)
+{
+	std::vector<uint8_t> image(61 * 47 * 4);
+	uint32_t state = 12345;
+
+	for (auto& value : image) {
+		state = state * 1664525u + 1013904223u;
+		value = static_cast<uint8_t>(state >> 24);
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+
+	for (uint32_t channels = 1; channels <= 4; ++channels) {
+		for (auto filter : { MipChain::BOX, MipChain::KAISER }) {
+			for (bool srgb : { false, true }) {
+				for (const auto& level : MipChain::generate(image.data(), 61, 47, channels, filter, srgb)) {
+					for (auto value : level.pixels) {
+						hash ^= value;
+						hash *= 1099511628211ull;
+					}
+				}
+			}
+		}
+	}
+
+	std::ofstream(path) << std::hex << hash << "\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::printf("Mip chains built with %s\n", MipChain::simd());
+
+	// Level counts and sizes
+
+	CHECK(MipChain::levels(1, 1) == 1);
+	CHECK(MipChain::levels(256, 1) == 9);
+	CHECK(MipChain::levels(5, 3) == 3);
+	CHECK(MipChain::levels(1024, 768) == 11);
+
+	std::vector<uint8_t> image(37 * 23 * 3, 100);
+	auto levels = MipChain::generate(image.data(), 37, 23, 3);
+
+	CHECK(levels.size() == MipChain::levels(37, 23) - 1);
+	CHECK(levels.size() > 2 && levels[0].width == 18 && levels[0].height == 11);
+	CHECK(levels.size() > 2 && levels[1].width == 9 && levels[1].height == 5);
+	CHECK(!levels.empty() && levels.back().width == 1 && levels.back().height == 1);
+
+	for (const auto& level : levels)
+		CHECK(level.pixels.size() == level.width * level.height * 3);
+
+	// A flat image stays flat, the Kaiser lobes add up to one
+
+	for (const auto& level : levels)
+		for (auto value : level.pixels)
+			CHECK(near(value, 100));
+
+	// Black and white average to linear 0.5 with sRGB, 188 once encoded, not
+	// to 128. Alpha averages linearly either way
+
+	std::vector<uint8_t> checker = {
+		0,   0,   0,   0,      255, 255, 255, 255,
+		255, 255, 255, 255,    0,   0,   0,   0,
+	};
+
+	auto srgb = MipChain::generate(checker.data(), 2, 2, 4, MipChain::BOX, true);
+	auto linear = MipChain::generate(checker.data(), 2, 2, 4, MipChain::BOX, false);
+
+	CHECK(srgb.size() == 1 && near(srgb[0].pixels[0], 188) && near(srgb[0].pixels[2], 188) && near(srgb[0].pixels[3], 128));
+	CHECK(linear.size() == 1 && near(linear[0].pixels[0], 128) && near(linear[0].pixels[3], 128));
+
+	// Gray + alpha keeps its second channel linear too
+
+	std::vector<uint8_t> gray = { 0, 0, 255, 255, 255, 255, 0, 0 };
+	auto gray_levels = MipChain::generate(gray.data(), 2, 2, 2, MipChain::BOX, true);
+
+	CHECK(gray_levels.size() == 1 && near(gray_levels[0].pixels[0], 188) && near(gray_levels[0].pixels[1], 128));
+
+	if (argc > 1)
+		dump(argv[1]);
+
+	return s_failures;
+}
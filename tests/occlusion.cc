@@ -0,0 +1,68 @@
+#include <cmath>
+#include <cstdio>
+
+#include "pistacchio/occlusion.hh"
+
+#include "check.hh"
+
+static const std::vector<uint32_t> QUAD_INDICES = { 0, 1, 2, 0, 2, 3 };
+
+static bool near(float a, float b)
+{
+	return std::abs(a - b) < 1e-4f;
+}
+
+int main()
+{
+	std::printf("Occlusion buffer built with %s\n", OcclusionBuffer::simd());
+
+	// With an identity view-projection clip space is world space, a 64x64
+	// buffer covers [-1, 1] with 32 pixels per unit and spans 2x2 tiles
+
+	OcclusionBuffer buffer(64, 64);
+
+	// Coverage and depth of a quad sloping from z = -0.5 to 0.5 along x
+
+	buffer.begin(glm::mat4(1.0f));
+	buffer.add_occluder({ { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { -0.5f, 0.5f, -0.5f } },
+	                    QUAD_INDICES);
+	buffer.rasterize();
+
+	for (uint32_t x : { 16u, 31u, 32u, 47u }) {
+		// Window depth of z = x at the pixel center
+		float z = (x + 0.5f) / 32.0f - 1.0f;
+		CHECK(near(buffer.depth(x, 32), z * 0.5f + 0.5f));
+	}
+
+	CHECK(buffer.depth(0, 0) == 1.0f);
+	CHECK(buffer.depth(10, 32) == 1.0f);
+	CHECK(buffer.depth(32, 10) == 1.0f);
+	CHECK(buffer.depth(53, 53) == 1.0f);
+
+	// Back faces are culled
+
+	buffer.begin(glm::mat4(1.0f));
+	buffer.add_occluder({ { -0.5f, -0.5f, 0.0f }, { 0.5f, -0.5f, 0.0f }, { 0.5f, 0.5f, 0.0f }, { -0.5f, 0.5f, 0.0f } },
+	                    { 0, 2, 1, 0, 3, 2 });
+	buffer.rasterize();
+
+	CHECK(buffer.depth(32, 32) == 1.0f);
+
+	// Visibility of boxes against a flat quad at z = 0
+
+	buffer.begin(glm::mat4(1.0f));
+	buffer.add_occluder({ { -0.5f, -0.5f, 0.0f }, { 0.5f, -0.5f, 0.0f }, { 0.5f, 0.5f, 0.0f }, { -0.5f, 0.5f, 0.0f } },
+	                    QUAD_INDICES);
+	buffer.rasterize();
+
+	CHECK(near(buffer.depth(32, 32), 0.5f));
+
+	CHECK(!buffer.visible({ -0.2f, -0.2f, 0.5f }, { 0.2f, 0.2f, 0.6f }));     // Behind
+	CHECK(buffer.visible({ -0.2f, -0.2f, -0.6f }, { 0.2f, 0.2f, -0.5f }));    // In front
+	CHECK(buffer.visible({ -0.2f, -0.2f, -0.1f }, { 0.2f, 0.2f, 0.1f }));     // Through it
+	CHECK(buffer.visible({ 0.3f, -0.2f, 0.5f }, { 0.7f, 0.2f, 0.6f }));       // Behind, sticking out
+	CHECK(buffer.visible({ 0.7f, -0.2f, 0.5f }, { 0.9f, 0.2f, 0.6f }));       // Behind, beside it
+	CHECK(!buffer.visible({ 2.0f, 2.0f, 0.0f }, { 3.0f, 3.0f, 0.1f }));       // Out of view
+
+	return s_failures;
+}
@@ -0,0 +1,199 @@
+#include <cstdint>
+#include <vector>
+
+#include "pistacchio/jobs.hh"
+#include "pistacchio/gl/render_queue.hh"
+
+#include "check.hh"
+
+// Like in WindowGL, glad's implementation section is not guarded so it has
+// to come after the headers that include glad
+#define GLAD_GL_IMPLEMENTATION
+#include <glad/gl.h>
+
+// The queue replays through these instead of a driver, so the tests see the
+// state each draw ends up with and the order draws come in.
+
+struct Seen {
+	uint32_t id;   // `first` of the draw
+	uint32_t program;
+	uint32_t vertex_buffer;
+	uint32_t texture;
+	float model;
+};
+
+static uint32_t s_program = 0;
+static uint32_t s_vertex_buffer = 0;
+static uint32_t s_texture = 0;
+static float s_model = -1.0f;
+static std::vector<Seen> s_seen;
+
+static GLenum GLAD_API_PTR get_error()
+{
+	return GL_NO_ERROR;
+}
+
+static void GLAD_API_PTR use_program(GLuint program)
+{
+	s_program = program;
+}
+
+static void GLAD_API_PTR bind_vertex_array(GLuint)
+{}
+
+static void GLAD_API_PTR vertex_array_vertex_buffer(GLuint, GLuint binding, GLuint buffer, GLintptr, GLsizei)
+{
+	if (binding == 0)
+		s_vertex_buffer = buffer;
+}
+
+static void GLAD_API_PTR vertex_array_element_buffer(GLuint, GLuint)
+{}
+
+static void GLAD_API_PTR bind_texture_unit(GLuint, GLuint texture)
+{
+	s_texture = texture;
+}
+
+static void GLAD_API_PTR program_uniform_matrix4fv(GLuint, GLint, GLsizei, GLboolean, const GLfloat* value)
+{
+	s_model = value[0];
+}
+
+static void GLAD_API_PTR draw_arrays_instanced(GLenum, GLint first, GLsizei, GLsizei)
+{
+	s_seen.push_back(Seen{ static_cast<uint32_t>(first), s_program, s_vertex_buffer, s_texture, s_model });
+}
+
+static uint32_t lcg(uint32_t& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+int main()
+{
+	glad_glGetError = get_error;
+	glad_glUseProgram = use_program;
+	glad_glBindVertexArray = bind_vertex_array;
+	glad_glVertexArrayVertexBuffer = vertex_array_vertex_buffer;
+	glad_glVertexArrayElementBuffer = vertex_array_element_buffer;
+	glad_glBindTextureUnit = bind_texture_unit;
+	glad_glProgramUniformMatrix4fv = program_uniform_matrix4fv;
+	glad_glDrawArraysInstanced = draw_arrays_instanced;
+
+	// Key layout: pass, shader, material, then 24 bits of depth
+
+	CHECK(RenderQueueGL::key(0xAB, 0x1234, 0x5678, 1.0f) == 0xAB'1234'5678'FFFFFFull);
+	CHECK(RenderQueueGL::key(0, 0, 0, 0.0f) == 0);
+	CHECK(RenderQueueGL::key(1, 0, 0, 0.0f) > RenderQueueGL::key(0, 0xFFFF, 0xFFFF, 1.0f));
+	CHECK(RenderQueueGL::key(0, 1, 0, 0.0f) > RenderQueueGL::key(0, 0, 0xFFFF, 1.0f));
+	CHECK(RenderQueueGL::key(0, 0, 1, 0.0f) > RenderQueueGL::key(0, 0, 0, 1.0f));
+	CHECK(RenderQueueGL::key(0, 0, 0, 0.5f) > RenderQueueGL::key(0, 0, 0, 0.25f));
+	CHECK(RenderQueueGL::key(0, 0, 0, 0.5f, true) < RenderQueueGL::key(0, 0, 0, 0.25f, true));
+	CHECK(RenderQueueGL::key(0, 0, 0, -1.0f) == RenderQueueGL::key(0, 0, 0, 0.0f));
+	CHECK(RenderQueueGL::key(0, 0, 0, 2.0f) == RenderQueueGL::key(0, 0, 0, 1.0f));
+
+	// Draws recorded from several threads come out sorted by key, each with
+	// its own program, bindings and model matrix
+
+	struct Expected {
+		uint64_t key;
+		uint32_t program;
+		uint32_t vertex_buffer;
+		uint32_t texture;
+		bool model;
+	};
+
+	constexpr uint32_t PRODUCERS = 8;
+	constexpr uint32_t DRAWS = 500;
+
+	RenderQueueGL queue;
+	std::vector<Expected> expected(PRODUCERS * DRAWS);
+
+	Jobs::start(4);
+
+	Jobs::parallel_for(PRODUCERS, [&](uint32_t producer) {
+		auto& buffer = queue.buffer();
+		uint32_t random = producer;
+
+		RenderQueueGL::Bindings bindings;
+		bindings.vertex_buffers[0] = { .binding = 0, .buffer = 100 + producer, .stride = 12 };
+		bindings.textures[0] = { .unit = 0, .texture = 200 + producer };
+
+		// One `Bindings` for all of the producer's draws
+		auto shared = buffer.bindings(bindings);
+
+		for (uint32_t i = 0; i < DRAWS; ++i) {
+			uint32_t id = producer * DRAWS + i;
+			uint8_t pass = lcg(random) % 3;
+			uint16_t program = 1 + lcg(random) % 5;
+			uint16_t material = lcg(random) % 8;
+			float depth = (lcg(random) % 1000) / 1000.0f;
+			bool model = i % 4 != 0;
+
+			auto key = RenderQueueGL::key(pass, program, material, depth);
+			expected[id] = { key, program, 100 + producer, 200 + producer, model };
+
+			buffer.push(key, RenderQueueGL::Draw{
+				.program = program,
+				.vao = 1,
+				.bindings = shared,
+				.model = model ? buffer.model(glm::mat4(float(id))) : RenderQueueGL::NONE,
+				.model_location = 0,
+				.count = 3,
+				.first = id
+			});
+		}
+	});
+
+	CHECK(queue.flush() == PRODUCERS * DRAWS);
+	CHECK(s_seen.size() == PRODUCERS * DRAWS);
+
+	std::vector<bool> drawn(PRODUCERS * DRAWS, false);
+
+	for (size_t i = 0; i < s_seen.size(); ++i) {
+		const auto& seen = s_seen[i];
+
+		if (seen.id >= drawn.size() || drawn[seen.id]) {
+			CHECK(!"draw replayed twice or out of range");
+			continue;
+		}
+
+		drawn[seen.id] = true;
+
+		const auto& draw = expected[seen.id];
+
+		if (i > 0)
+			CHECK(draw.key >= expected[s_seen[i - 1].id].key);
+
+		CHECK(seen.program == draw.program);
+		CHECK(seen.vertex_buffer == draw.vertex_buffer);
+		CHECK(seen.texture == draw.texture);
+
+		if (draw.model)
+			CHECK(seen.model == float(seen.id));
+	}
+
+	// Flushing clears every command buffer
+
+	s_seen.clear();
+	CHECK(queue.flush() == 0);
+	CHECK(s_seen.empty());
+
+	// A single pass and shader leave most key bytes constant, they're skipped
+	// and the remaining ones still sort; back to front reverses depth
+
+	auto& buffer = queue.buffer();
+
+	for (uint32_t i = 0; i < 100; ++i)
+		buffer.push(RenderQueueGL::key(2, 7, 0, i / 100.0f, true), RenderQueueGL::Draw{ .program = 7, .vao = 1, .count = 3, .first = i });
+
+	CHECK(queue.flush() == 100);
+	CHECK(s_seen.size() == 100);
+
+	for (uint32_t i = 0; i < s_seen.size(); ++i)
+		CHECK(s_seen[i].id == 99 - i);
+
+	return s_failures;
+}